@@ -16,6 +16,8 @@
 #define KADEMLIA_SESSION_H
 
 
+#include <chrono>
+#include <string>
 #include <utility>
 #include "Poco/ActiveMethod.h"
 #include "Poco/Mutex.h"
@@ -23,6 +25,7 @@
 #include "Poco/Net/SocketProactor.h"
 #include "kademlia/endpoint.hpp"
 #include "kademlia/value_store.hpp"
+#include "kademlia/lookup_config.hpp"
 
 
 namespace Kademlia {
@@ -38,18 +41,43 @@ public:
 	using SaveHandlerType = std::function<void (const std::error_code&)>;
 	using LoadHandlerType = std::function<void (const std::error_code&, const DataType& data)>;
 	using ValueStoreType = kademlia::detail::value_store_type;
+	using ConfigType = kademlia::detail::lookup_config;
+	using LookupStatsType = kademlia::detail::lookup_stats;
 
 	static const std::uint16_t DEFAULT_PORT;
 
 	Session(Endpoint const& ipv4 = {"0.0.0.0", DEFAULT_PORT},
-		Endpoint const& ipv6 = {"::", DEFAULT_PORT}, int ms = 300);
-
-	Session(Endpoint const& initPeer, Endpoint const& ipv4, Endpoint const& ipv6, int ms = 300);
+		Endpoint const& ipv6 = {"::", DEFAULT_PORT}, int ms = 300,
+		ConfigType const& config = ConfigType());
+		/// config sets the lookup concurrency (fixed or adaptive), the
+		/// count of peers a value is saved to and the k-buckets size.
+
+	Session(Endpoint const& initPeer, Endpoint const& ipv4, Endpoint const& ipv6, int ms = 300,
+		ConfigType const& config = ConfigType());
+
+	Session(Endpoint const& initPeer, Endpoint const& ipv4, Endpoint const& ipv6,
+		std::string const& routingTableFile, int ms = 300,
+		ConfigType const& config = ConfigType());
+		/// Saves the routing table into routingTableFile periodically
+		/// and on destruction. If the file holds a recent routing table,
+		/// the session restarts with it (and the id it was saved with),
+		/// is initialized at once and refreshes its neighbors from
+		/// initPeer in the background.
 
 	~Session();
 
 	bool initialized() const;
 
+	void enableOneHopRouting();
+		/// Keeps a complete, gossiped membership view and reaches the
+		/// peers responsible for a key in a single hop while the view
+		/// is fresh. Falls back to iterative lookups otherwise.
+
+	void enableLoadCache(std::chrono::milliseconds period);
+		/// Serves the loads of a key from the value last loaded from
+		/// the network for period. Loads of a key made meanwhile may
+		/// miss a value saved by another peer.
+
 	void asyncSave(KeyType const& key, DataType&& data, SaveHandlerType&& handler);
 
 	template<typename K, typename D>
@@ -69,6 +97,11 @@ public:
 
 	const ValueStoreType& data() const;
 
+	LookupStatsType lookupStats() const;
+		/// Returns the count of lookups, of their requests (hedged ones
+		/// included) and timeouts, and of lookups by the highest
+		/// concurrency they used.
+
 	std::error_code run();
 
 	void abort();
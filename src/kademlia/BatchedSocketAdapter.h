@@ -0,0 +1,335 @@
+//
+// BatchedSocketAdapter.h
+//
+// Library: Kademlia
+// Package: DHT
+// Module:  BatchedSocketAdapter
+//
+// Definition of the BatchedSocketAdapter class.
+//
+// Copyright (c) 2021, Aleph ONE Software Engineering and Contributors.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+#ifndef KADEMLIA_BATCHEDSOCKETADAPTER_H
+#define KADEMLIA_BATCHEDSOCKETADAPTER_H
+
+#ifdef __linux__
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <vector>
+#include "Poco/Net/DatagramSocket.h"
+#include "Poco/Net/SocketProactor.h"
+#include "Poco/Net/SocketAddress.h"
+#include "kademlia/buffer.hpp"
+#include "kademlia/constants.hpp"
+#include "kademlia/log.hpp"
+
+
+namespace kademlia {
+namespace detail {
+
+
+template <typename SocketType>
+class BatchedSocketAdapter
+	/// Linux replacement of SocketAdapter for high packet rates,
+	/// to be used as the Engine UnderlyingSocketType.
+	///
+	/// Instead of a proactor operation (and wake up) per datagram, a
+	/// permanent proactor work receives up to SOCKET_BATCH_SIZE
+	/// datagrams per recvmmsg() call, handing them to the successive
+	/// receive operations, and sends the queued datagrams with
+	/// sendmmsg() calls. The proactor is only woken up by the first
+	/// send queued after a flush. The socket stays registered with
+	/// the proactor so that its readiness ends the proactor wait.
+	///
+	/// Completion callbacks are called on the proactor thread.
+{
+public:
+	using Callback = std::function<void (std::error_code const& failure, std::size_t bytes)>;
+
+	BatchedSocketAdapter() = delete;
+
+	BatchedSocketAdapter(Poco::Net::SocketProactor* pIOService,
+		const Poco::Net::SocketAddress& addr,
+		bool reuseAddress, bool ipV6Only) :
+		_pState(std::make_shared<State>(addr, reuseAddress, ipV6Only)),
+		_pIOService(pIOService)
+	{
+		LOG_DEBUG(BatchedSocketAdapter, this) << "Created BatchedSocketAdapter for "
+			<< _pState->_socket.address().toString() << std::endl;
+		_pIOService->addSocket(_pState->_socket, POLL_READ);
+
+		// The work outlives the adapter, but not its state.
+		std::weak_ptr<State> const weakState = _pState;
+		_pIOService->addWork([weakState]
+		{
+			if (auto const pState = weakState.lock())
+				pState->poll();
+		}, Poco::Net::SocketProactor::PERMANENT_COMPLETION_HANDLER);
+	}
+
+	BatchedSocketAdapter(const BatchedSocketAdapter& other) = default;
+
+	BatchedSocketAdapter(BatchedSocketAdapter&& other) :
+		_pState(std::move(other._pState)),
+		_pIOService(other._pIOService)
+	{
+		other._pIOService = nullptr;
+	}
+
+	BatchedSocketAdapter& operator=(const BatchedSocketAdapter& other) = default;
+
+	BatchedSocketAdapter& operator=(BatchedSocketAdapter&& other)
+	{
+		_pState = std::move(other._pState);
+		_pIOService = other._pIOService;
+		other._pIOService = nullptr;
+		return *this;
+	}
+
+	void asyncReceiveFrom(buffer& buf, Poco::Net::SocketAddress& addr, Callback&& onCompletion)
+		/// The datagram is copied into buf, resized if too small.
+	{
+		std::lock_guard<std::mutex> l(_pState->_mutex);
+		_pState->_receive = Receive{ &buf, &addr, std::move(onCompletion) };
+	}
+
+	void asyncSendTo(const buffer& message, const Poco::Net::SocketAddress& addr, Callback&& onCompletion)
+	{
+		asyncSendTo(buffer(message), addr, std::move(onCompletion));
+	}
+
+	void asyncSendTo(buffer&& message, const Poco::Net::SocketAddress& addr, Callback&& onCompletion)
+	{
+		bool wasEmpty;
+		{
+			std::lock_guard<std::mutex> l(_pState->_mutex);
+			wasEmpty = _pState->_sends.empty();
+			_pState->_sends.push_back(Send{ std::move(message), addr, std::move(onCompletion) });
+		}
+		if (wasEmpty) _pIOService->wakeUp();
+	}
+
+	Poco::Net::SocketImpl* impl() const
+	{
+		return _pState->_socket.impl();
+	}
+
+	const Poco::Net::Socket& socket() const
+	{
+		return _pState->_socket;
+	}
+
+	Poco::Net::SocketAddress address() const
+	{
+		return _pState->_socket.address();
+	}
+
+private:
+	enum { POLL_READ = 1 };
+
+	struct Receive
+	{
+		buffer* _pBuffer;
+		Poco::Net::SocketAddress* _pAddress;
+		Callback _onCompletion;
+	};
+
+	struct Send
+	{
+		buffer _message;
+		Poco::Net::SocketAddress _address;
+		Callback _onCompletion;
+	};
+
+	class State
+		/// Shared by the copies of an adapter and its proactor work.
+		/// The batch buffers are only used on the proactor thread.
+	{
+	public:
+		State(const Poco::Net::SocketAddress& addr, bool reuseAddress, bool ipV6Only):
+			_socket(addr, reuseAddress, ipV6Only),
+			_mutex(),
+			_receive(),
+			_sends(),
+			_datagrams(SOCKET_BATCH_SIZE, buffer(MAX_DATAGRAM_SIZE)),
+			_addresses(SOCKET_BATCH_SIZE),
+			_receiveVectors(SOCKET_BATCH_SIZE),
+			_receiveHeaders(SOCKET_BATCH_SIZE),
+			_sendVectors(SOCKET_BATCH_SIZE),
+			_sendHeaders(SOCKET_BATCH_SIZE),
+			_received(0),
+			_delivered(0)
+		{
+		}
+
+		void poll()
+		{
+			flushSends();
+			deliverDatagrams();
+		}
+
+		SocketType _socket;
+		std::mutex _mutex;
+		Receive _receive;
+		std::deque<Send> _sends;
+
+	private:
+		enum { MAX_DATAGRAM_SIZE = UINT16_MAX };
+
+		static bool wouldBlock(int error)
+		{
+			return error == EAGAIN || error == EWOULDBLOCK || error == EINTR;
+		}
+
+		int fd() const
+		{
+			return _socket.impl()->sockfd();
+		}
+
+		void flushSends()
+		{
+			std::vector<Send> batch;
+			batch.reserve(SOCKET_BATCH_SIZE);
+			for (;;)
+			{
+				{
+					std::lock_guard<std::mutex> l(_mutex);
+					while (!_sends.empty() && batch.size() < SOCKET_BATCH_SIZE)
+					{
+						batch.push_back(std::move(_sends.front()));
+						_sends.pop_front();
+					}
+				}
+				if (batch.empty()) return;
+
+				for (std::size_t i = 0; i != batch.size(); ++i)
+				{
+					auto& s = batch[i];
+					_sendVectors[i].iov_base = s._message.data();
+					_sendVectors[i].iov_len = s._message.size();
+					std::memset(&_sendHeaders[i], 0, sizeof(_sendHeaders[i]));
+					_sendHeaders[i].msg_hdr.msg_name = const_cast<sockaddr*>(s._address.addr());
+					_sendHeaders[i].msg_hdr.msg_namelen = s._address.length();
+					_sendHeaders[i].msg_hdr.msg_iov = &_sendVectors[i];
+					_sendHeaders[i].msg_hdr.msg_iovlen = 1;
+				}
+
+				auto sent = ::sendmmsg(fd(), _sendHeaders.data(), unsigned(batch.size()), MSG_DONTWAIT);
+				auto const error = errno;
+				if (sent < 0 && !wouldBlock(error))
+				{
+					// The first datagram is dropped, the others are sent again.
+					batch.front()._onCompletion(std::error_code(error, std::system_category()), 0);
+					sent = 1;
+				}
+				else if (sent > 0)
+				{
+					for (int i = 0; i != sent; ++i)
+						batch[i]._onCompletion(std::error_code(), _sendHeaders[i].msg_len);
+				}
+
+				auto const unsent = batch.begin() + std::max(sent, 0);
+				{
+					std::lock_guard<std::mutex> l(_mutex);
+					_sends.insert(_sends.begin(), std::make_move_iterator(unsent), std::make_move_iterator(batch.end()));
+				}
+				// The socket buffer is full, the rest waits for the next poll.
+				if (sent <= 0 || unsent != batch.end()) return;
+				batch.clear();
+			}
+		}
+
+		bool receiveBatch()
+			/// Returns false if no datagram is pending.
+		{
+			for (std::size_t i = 0; i != SOCKET_BATCH_SIZE; ++i)
+			{
+				_receiveVectors[i].iov_base = _datagrams[i].data();
+				_receiveVectors[i].iov_len = _datagrams[i].size();
+				std::memset(&_receiveHeaders[i], 0, sizeof(_receiveHeaders[i]));
+				_receiveHeaders[i].msg_hdr.msg_name = &_addresses[i];
+				_receiveHeaders[i].msg_hdr.msg_namelen = sizeof(_addresses[i]);
+				_receiveHeaders[i].msg_hdr.msg_iov = &_receiveVectors[i];
+				_receiveHeaders[i].msg_hdr.msg_iovlen = 1;
+			}
+
+			_delivered = 0;
+			auto const received = ::recvmmsg(fd(), _receiveHeaders.data(), unsigned(SOCKET_BATCH_SIZE), MSG_DONTWAIT, nullptr);
+			auto const error = errno;
+			_received = std::size_t(std::max(received, 0));
+			if (received >= 0 || wouldBlock(error))
+				return _received != 0;
+
+			Receive r;
+			{
+				std::lock_guard<std::mutex> l(_mutex);
+				std::swap(r, _receive);
+			}
+			if (r._onCompletion)
+				r._onCompletion(std::error_code(error, std::system_category()), 0);
+			return false;
+		}
+
+		void deliverDatagrams()
+			/// Each receive operation gets the next datagram, as long
+			/// as the completion handlers start new ones.
+		{
+			for (;;)
+			{
+				{
+					std::lock_guard<std::mutex> l(_mutex);
+					if (!_receive._onCompletion) return;
+				}
+				if (_delivered == _received && !receiveBatch()) return;
+
+				Receive r;
+				{
+					std::lock_guard<std::mutex> l(_mutex);
+					std::swap(r, _receive);
+				}
+				if (!r._onCompletion) return;
+
+				auto const& h = _receiveHeaders[_delivered];
+				auto const& datagram = _datagrams[_delivered];
+				if (r._pBuffer->size() < h.msg_len) r._pBuffer->resize(h.msg_len);
+				std::copy_n(datagram.begin(), h.msg_len, r._pBuffer->begin());
+				*r._pAddress = Poco::Net::SocketAddress(
+					reinterpret_cast<const sockaddr*>(&_addresses[_delivered]), h.msg_hdr.msg_namelen);
+				++_delivered;
+				r._onCompletion(std::error_code(), h.msg_len);
+			}
+		}
+
+		std::vector<buffer> _datagrams;
+		std::vector<sockaddr_storage> _addresses;
+		std::vector<iovec> _receiveVectors;
+		std::vector<mmsghdr> _receiveHeaders;
+			/// Describe the received datagrams until all are delivered,
+			/// while sends are flushed in between.
+		std::vector<iovec> _sendVectors;
+		std::vector<mmsghdr> _sendHeaders;
+		std::size_t _received;
+		std::size_t _delivered;
+	};
+
+	std::shared_ptr<State> _pState;
+	Poco::Net::SocketProactor* _pIOService = nullptr;
+};
+
+} }
+
+#endif // __linux__
+
+#endif //KADEMLIA_BATCHEDSOCKETADAPTER_H
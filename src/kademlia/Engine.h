@@ -31,14 +31,19 @@
 #endif
 
 #include <algorithm>
+#include <cstdio>
+#include <fstream>
 #include <stdexcept>
+#include <string>
 #include <queue>
+#include <map>
 #include <chrono>
 #include <random>
 #include <memory>
 #include <utility>
 #include <type_traits>
 #include <functional>
+#include <iterator>
 #include "Poco/Net/SocketProactor.h"
 #include "kademlia/endpoint.hpp"
 #include "kademlia/error_impl.hpp"
@@ -50,12 +55,16 @@
 #include "Message.h"
 #include "MessageSocket.h"
 #include "kademlia/routing_table.hpp"
+#include "kademlia/membership_table.hpp"
 #include "kademlia/value_store.hpp"
+#include "kademlia/value_cache.hpp"
+#include "kademlia/lookup_config.hpp"
 #include "FindValueTask.h"
 #include "StoreValueTask.h"
 #include "DiscoverNeighborsTask.h"
 #include "NotifyPeerTask.h"
 #include "Tracker.h"
+#include "Timer.h"
 #include "Message.h"
 #include "Poco/Mutex.h"
 #include "Poco/ScopedLock.h"
@@ -64,47 +73,88 @@ namespace kademlia {
 namespace detail {
 
 
-template<typename UnderlyingSocketType>
+template<typename UnderlyingSocketType
+	, typename RoutingTableType = routing_table<Poco::Net::SocketAddress>>
 class Engine final
 {
 public:
 	using key_type = std::vector<std::uint8_t>;
-	using routing_table_type = routing_table<Poco::Net::SocketAddress>;
+	using routing_table_type = RoutingTableType;
+	using membership_table_type = membership_table<Poco::Net::SocketAddress>;
 
 public:
-	Engine(Poco::Net::SocketProactor& io_service, endpoint const& ipv4, endpoint const& ipv6, id const& new_id = id{}, bool initialized = true):
+	Engine(Poco::Net::SocketProactor& io_service, endpoint const& ipv4, endpoint const& ipv6, id const& new_id = id{}, bool initialized = true,
+		lookup_config const& config = lookup_config()):
 			random_engine_(std::random_device{}()),
 			my_id_(new_id == id{} ? id{ random_engine_ } : new_id),
+			config_(config),
 			_initialized(initialized),
 			network_(io_service,
 				MessageSocketType::ipv4(io_service, ipv4),
 				MessageSocketType::ipv6(io_service, ipv6),
 				std::bind(&Engine::handle_new_message, this,
 					std::placeholders::_1, std::placeholders::_2, std::placeholders::_3)),
-			tracker_(io_service, my_id_, network_, random_engine_),
-			routing_table_(my_id_),
+			tracker_(io_service, my_id_, network_, random_engine_,
+				std::bind(&Engine::handle_round_trip, this,
+					std::placeholders::_1, std::placeholders::_2)),
+			routing_table_(my_id_, config_.bucket_size_),
+			closest_peers_(),
 			value_store_(),
-			pending_notifications_count_()
+			content_hashes_(),
+			pending_notifications_count_(),
+			membership_(my_id_),
+			locked_membership_(membership_, _mutex),
+			closest_members_(),
+			membership_timer_(io_service),
+			one_hop_routing_(false),
+			membership_heartbeat_(0),
+			last_membership_digest_time_(),
+			routing_table_path_(),
+			routing_table_timer_(io_service),
+			k_bucket_refresh_timer_(io_service),
+			k_bucket_refresh_check_delay_(),
+			pending_k_bucket_refreshes_(),
+			k_bucket_refreshes_count_(0),
+			pending_loads_(),
+			loaded_values_(value_cache::clock::duration::zero(), LOAD_CACHE_CAPACITY)
 	{
+		if (!config_.stats_recorder_)
+			config_.stats_recorder_ = std::make_shared<lookup_stats_recorder>();
+		if (config_.fragment_large_messages_)
+			tracker_.fragment_messages_larger_than(MAX_UNFRAGMENTED_MESSAGE_SIZE);
+
 		LOG_DEBUG(Engine, this) << "Peerless Engine (" << my_id_ << ") created(" <<
 			ipv4.address() << ':' << ipv4.service() << ", " <<
 			ipv6.address() << ':' << ipv6.service() << ')' << std::endl;
+		schedule_k_bucket_refresh();
 	}
 
 	Engine(Poco::Net::SocketProactor& io_service, endpoint const& initial_peer,
-		endpoint const& ipv4, endpoint const& ipv6, id const& new_id = id{}):
-			Engine(io_service, ipv4, ipv6, new_id, false)
+		endpoint const& ipv4, endpoint const& ipv6, id const& new_id = id{},
+		lookup_config const& config = lookup_config()):
+			Engine(io_service, ipv4, ipv6, new_id, false, config)
 	{
-		LOG_DEBUG(Engine, this) << "Engine bootstrapping using peer '" << initial_peer << "'." << std::endl;
-		auto on_initialized = [this]
-		{
-			_initialized = true;
-		};
+		bootstrap(io_service, initial_peer);
+	}
 
-		discover_neighbors(initial_peer, on_initialized);
+	Engine(Poco::Net::SocketProactor& io_service, endpoint const& initial_peer,
+		endpoint const& ipv4, endpoint const& ipv6, std::string const& routing_table_path,
+		lookup_config const& config = lookup_config()):
+			Engine(io_service, initial_peer, ipv4, ipv6,
+				load_routing_table_snapshot(routing_table_path), routing_table_path, config)
+		/// Restores the id and the routing table saved by a previous
+		/// run into routing_table_path, if recent enough. The engine
+		/// is then initialized at once and refreshes its neighbors in
+		/// the background; otherwise it bootstraps from initial_peer.
+		/// The routing table is saved back periodically and on
+		/// destruction.
+	{
+	}
 
-		while (!_initialized)
-			io_service.poll();
+	~Engine()
+	{
+		if (!routing_table_path_.empty())
+			save_routing_table();
 	}
 
 	Engine(Engine const&) = delete;
@@ -121,18 +171,64 @@ public:
 		network_.start();
 	}
 
+	void enable_one_hop_routing()
+		/// Keeps a complete membership view, maintained by gossip, and
+		/// sends loads and saves directly to the peers responsible for
+		/// the key while the view is fresh. Meant for clusters of a few
+		/// thousand reachable peers at most.
+	{
+		Poco::Mutex::ScopedLock l(_mutex);
+		if (one_hop_routing_) return;
+		one_hop_routing_ = true;
+
+		auto const now = membership_table_type::clock::now();
+		for (auto i = routing_table_.find(my_id_), e = routing_table_.end(); i != e; ++i)
+			membership_.push(i->first, i->second, now);
+
+		schedule_membership_digest();
+	}
+
+	bool one_hop_routing_enabled() const
+	{
+		return one_hop_routing_;
+	}
+
+	std::size_t members_count() const
+	{
+		Poco::Mutex::ScopedLock l(_mutex);
+		return membership_.size();
+	}
+
+	bool has_fresh_membership_view() const
+		/// Returns true while loads and saves go directly to the members.
+	{
+		Poco::Mutex::ScopedLock l(_mutex);
+		return is_membership_view_fresh();
+	}
+
 	template<typename HandlerType>
 	void asyncSave(key_type const& key, data_type&& data, HandlerType&& handler)
 	{
 		LOG_DEBUG(Engine, this) << "executing async save of key '" << toString(key) << "'." << std::endl;
 		id valID(key);
+		auto const content_hash = hash_probed_value(data);
 		Poco::Mutex::ScopedLock l(_mutex);
-		value_store_[valID] = data;
-		start_store_value_task(id(key), std::move(data), tracker_, routing_table_, std::forward<HandlerType>(handler));
+		store_value(valID, data_type(data), content_hash);
+		loaded_values_.erase(valID);
+		if (is_membership_view_fresh())
+		{
+			save_to_members(valID, data);
+			handler(std::error_code());
+			return;
+		}
+		routing_table_.mark_as_looked_up(valID, routing_table_type::clock::now());
+		start_store_value_task(id(key), std::move(data), tracker_, routing_table_, std::forward<HandlerType>(handler), config_);
 	}
 
 	template<typename HandlerType>
 	void asyncLoad(key_type const& key, HandlerType&& handler)
+		/// Concurrent loads of the same key share a single lookup,
+		/// all their handlers are called with its result.
 	{
 		LOG_DEBUG(Engine, this) << "executing async load of key '" << toString( key ) << "'." << std::endl;
 		id valID(key);
@@ -143,7 +239,94 @@ public:
 			handler(std::error_code(), it->second);
 			return;
 		}
-		start_find_value_task< data_type >(id(key), tracker_, routing_table_, std::forward<HandlerType>(handler));
+
+		if (auto const cached = loaded_values_.find(valID, value_cache::clock::now()))
+		{
+			handler(std::error_code(), *cached);
+			return;
+		}
+
+		auto const pending = pending_loads_.find(valID);
+		if (pending != pending_loads_.end())
+		{
+			LOG_DEBUG(Engine, this) << "joining the pending load of key '" << valID << "'." << std::endl;
+			pending->second.emplace_back(std::forward<HandlerType>(handler));
+			return;
+		}
+		// Registered first, the task may complete at once.
+		pending_loads_[valID].emplace_back(std::forward<HandlerType>(handler));
+
+		auto on_loaded = [this, valID](std::error_code const& failure, data_type const& data)
+		{
+			handle_load(valID, failure, data);
+		};
+		// The closest members hold the value, hence the first
+		// round of the lookup reaches it. Otherwise the lookup
+		// goes on iteratively.
+		if (is_membership_view_fresh())
+			start_find_value_task< data_type >(valID, tracker_, locked_membership_, std::move(on_loaded), config_);
+		else
+		{
+			routing_table_.mark_as_looked_up(valID, routing_table_type::clock::now());
+			start_find_value_task< data_type >(valID, tracker_, routing_table_, std::move(on_loaded), config_);
+		}
+	}
+
+	void enable_load_cache(std::chrono::milliseconds period)
+		/// Keeps the values loaded from the network for period, so that
+		/// loads of the same keys are served locally meanwhile (at the
+		/// cost of missing the saves made by other peers in between).
+		/// A zero period disables the cache.
+	{
+		Poco::Mutex::ScopedLock l(_mutex);
+		loaded_values_.configure(period, LOAD_CACHE_CAPACITY);
+	}
+
+	std::size_t pending_loads_count() const
+	{
+		return pending_loads_.size();
+	}
+
+	void refresh_idle_k_buckets(typename routing_table_type::clock::duration idle_period = K_BUCKET_REFRESH_PERIOD)
+		/// Queues a lookup of the buckets which haven't been looked up
+		/// for idle_period. Called every K_BUCKET_REFRESH_CHECK_PERIOD
+		/// or so.
+	{
+		Poco::Mutex::ScopedLock l(_mutex);
+		auto const now = routing_table_type::clock::now();
+		routing_table_.take_idle_k_buckets(now, idle_period, random_engine_,
+			[this, now](id const& target)
+			{
+				pending_k_bucket_refreshes_.push(pending_k_bucket_refresh{ target, now });
+			});
+		start_k_bucket_refreshes();
+	}
+
+	std::size_t k_bucket_refreshes_count() const
+		/// Returns the count of running bucket refreshes.
+	{
+		Poco::Mutex::ScopedLock l(_mutex);
+		return k_bucket_refreshes_count_;
+	}
+
+	std::size_t pending_k_bucket_refreshes_count() const
+		/// Returns the count of bucket refreshes waiting to run.
+	{
+		Poco::Mutex::ScopedLock l(_mutex);
+		return pending_k_bucket_refreshes_.size();
+	}
+
+	std::chrono::milliseconds k_bucket_refresh_check_delay() const
+		/// Returns the delay of the next check for idle buckets.
+	{
+		Poco::Mutex::ScopedLock l(_mutex);
+		return k_bucket_refresh_check_delay_;
+	}
+
+	lookup_stats lookup_statistics() const
+		/// Returns the statistics of the lookups done so far.
+	{
+		return config_.stats_recorder_->stats();
 	}
 
 	const value_store_type& data() const
@@ -151,12 +334,266 @@ public:
 		return value_store_;
 	}
 
+	RoutingTableSnapshot routing_table_snapshot() const
+	{
+		RoutingTableSnapshot snapshot;
+		snapshot.id_ = my_id_;
+		snapshot.time_ = to_milliseconds(std::chrono::system_clock::now().time_since_epoch());
+
+		auto const now = routing_table_type::clock::now();
+		routing_table_.for_each_peer([this, &snapshot, now](id const& peer_id,
+			Poco::Net::SocketAddress const& endpoint, typename routing_table_type::clock::time_point last_seen)
+		{
+			auto const age = std::min(to_milliseconds(now - last_seen), snapshot.time_);
+			// Round up, 0 meaning unknown.
+			auto const rtt = std::uint32_t((routing_table_.rtt(peer_id).count() + 999) / 1000);
+			snapshot.peers_.push_back(RoutingTableSnapshotEntry{ Peer{ peer_id, endpoint }, snapshot.time_ - age, rtt });
+		});
+		return snapshot;
+	}
+
+	bool save_routing_table()
+		/// Writes the routing table snapshot. A temporary file
+		/// is renamed over the previous snapshot, so a crash
+		/// never leaves a partially written one behind.
+	{
+		buffer b;
+		{
+			Poco::Mutex::ScopedLock l(_mutex);
+			serialize(routing_table_snapshot(), b);
+		}
+
+		auto const tmp_path = routing_table_path_ + ".tmp";
+		{
+			std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+			out.write(reinterpret_cast<char const*>(b.data()), b.size());
+			if (!out)
+			{
+				LOG_DEBUG(Engine, this) << "failed to write routing table to '" << tmp_path << "'." << std::endl;
+				return false;
+			}
+		}
+
+		// Windows refuses to rename over an existing file.
+		if (std::rename(tmp_path.c_str(), routing_table_path_.c_str()) != 0
+			&& (std::remove(routing_table_path_.c_str()) != 0
+				|| std::rename(tmp_path.c_str(), routing_table_path_.c_str()) != 0))
+		{
+			LOG_DEBUG(Engine, this) << "failed to rename '" << tmp_path << "'." << std::endl;
+			return false;
+		}
+
+		LOG_DEBUG(Engine, this) << "saved " << routing_table_.peer_count() << " peers to '"
+			<< routing_table_path_ << "'." << std::endl;
+		return true;
+	}
+
 private:
 	using pending_task_type = std::function<void ()>;
 	using MessageSocketType = MessageSocket<UnderlyingSocketType>;
 	using NetworkType = Network<MessageSocketType>;
 	using random_engine_type = std::default_random_engine;
 	using TrackerType = Tracker<random_engine_type, NetworkType>;
+	using load_handler_type = std::function<void (std::error_code const&, data_type const&)>;
+
+	struct pending_k_bucket_refresh
+	{
+		id target_;
+		typename routing_table_type::clock::time_point queued_;
+	};
+
+	class locked_membership_table final
+		/// The membership table operations of the lookup tasks, which
+		/// run on the network thread while loads and saves use the
+		/// table on the caller thread.
+	{
+	public:
+		locked_membership_table(membership_table_type& table, Poco::Mutex& mutex):
+			table_(table), mutex_(mutex)
+		{
+		}
+
+		template<typename OutputIterator>
+		std::size_t closest(id const& target, std::size_t count, OutputIterator out)
+		{
+			Poco::Mutex::ScopedLock l(mutex_);
+			return table_.closest(target, count, out);
+		}
+
+		void flag_peer_as_unresponsive(id const& peer_id)
+		{
+			Poco::Mutex::ScopedLock l(mutex_);
+			table_.flag_peer_as_unresponsive(peer_id);
+		}
+
+		std::chrono::microseconds rtt(id const& peer_id) const
+		{
+			Poco::Mutex::ScopedLock l(mutex_);
+			return table_.rtt(peer_id);
+		}
+
+	private:
+		membership_table_type& table_;
+		Poco::Mutex& mutex_;
+	};
+
+	Engine(Poco::Net::SocketProactor& io_service, endpoint const& initial_peer,
+		endpoint const& ipv4, endpoint const& ipv6,
+		RoutingTableSnapshot const& snapshot, std::string const& routing_table_path,
+		lookup_config const& config):
+			Engine(io_service, ipv4, ipv6, snapshot.id_, false, config)
+	{
+		routing_table_path_ = routing_table_path;
+		restore_routing_table(snapshot);
+
+		if (routing_table_.peer_count() > 0)
+		{
+			LOG_DEBUG(Engine, this) << "Engine restored " << routing_table_.peer_count()
+				<< " peers, refreshing using peer '" << initial_peer << "'." << std::endl;
+			_initialized = true;
+			refresh_neighbors(initial_peer);
+		}
+		else
+			bootstrap(io_service, initial_peer);
+
+		schedule_routing_table_save();
+	}
+
+	template<typename Duration>
+	static std::uint64_t to_milliseconds(Duration const& d)
+	{
+		auto const ms = std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
+		return ms > 0 ? std::uint64_t(ms) : 0;
+	}
+
+	static RoutingTableSnapshot load_routing_table_snapshot(std::string const& path)
+		/// Returns an empty snapshot (hence a random id) if the file
+		/// is missing, corrupted or older than ROUTING_TABLE_SNAPSHOT_MAX_AGE.
+	{
+		RoutingTableSnapshot snapshot;
+		std::ifstream in(path, std::ios::binary);
+		if (!in) return snapshot;
+
+		buffer const b{ std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() };
+		auto i = b.cbegin();
+		if (auto failure = deserialize(i, b.cend(), snapshot))
+		{
+			LOG_DEBUG(Engine, nullptr) << "ignoring routing table '" << path << "' ("
+				<< failure.message() << ")." << std::endl;
+			return RoutingTableSnapshot{};
+		}
+
+		auto const now = to_milliseconds(std::chrono::system_clock::now().time_since_epoch());
+		if (now - std::min(now, snapshot.time_) > std::uint64_t(ROUTING_TABLE_SNAPSHOT_MAX_AGE.count()))
+		{
+			LOG_DEBUG(Engine, nullptr) << "ignoring outdated routing table '" << path << "'." << std::endl;
+			return RoutingTableSnapshot{};
+		}
+		return snapshot;
+	}
+
+	void restore_routing_table(RoutingTableSnapshot const& snapshot)
+	{
+		auto const now = routing_table_type::clock::now();
+		auto const system_now = to_milliseconds(std::chrono::system_clock::now().time_since_epoch());
+
+		// Peers are saved from the least to the most
+		// recently seen, which push() expects.
+		for (auto const& p : snapshot.peers_)
+		{
+			auto const age = std::chrono::milliseconds(system_now - std::min(system_now, p.last_seen_));
+			routing_table_.push(p.peer_.id_, p.peer_.endpoint_,
+				now - std::chrono::duration_cast<typename routing_table_type::clock::duration>(age));
+			if (p.rtt_)
+				routing_table_.record_rtt(p.peer_.id_, std::chrono::milliseconds(p.rtt_));
+		}
+	}
+
+	void schedule_routing_table_save()
+	{
+		routing_table_timer_.expires_from_now(ROUTING_TABLE_SNAPSHOT_PERIOD, [this]
+		{
+			save_routing_table();
+			schedule_routing_table_save();
+		});
+	}
+
+	void bootstrap(Poco::Net::SocketProactor& io_service, endpoint const& initial_peer)
+	{
+		LOG_DEBUG(Engine, this) << "Engine bootstrapping using peer '" << initial_peer << "'." << std::endl;
+		auto on_initialized = [this]
+		{
+			_initialized = true;
+		};
+
+		discover_neighbors(initial_peer, on_initialized);
+
+		while (!_initialized)
+			io_service.poll();
+	}
+
+	void refresh_neighbors(endpoint const& initial_peer)
+		/// Background counterpart of discover_neighbors() used
+		/// once the routing table has been restored: the restored
+		/// peers keep serving if initial_peer is unreachable.
+	{
+		auto on_discovery = [this] (std::error_code const& failure)
+		{
+			if (failure)
+				LOG_DEBUG(Engine, this) << "failed to contact initial peer ("
+					<< failure.message() << ")." << std::endl;
+			notify_neighbors([]{});
+		};
+
+		start_discover_neighbors_task(my_id_, tracker_, routing_table_,
+			network_.resolve_endpoint(initial_peer), on_discovery);
+	}
+
+	void schedule_k_bucket_refresh()
+		/// Checks for idle buckets every K_BUCKET_REFRESH_CHECK_PERIOD,
+		/// give or take 25% so that engines started together don't
+		/// refresh in sync.
+	{
+		Poco::Mutex::ScopedLock l(_mutex);
+		auto const period = K_BUCKET_REFRESH_CHECK_PERIOD.count();
+		std::uniform_int_distribution<std::chrono::milliseconds::rep> jitter(-period / 4, period / 4);
+		k_bucket_refresh_check_delay_ = std::chrono::milliseconds(period + jitter(random_engine_));
+
+		k_bucket_refresh_timer_.expires_from_now(k_bucket_refresh_check_delay_, [this]
+		{
+			refresh_idle_k_buckets();
+			schedule_k_bucket_refresh();
+		});
+	}
+
+	void start_k_bucket_refreshes()
+		/// Runs at most MAX_CONCURRENT_K_BUCKET_REFRESH_COUNT refreshes
+		/// at once. A refresh whose bucket has been looked up since it
+		/// was queued (e.g. by a load) is dropped.
+	{
+		// Lookups with no candidate never complete.
+		if (routing_table_.peer_count() == 0)
+			pending_k_bucket_refreshes_ = decltype(pending_k_bucket_refreshes_)();
+
+		while (k_bucket_refreshes_count_ < MAX_CONCURRENT_K_BUCKET_REFRESH_COUNT
+			&& !pending_k_bucket_refreshes_.empty())
+		{
+			auto const refresh = pending_k_bucket_refreshes_.front();
+			pending_k_bucket_refreshes_.pop();
+			if (routing_table_.last_lookup(refresh.target_) > refresh.queued_)
+				continue;
+
+			LOG_DEBUG(Engine, this) << "refreshing bucket of '" << refresh.target_ << "'." << std::endl;
+			++k_bucket_refreshes_count_;
+			auto on_refreshed = [this]
+			{
+				Poco::Mutex::ScopedLock l(_mutex);
+				if (k_bucket_refreshes_count_) --k_bucket_refreshes_count_;
+				start_k_bucket_refreshes();
+			};
+			start_notify_peer_task(refresh.target_, tracker_, routing_table_, on_refreshed, config_);
+		}
+	}
 
 	void process_new_message(Poco::Net::SocketAddress const& sender, Header const& h,
 		buffer::const_iterator i, buffer::const_iterator e)
@@ -175,6 +612,21 @@ private:
 			case Header::FIND_VALUE_REQUEST:
 				handle_find_value_request(sender, h, i, e);
 				break;
+			case Header::VALUE_PROBE_REQUEST:
+				handle_value_probe_request(sender, h, i, e);
+				break;
+			case Header::MEMBERSHIP_DIGEST_REQUEST:
+				handle_membership_digest_request(sender, h, i, e);
+				break;
+			case Header::FRAGMENT:
+				tracker_.handle_fragment(sender, h, i, e, [this, sender](buffer const& message)
+				{
+					handle_reassembled_message(sender, message);
+				});
+				break;
+			case Header::FRAGMENT_ACK:
+				tracker_.handle_fragment_ack(sender, h, i, e);
+				break;
 			default:
 				tracker_.handle_new_response(sender, h, i, e);
 				break;
@@ -200,8 +652,27 @@ private:
 					<< failure.message() << ")." << std::endl;
 			return;
 		}
+		auto const content_hash = hash_probed_value(request.data_value_);
 		Poco::Mutex::ScopedLock l(_mutex);
-		value_store_[request.data_key_hash_] = std::move(request.data_value_);
+		store_value(request.data_key_hash_, std::move(request.data_value_), content_hash);
+	}
+
+	static id hash_probed_value(data_type const& data)
+		/// Returns the content hash of the values value probes are
+		/// answered with, id{} for the smaller ones sent inline.
+	{
+		return data.size() > MAX_PROBE_INLINE_VALUE_SIZE ? id(data) : id{};
+	}
+
+	void store_value(id const& key, data_type&& data, id const& content_hash)
+		/// Stores the value along with its content hash (see
+		/// hash_probed_value()), computed out of the lock.
+	{
+		value_store_[key] = std::move(data);
+		if (content_hash != id{})
+			content_hashes_[key] = content_hash;
+		else
+			content_hashes_.erase(key);
 	}
 
 	void handle_find_peer_request(Poco::Net::SocketAddress const& sender, Header const& h,
@@ -227,11 +698,11 @@ private:
 		// their location into the response..
 		FindPeerResponseBody response;
 
-		auto remaining_peer = ROUTING_TABLE_BUCKET_SIZE;
-		auto i = routing_table_.find(peer_to_find_id);
-		auto e = routing_table_.end();
-		for (;i != e && remaining_peer > 0; ++i, -- remaining_peer)
-			response.peers_.push_back({i->first, i->second});
+		closest_peers_.clear();
+		routing_table_.closest(peer_to_find_id, config_.bucket_size_, std::back_inserter(closest_peers_));
+		response.peers_.reserve(closest_peers_.size());
+		for (auto const& p : closest_peers_)
+			response.peers_.push_back({p.first, p.second});
 
 		LOG_DEBUG(Engine, this) << "found " << response.peers_.size() << " peers:" << std::endl;
 		for (auto& p : response.peers_)
@@ -270,6 +741,166 @@ private:
 		}
 	}
 
+	void handle_value_probe_request(Poco::Net::SocketAddress const& sender, Header const& h,
+		buffer::const_iterator i, buffer::const_iterator e)
+	{
+		LOG_DEBUG(Engine, this) << "handling value probe request." << std::endl;
+
+		ValueProbeRequestBody request;
+		if (auto failure = deserialize(i, e, request))
+		{
+			LOG_DEBUG(Engine, this) << "failed to deserialize value probe request ("
+				<< failure.message() << ")" << std::endl;
+			return;
+		}
+
+		Poco::ScopedLockWithUnlock<Poco::Mutex> l(_mutex);
+		auto found = value_store_.find(request.value_to_find_);
+		if (found == value_store_.end())
+		{
+			l.unlock();
+			send_find_peer_response(sender, h.random_token_, request.value_to_find_);
+		}
+		else if (found->second.size() <= MAX_PROBE_INLINE_VALUE_SIZE)
+		{
+			// Sending a small value costs less than fetching it.
+			FindValueResponseBody const response{ found->second };
+			tracker_.send_response(h.random_token_, response, sender);
+		}
+		else
+		{
+			ValueProbeResponseBody response;
+			response.size_ = found->second.size();
+			response.content_hash_ = content_hashes_[found->first];
+			tracker_.send_response(h.random_token_, response, sender);
+		}
+	}
+
+	void handle_membership_digest_request(Poco::Net::SocketAddress const& sender, Header const& h,
+		buffer::const_iterator i, buffer::const_iterator e)
+	{
+		LOG_DEBUG(Engine, this) << "handling membership digest request." << std::endl;
+
+		if (!one_hop_routing_) return;
+
+		MembershipDigestRequestBody request;
+		if (auto failure = deserialize(i, e, request))
+		{
+			LOG_DEBUG(Engine, this) << "failed to deserialize membership digest request ("
+				<< failure.message() << ")" << std::endl;
+			return;
+		}
+		merge_membership_digest(h.source_id_, sender, request);
+
+		MembershipDigestResponseBody response;
+		fill_membership_digest(response);
+		tracker_.send_response(h.random_token_, response, sender);
+	}
+
+	void handle_load(id const& key, std::error_code const& failure, data_type const& data)
+	{
+		std::vector<load_handler_type> handlers;
+		{
+			Poco::Mutex::ScopedLock l(_mutex);
+			auto const i = pending_loads_.find(key);
+			if (i == pending_loads_.end()) return;
+			handlers.swap(i->second);
+			pending_loads_.erase(i);
+
+			if (!failure)
+				loaded_values_.insert(key, data, value_cache::clock::now());
+		}
+
+		LOG_DEBUG(Engine, this) << "load of key '" << key << "' completed for "
+			<< handlers.size() << " callers" << std::endl;
+		for (auto& h : handlers)
+			h(failure, data);
+	}
+
+	bool is_membership_view_fresh() const
+	{
+		return one_hop_routing_ && !membership_.empty()
+			&& membership_table_type::clock::now() - last_membership_digest_time_ <= MEMBERSHIP_VIEW_TTL;
+	}
+
+	void save_to_members(id const& key, data_type const& data)
+	{
+		closest_members_.clear();
+		membership_.closest(key, config_.redundant_save_count_, std::back_inserter(closest_members_));
+
+		LOG_DEBUG(Engine, this) << "sending store request to "
+			<< closest_members_.size() << " members" << std::endl;
+
+		StoreValueRequestBody const request{ key, data };
+		for (auto const& m : closest_members_)
+			tracker_.send_request(request, m.second);
+	}
+
+	void schedule_membership_digest()
+	{
+		membership_timer_.expires_from_now(MEMBERSHIP_DIGEST_PERIOD, [this]
+		{
+			send_membership_digest();
+			schedule_membership_digest();
+		});
+	}
+
+	void send_membership_digest()
+		/// Beats and exchanges digests with a random member (push-pull).
+	{
+		MembershipDigestRequestBody request;
+		{
+			Poco::Mutex::ScopedLock l(_mutex);
+			auto const now = membership_table_type::clock::now();
+			++membership_heartbeat_;
+			membership_.expire(now, MEMBERSHIP_ENTRY_TTL);
+			fill_membership_digest(request);
+		}
+		if (request.members_.empty()) return;
+
+		// The digest members are already picked at random.
+		auto const target = request.members_.front().peer_;
+
+		auto on_response = [this](Poco::Net::SocketAddress const& sender, Header const& h,
+			buffer::const_iterator i, buffer::const_iterator e)
+		{
+			MembershipDigestResponseBody response;
+			if (h.type_ != Header::MEMBERSHIP_DIGEST_RESPONSE || deserialize(i, e, response))
+				return;
+			merge_membership_digest(h.source_id_, sender, response);
+		};
+
+		auto on_error = [this, target](std::error_code const&)
+		{
+			Poco::Mutex::ScopedLock l(_mutex);
+			membership_.flag_peer_as_unresponsive(target.id_);
+		};
+
+		tracker_.send_request(request, target.endpoint_, PEER_LOOKUP_TIMEOUT, on_response, on_error);
+	}
+
+	void fill_membership_digest(MembershipDigestBody& digest)
+	{
+		Poco::Mutex::ScopedLock l(_mutex);
+		digest.heartbeat_ = membership_heartbeat_;
+		membership_.sample(MEMBERSHIP_DIGEST_SIZE, random_engine_,
+			[&digest](id const& member_id, Poco::Net::SocketAddress const& endpoint, std::uint64_t heartbeat)
+			{
+				digest.members_.push_back(MembershipEntry{ Peer{ member_id, endpoint }, heartbeat });
+			});
+	}
+
+	void merge_membership_digest(id const& source_id, Poco::Net::SocketAddress const& sender,
+		MembershipDigestBody const& digest)
+	{
+		Poco::Mutex::ScopedLock l(_mutex);
+		auto const now = membership_table_type::clock::now();
+		last_membership_digest_time_ = now;
+		membership_.merge(source_id, sender, digest.heartbeat_, now);
+		for (auto const& m : digest.members_)
+			membership_.merge(m.peer_.id_, m.peer_.endpoint_, m.heartbeat_, now);
+	}
+
 	template<typename OnInitialized>
 	void discover_neighbors(endpoint const& initial_peer, OnInitialized on_initialized)
 	{
@@ -319,7 +950,8 @@ private:
 		while (i)
 		{
 			refresh_id[i] = ! refresh_id[i];
-			start_notify_peer_task(refresh_id, tracker_, routing_table_, on_notification_complete);
+			routing_table_.mark_as_looked_up(refresh_id, routing_table_type::clock::now());
+			start_notify_peer_task(refresh_id, tracker_, routing_table_, on_notification_complete, config_);
 			--i;
 		}
 	}
@@ -336,21 +968,96 @@ private:
 			return;
 		}
 
-		routing_table_.push(h.source_id_, sender);
+		if (!routing_table_.push(h.source_id_, sender))
+			check_bucket_liveness(h.source_id_);
+
+		if (one_hop_routing_)
+		{
+			// Loads and saves read the members on the caller thread.
+			Poco::Mutex::ScopedLock l(_mutex);
+			membership_.push(h.source_id_, sender, membership_table_type::clock::now());
+		}
 
 		process_new_message(sender, h, i, e);
 	}
 
+	void handle_reassembled_message(Poco::Net::SocketAddress const& sender, buffer const& message)
+	{
+		Header h;
+		auto i = message.cbegin();
+		if (deserialize(i, message.cend(), h))
+			return;
+
+		// Fragments are not fragmented again.
+		if (h.type_ == Header::FRAGMENT || h.type_ == Header::FRAGMENT_ACK)
+			return;
+
+		handle_new_message(sender, message.cbegin(), message.cend());
+	}
+
+	void handle_round_trip(id const& peer_id, std::chrono::microseconds rtt)
+	{
+		routing_table_.record_rtt(peer_id, rtt);
+		if (one_hop_routing_)
+		{
+			Poco::Mutex::ScopedLock l(_mutex);
+			membership_.record_rtt(peer_id, rtt);
+		}
+	}
+
+	void check_bucket_liveness(id const& peer_id)
+		/// Pings the least recently seen peer of a full bucket
+		/// which refused a new peer. Evicts it on timeout.
+	{
+		typename routing_table_type::value_type least_recently_seen;
+		if (!routing_table_.begin_liveness_check(peer_id, least_recently_seen))
+			return;
+
+		auto const lrs_id = least_recently_seen.first;
+		auto on_alive = [this, lrs_id](Poco::Net::SocketAddress const&, Header const&,
+			buffer::const_iterator, buffer::const_iterator)
+		{
+			routing_table_.end_liveness_check(lrs_id, true);
+		};
+
+		auto on_dead = [this, lrs_id](std::error_code const&)
+		{
+			LOG_DEBUG(Engine, this) << "evicting unresponsive peer " << lrs_id << std::endl;
+			routing_table_.end_liveness_check(lrs_id, false);
+		};
+
+		tracker_.send_request(Header::PING_REQUEST, least_recently_seen.second,
+			PEER_LOOKUP_TIMEOUT, on_alive, on_dead);
+	}
+
 private:
 	random_engine_type random_engine_;
 	id my_id_;
+	lookup_config config_;
 	std::atomic<bool> _initialized;
 	NetworkType network_;
 	TrackerType tracker_;
 	routing_table_type routing_table_;
+	std::vector<typename routing_table_type::value_type> closest_peers_;
 	value_store_type value_store_;
+	value_store<id, id> content_hashes_;
 	std::size_t pending_notifications_count_;
-	Poco::Mutex _mutex;
+	membership_table_type membership_;
+	locked_membership_table locked_membership_;
+	std::vector<typename membership_table_type::value_type> closest_members_;
+	Timer membership_timer_;
+	std::atomic<bool> one_hop_routing_;
+	std::uint64_t membership_heartbeat_;
+	membership_table_type::clock::time_point last_membership_digest_time_;
+	std::string routing_table_path_;
+	Timer routing_table_timer_;
+	Timer k_bucket_refresh_timer_;
+	std::chrono::milliseconds k_bucket_refresh_check_delay_;
+	std::queue<pending_k_bucket_refresh> pending_k_bucket_refreshes_;
+	std::size_t k_bucket_refreshes_count_;
+	std::map<id, std::vector<load_handler_type>> pending_loads_;
+	value_cache loaded_values_;
+	mutable Poco::Mutex _mutex;
 };
 
 } // namespace detail
@@ -82,31 +82,39 @@ namespace detail {
  *	  "is any pending request ?":e -> "data not found" [label=no]
  *  }
  *  @enddot
+ *
+ *  When probing values, the candidates are asked for the value metadata
+ *  (its size and hash) and small values only. The value is then fetched
+ *  from a single holder, the next holders being tried on failure, so
+ *  that large values are transferred once.
  */
-template<typename LoadHandlerType, typename TrackerType, typename DataType>
+template<typename LoadHandlerType, typename TrackerType, typename RoutingTableType, typename DataType>
 class FindValueTask final : public LookupTask
 {
 public:
-	template<typename RoutingTableType>
-	static void start(detail::id const & key, TrackerType & tracker, RoutingTableType & routing_table, LoadHandlerType handler)
+	static void start(detail::id const & key, TrackerType & tracker, RoutingTableType & routing_table,
+		LoadHandlerType handler, lookup_config const& config = lookup_config())
 	{
 		std::shared_ptr<FindValueTask> t;
-		t.reset(new FindValueTask(key, tracker, routing_table, std::move(handler)));
+		t.reset(new FindValueTask(key, tracker, routing_table, std::move(handler), config));
 		try_candidates(t);
 	}
 
 private:
-	template<typename RoutingTableType>
 	FindValueTask(id const & searched_key, TrackerType & tracker,
-		RoutingTableType & routing_table, LoadHandlerType load_handler):
+		RoutingTableType & routing_table, LoadHandlerType load_handler, lookup_config const& config):
 			LookupTask(searched_key,
-				routing_table.find(searched_key),
-				routing_table.end(),
+				routing_table,
 				tracker.addressV4(),
-				tracker.addressV6()),
+				tracker.addressV6(),
+				config),
 			tracker_(tracker),
+			routing_table_(routing_table),
 			load_handler_(std::move(load_handler)),
-			is_finished_()
+			is_finished_(),
+			probe_values_(config.probe_values_),
+			holders_(),
+			is_fetching_()
 	{
 		LOG_DEBUG(FindValueTask, this) << "create find value task for '"
 			<< searched_key << "' value." << std::endl;
@@ -117,6 +125,8 @@ private:
 		assert(! is_caller_notified());
 		load_handler_(std::error_code(), data);
 		is_finished_ = true;
+		// The responses to the other requests are of no use now.
+		cancel_requests(tracker_);
 	}
 
 	void notify_caller(std::error_code const& failure)
@@ -124,6 +134,7 @@ private:
 		assert(! is_caller_notified());
 		load_handler_(failure, DataType{});
 		is_finished_ = true;
+		cancel_requests(tracker_);
 	}
 
 	bool is_caller_notified() const
@@ -131,20 +142,36 @@ private:
 		return is_finished_;
 	}
 
-	static void try_candidates(std::shared_ptr<FindValueTask> task,
-		std::size_t concurrent_requests_count = CONCURRENT_FIND_PEER_REQUESTS_COUNT)
+	static void try_candidates(std::shared_ptr<FindValueTask> task)
 	{
-		auto closest_candidates = task->select_new_closest_candidates(concurrent_requests_count);
+		// The lookup waits for the value to be fetched.
+		if (task->is_fetching_) return;
 
-		FindValueRequestBody const request{ task->get_key() };
-		for (auto const& c : closest_candidates)
-			send_find_value_request(request, c, task);
+		send_lookup_requests(task->select_new_closest_candidates(task->concurrency()), task);
 
-		if (task->have_all_requests_completed())
+		// The closest peers answered without the value.
+		if (task->have_converged() || task->have_all_requests_completed())
 			task->notify_caller(make_error_code(VALUE_NOT_FOUND));
 	}
 
-	static void send_find_value_request(FindValueRequestBody const& request
+	static void send_lookup_requests(std::vector<Peer> const& candidates, std::shared_ptr<FindValueTask> task)
+	{
+		if (task->probe_values_)
+		{
+			ValueProbeRequestBody const request{ task->get_key() };
+			for (auto const& c : candidates)
+				send_find_value_request(request, c, task);
+		}
+		else
+		{
+			FindValueRequestBody const request{ task->get_key() };
+			for (auto const& c : candidates)
+				send_find_value_request(request, c, task);
+		}
+	}
+
+	template<typename Request>
+	static void send_find_value_request(Request const& request
 		, Peer const& current_candidate, std::shared_ptr<FindValueTask> task)
 	{
 		LOG_DEBUG(FindValueTask, task.get()) << "sending find '" << task->get_key()
@@ -158,6 +185,7 @@ private:
 			if (task->is_caller_notified())
 				return;
 
+			task->cancel_hedge_timer(task->tracker_, current_candidate.id_);
 			task->flag_candidate_as_valid(current_candidate.id_);
 			handle_find_value_response(s, h, i, e, task);
 		};
@@ -167,13 +195,41 @@ private:
 		{
 			if (task->is_caller_notified()) return;
 
-			// XXX: Current current_candidate must be flagged as stale.
+			task->cancel_hedge_timer(task->tracker_, current_candidate.id_);
+			task->routing_table_.flag_peer_as_unresponsive(current_candidate.id_);
 			task->flag_candidate_as_invalid(current_candidate.id_);
 			try_candidates(task);
 		};
 
-		task->tracker_.send_request(request, current_candidate.endpoint_,
-			PEER_LOOKUP_TIMEOUT, on_message_received, on_error);
+		// Unresponsive candidates are tried again by the lookup,
+		// not retransmitted by the tracker.
+		auto const response_id = task->tracker_.send_request(request, current_candidate.endpoint_,
+			PEER_LOOKUP_TIMEOUT, on_message_received, on_error, 0);
+		task->flag_request_in_flight(current_candidate.id_, response_id);
+
+		if (task->can_hedge())
+			hedge_if_slow(current_candidate, task);
+	}
+
+	static void hedge_if_slow(Peer const& current_candidate, std::shared_ptr<FindValueTask> task)
+	{
+		// The timer doesn't keep the task alive.
+		std::weak_ptr<FindValueTask> const weak_task = task;
+		auto const candidate_id = current_candidate.id_;
+		auto on_slow = [ weak_task, candidate_id ]
+		{
+			auto const task = weak_task.lock();
+			if (! task || task->is_caller_notified() || task->is_fetching_) return;
+
+			auto const candidates = task->select_hedge_candidate(candidate_id);
+			if (! candidates.empty())
+				LOG_DEBUG(FindValueTask, task.get()) << "hedging the request to '"
+					<< candidate_id << "'." << std::endl;
+			send_lookup_requests(candidates, task);
+		};
+
+		auto const timer = task->tracker_.expires_from_now(task->tracker_.hedge_delay(current_candidate.endpoint_), on_slow);
+		task->flag_hedge_timer_armed(candidate_id, timer);
 	}
 
 	/**
@@ -195,6 +251,71 @@ private:
 		else if (h.type_ == Header::FIND_VALUE_RESPONSE)
 			// The current Peer knows the value.
 			process_found_value(i, e, task);
+		else if (h.type_ == Header::VALUE_PROBE_RESPONSE)
+			// The current Peer knows the value, which is to be fetched.
+			process_value_probe(Peer{ h.source_id_, s }, i, e, task);
+	}
+
+	static void process_value_probe(Peer const& holder, buffer::const_iterator i
+		, buffer::const_iterator e, std::shared_ptr<FindValueTask> task)
+	{
+		ValueProbeResponseBody response;
+		if (auto failure = deserialize(i, e, response))
+		{
+			LOG_DEBUG(FindValueTask, task.get())
+					<< "failed to deserialize value probe response ("
+					<< failure.message() << ")" << std::endl;
+			return;
+		}
+
+		LOG_DEBUG(FindValueTask, task.get()) << "'" << holder << "' holds '"
+				<< task->get_key() << "' value (" << response.size_ << " bytes)." << std::endl;
+
+		// The other holders are kept in case the fetch fails.
+		task->holders_.push_back(value_holder{ holder, response.content_hash_ });
+		if (! task->is_fetching_)
+			fetch_from_next_holder(task);
+	}
+
+	static void fetch_from_next_holder(std::shared_ptr<FindValueTask> task)
+	{
+		if (task->holders_.empty())
+		{
+			// Other peers may hold the value, the lookup goes on.
+			task->is_fetching_ = false;
+			try_candidates(task);
+			return;
+		}
+
+		auto const holder = task->holders_.front();
+		task->holders_.erase(task->holders_.begin());
+		task->is_fetching_ = true;
+
+		LOG_DEBUG(FindValueTask, task.get()) << "fetching '" << task->get_key()
+				<< "' value from '" << holder.peer_ << "'." << std::endl;
+
+		auto on_message_received = [ task, holder ] (Poco::Net::SocketAddress const&,
+			Header const& h, buffer::const_iterator i, buffer::const_iterator e)
+		{
+			if (task->is_caller_notified()) return;
+
+			// The holder may have lost or replaced the value meanwhile.
+			FindValueResponseBody response;
+			if (h.type_ == Header::FIND_VALUE_RESPONSE && ! deserialize(i, e, response)
+				&& id(response.data_) == holder.content_hash_)
+				task->notify_caller(response.data_);
+			else
+				fetch_from_next_holder(task);
+		};
+
+		auto on_error = [ task ] (std::error_code const&)
+		{
+			if (task->is_caller_notified()) return;
+			fetch_from_next_holder(task);
+		};
+
+		task->tracker_.send_request(FindValueRequestBody{ task->get_key() }, holder.peer_.endpoint_,
+			PEER_LOOKUP_TIMEOUT, on_message_received, on_error);
 	}
 
 	/**
@@ -250,8 +371,18 @@ private:
 
 private:
 	TrackerType & tracker_;
+	RoutingTableType & routing_table_;
+	struct value_holder
+	{
+		Peer peer_;
+		id content_hash_;
+	};
+
 	LoadHandlerType load_handler_;
 	bool is_finished_;
+	bool probe_values_;
+	std::vector<value_holder> holders_;
+	bool is_fetching_;
 };
 
 /**
@@ -259,12 +390,13 @@ private:
  */
 template<typename DataType, typename TrackerType, typename RoutingTableType, typename HandlerType>
 void start_find_value_task(id const& key, TrackerType & tracker
-	, RoutingTableType & routing_table, HandlerType && handler)
+	, RoutingTableType & routing_table, HandlerType && handler
+	, lookup_config const& config = lookup_config())
 {
 	using handler_type = typename std::decay<HandlerType>::type;
-	using task = FindValueTask<handler_type, TrackerType, DataType>;
+	using task = FindValueTask<handler_type, TrackerType, RoutingTableType, DataType>;
 
-	task::start(key, tracker, routing_table, std::forward<HandlerType>(handler));
+	task::start(key, tracker, routing_table, std::forward<HandlerType>(handler), config);
 }
 
 } // namespace detail
@@ -1,19 +1,32 @@
 #include "LookupTask.h"
 #include "constants.hpp"
+#include <algorithm>
 
 namespace kademlia {
 namespace detail {
 
 
+LookupTask::~LookupTask()
+{
+	if (stats_recorder_)
+		stats_recorder_->record(concurrency_.highest(), requests_count_, timeouts_count_, hedged_requests_count_);
+}
+
+
 void LookupTask::flag_candidate_as_valid(id const& candidate_id)
 {
 	Poco::Mutex::ScopedLock l(_mutex);
 	auto i = find_candidate(candidate_id);
 	if (i == candidates_.end()) return;
 
+	if (i->state_ == candidate::STATE_CONTACTED)
+		concurrency_.on_response(std::chrono::duration_cast<concurrency_controller::duration>(
+			std::chrono::steady_clock::now() - i->contacted_));
 	if (in_flight_requests_count_) --in_flight_requests_count_;
-	i->second.attempts_ = 0;
-	i->second.state_ = candidate::STATE_RESPONDED;
+	i->attempts_ = 0;
+	i->state_ = candidate::STATE_RESPONDED;
+	i->has_request_ = false;
+	trim_candidates();
 }
 
 
@@ -24,8 +37,42 @@ void LookupTask::flag_candidate_as_invalid(id const& candidate_id)
 	if (i == candidates_.end()) return;
 
 	if (in_flight_requests_count_) --in_flight_requests_count_;
-	++i->second.attempts_;
-	i->second.state_ = candidate::STATE_TIMEDOUT;
+	concurrency_.on_timeout();
+	++timeouts_count_;
+	++i->attempts_;
+	i->state_ = candidate::STATE_TIMEDOUT;
+	i->has_request_ = false;
+
+	// Unresponsive candidates leave room for others
+	// and won't be added again.
+	if (i->attempts_ >= MAX_FIND_PEER_ATTEMPT_COUNT)
+	{
+		failed_candidates_.push_back(i->distance_);
+		candidates_.erase(i);
+	}
+	else
+		trim_candidates();
+}
+
+
+void LookupTask::flag_request_in_flight(id const& candidate_id, id const& response_id)
+{
+	Poco::Mutex::ScopedLock l(_mutex);
+	auto i = find_candidate(candidate_id);
+	// The response may already have been handled.
+	if (i == candidates_.end() || i->state_ != candidate::STATE_CONTACTED) return;
+
+	i->request_id_ = response_id;
+	i->has_request_ = true;
+}
+
+
+void LookupTask::flag_hedge_timer_armed(id const& candidate_id, timing_wheel::handle const& timer)
+{
+	Poco::Mutex::ScopedLock l(_mutex);
+	auto i = find_candidate(candidate_id);
+	if (i != candidates_.end())
+		i->hedge_timer_ = timer;
 }
 
 
@@ -33,26 +80,50 @@ std::vector<Peer> LookupTask::select_new_closest_candidates(std::size_t max_coun
 {
 	std::vector<Peer> candidates;
 	Poco::Mutex::ScopedLock l(_mutex);
-	// Iterate over all candidates until we picked
+	auto const now = std::chrono::steady_clock::now();
+	// Iterate over the shortlist until we picked
 	// candidates_max_count not-contacted candidates.
+	// Candidates whose distance to the key has as many leading
+	// zero bits are deemed as close as one another and the fastest
+	// ones are picked first. The grouping is bit-level: with a
+	// routing table symbol of more than one bit, a bucket spans
+	// several of these groups.
 	for (auto i = candidates_.begin(), e = candidates_.end()
 		; i != e && in_flight_requests_count_ < max_count
-		; ++ i)
+		; )
 	{
-		if (!isSelf(i->second.peer_.endpoint_))
+		auto const distance_class = i->distance_.count_leading_zeros();
+		same_distance_class_.clear();
+		for (; i != e && i->distance_.count_leading_zeros() == distance_class; ++i)
 		{
 			// TODO: strictly speaking, only STATE_UNKNOWN should be checked here,
 			// but we also check STATE_TIMEDOUT as well because,
 			// when running in truly async mode with a significant I/O load,
 			// some peers fail to respond with the lookup value (the exact
 			// reason why should be investigated)
-			if (i->second.state_ == candidate::STATE_UNKNOWN ||
-				(i->second.state_ == candidate::STATE_TIMEDOUT && i->second.attempts_ < MAX_FIND_PEER_ATTEMPT_COUNT))
+			if (!isSelf(i->peer_.endpoint_) &&
+				(i->state_ == candidate::STATE_UNKNOWN ||
+				(i->state_ == candidate::STATE_TIMEDOUT && i->attempts_ < MAX_FIND_PEER_ATTEMPT_COUNT)))
+				same_distance_class_.push_back(i);
+		}
+
+		// Unknown round trip times come last, ties keep the distance order.
+		std::stable_sort(same_distance_class_.begin(), same_distance_class_.end(),
+			[](candidates_type::iterator a, candidates_type::iterator b)
 			{
-				i->second.state_ = candidate::STATE_CONTACTED;
-				++in_flight_requests_count_;
-				candidates.push_back(i->second.peer_);
-			}
+				auto const ra = a->rtt_.count(), rb = b->rtt_.count();
+				return ra != 0 && (rb == 0 || ra < rb);
+			});
+
+		for (auto c = same_distance_class_.begin()
+			; c != same_distance_class_.end() && in_flight_requests_count_ < max_count
+			; ++c)
+		{
+			(*c)->state_ = candidate::STATE_CONTACTED;
+			(*c)->contacted_ = now;
+			++in_flight_requests_count_;
+			++requests_count_;
+			candidates.push_back((*c)->peer_);
 		}
 	}
 
@@ -60,12 +131,33 @@ std::vector<Peer> LookupTask::select_new_closest_candidates(std::size_t max_coun
 }
 
 
+std::vector<Peer> LookupTask::select_hedge_candidate(id const& slow_candidate_id)
+{
+	Poco::Mutex::ScopedLock l(_mutex);
+	auto const i = find_candidate(slow_candidate_id);
+	if (i == candidates_.end() || i->state_ != candidate::STATE_CONTACTED || !can_hedge())
+		return std::vector<Peer>{};
+
+	// One more request than those in flight.
+	auto const candidates = select_new_closest_candidates(in_flight_requests_count_ + 1);
+	hedged_requests_count_ += candidates.size();
+	return candidates;
+}
+
+
+bool LookupTask::can_hedge() const
+{
+	Poco::Mutex::ScopedLock l(_mutex);
+	return hedged_requests_count_ < max_hedged_requests_count_;
+}
+
+
 bool LookupTask::has_valid_candidate() const
 {
 	Poco::Mutex::ScopedLock l(_mutex);
 	for (auto i = candidates_.begin(); i != candidates_.end(); ++i)
 	{
-		if (i->second.state_ == candidate::STATE_RESPONDED)
+		if (i->state_ == candidate::STATE_RESPONDED)
 			return true;
 	}
 	return false;
@@ -82,20 +174,40 @@ std::vector<Peer> LookupTask::select_closest_valid_candidates(std::size_t max_co
 		; i != e && candidates.size() < max_count
 		; ++ i)
 	{
-		if (i->second.state_ == candidate::STATE_RESPONDED)
-			candidates.push_back(i->second.peer_);
+		if (i->state_ == candidate::STATE_RESPONDED)
+			candidates.push_back(i->peer_);
 	}
 
 	return candidates;
 }
 
 
+std::size_t LookupTask::concurrency() const
+{
+	Poco::Mutex::ScopedLock l(_mutex);
+	return concurrency_.value();
+}
+
+
 bool LookupTask::have_all_requests_completed() const
 {
 	return in_flight_requests_count_ == 0;
 }
 
 
+bool LookupTask::have_converged() const
+{
+	Poco::Mutex::ScopedLock l(_mutex);
+	if (candidates_.empty()) return false;
+
+	auto const e = candidates_.begin() + std::min(shortlist_size_, candidates_.size());
+	return std::all_of(candidates_.begin(), e, [](candidate const& c)
+	{
+		return c.state_ == candidate::STATE_RESPONDED;
+	});
+}
+
+
 id const& LookupTask::get_key() const
 {
 	return key_;
@@ -107,16 +219,49 @@ void LookupTask::add_candidate(Peer const& p)
 	LOG_DEBUG(LookupTask, this)
 		<< "adding (" << candidates_.size() << ")'" << p <<"' key:(" << key_ << ')' << std::endl;
 
+	auto endpoint = p.endpoint_;
+	if (isSelf(endpoint)) return;
+
 	auto const d = distance(p.id_, key_);
-	candidate const c{ p, candidate::STATE_UNKNOWN };
-	candidates_.emplace(d, c);
+	auto const i = lower_bound(d);
+	if (i != candidates_.end() && i->distance_ == d) return;
+
+	// Only the shortlist closest candidates are kept.
+	if (std::size_t(i - candidates_.begin()) >= shortlist_size_) return;
+
+	if (std::find(failed_candidates_.begin(), failed_candidates_.end(), d) != failed_candidates_.end())
+		return;
+
+	candidate c{ d, p, candidate::STATE_UNKNOWN };
+	if (peer_rtt_) c.rtt_ = peer_rtt_(p.id_);
+	candidates_.insert(i, c);
+	trim_candidates();
 }
 
 
 LookupTask::candidates_type::iterator LookupTask::find_candidate(id const& candidate_id)
 {
 	auto const d = distance(candidate_id, key_);
-	return candidates_.find(d);
+	auto const i = lower_bound(d);
+	return i != candidates_.end() && i->distance_ == d ? i : candidates_.end();
+}
+
+
+LookupTask::candidates_type::iterator LookupTask::lower_bound(id const& distance)
+{
+	return std::lower_bound(candidates_.begin(), candidates_.end(), distance,
+		[](candidate const& c, id const& d) { return c.distance_ < d; });
+}
+
+
+void LookupTask::trim_candidates()
+{
+	// Farther candidates are kept while a request to them is in flight.
+	for (auto i = candidates_.size(); i-- > shortlist_size_; )
+	{
+		if (candidates_[i].state_ != candidate::STATE_CONTACTED)
+			candidates_.erase(candidates_.begin() + i);
+	}
 }
 
 }
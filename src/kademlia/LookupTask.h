@@ -31,11 +31,17 @@
 #endif
 
 #include <cassert>
-#include <map>
+#include <chrono>
+#include <functional>
+#include <memory>
 #include <vector>
 
 #include "Peer.h"
+#include "kademlia/concurrency_controller.hpp"
+#include "kademlia/constants.hpp"
+#include "kademlia/lookup_config.hpp"
 #include "kademlia/log.hpp"
+#include "kademlia/timing_wheel.hpp"
 #include "Poco/Mutex.h"
 
 namespace kademlia {
@@ -43,16 +49,89 @@ namespace detail {
 
 
 class LookupTask
+	/// Iterative lookup of the peers closest to a key.
+	///
+	/// Candidates are kept in a shortlist sorted by distance to the
+	/// key, a flat array bounded to the k (the configured bucket size)
+	/// closest candidates: farther peers are dropped as soon as closer
+	/// ones are known (unless a request to them is in flight) and
+	/// unresponsive peers are not added again. The lookup has
+	/// converged once the k closest candidates have responded, i.e.
+	/// the last responses brought no closer peer.
+	///
+	/// concurrency() is the count of requests to keep in flight,
+	/// adapted to the responses and timeouts of the candidates.
 {
 public:
 	void flag_candidate_as_valid(id const& candidate_id);
 
 	void flag_candidate_as_invalid(id const& candidate_id);
 
+	void flag_request_in_flight(id const& candidate_id, id const& response_id);
+		/// Remembers the token of the request sent to the candidate,
+		/// for cancel_requests().
+
+	void flag_hedge_timer_armed(id const& candidate_id, timing_wheel::handle const& timer);
+		/// Remembers the timer hedging the request sent to the
+		/// candidate, for cancel_hedge_timer() and cancel_requests().
+
+	template<typename TrackerType>
+	void cancel_hedge_timer(TrackerType& tracker, id const& candidate_id)
+		/// Cancels the timer hedging the request sent to the candidate,
+		/// once it has been answered or has failed.
+	{
+		timing_wheel::handle timer;
+		{
+			Poco::Mutex::ScopedLock l(_mutex);
+			auto i = find_candidate(candidate_id);
+			if (i == candidates_.end()) return;
+			std::swap(timer, i->hedge_timer_);
+		}
+		tracker.cancel_timer(timer);
+	}
+
+	template<typename TrackerType>
+	void cancel_requests(TrackerType& tracker)
+		/// Cancels the requests still in flight (e.g. once the task is
+		/// done) and their hedge timers, releasing their callbacks and
+		/// timeouts right away.
+	{
+		std::vector<id> response_ids;
+		std::vector<timing_wheel::handle> timers;
+		{
+			Poco::Mutex::ScopedLock l(_mutex);
+			for (auto& c : candidates_)
+			{
+				if (c.hedge_timer_.index_ != timing_wheel::NIL)
+				{
+					timers.push_back(c.hedge_timer_);
+					c.hedge_timer_ = timing_wheel::handle();
+				}
+				if (c.state_ != candidate::STATE_CONTACTED || !c.has_request_)
+					continue;
+				response_ids.push_back(c.request_id_);
+				c.has_request_ = false;
+			}
+			in_flight_requests_count_ = 0;
+		}
+
+		for (auto const& i : response_ids)
+			tracker.cancel_request(i);
+		for (auto const& t : timers)
+			tracker.cancel_timer(t);
+	}
+
 	std::vector<Peer> select_new_closest_candidates(std::size_t max_count);
 
 	std::vector<Peer> select_closest_valid_candidates(std::size_t max_count);
 
+	std::vector<Peer> select_hedge_candidate(id const& slow_candidate_id);
+		/// Returns the next new candidate to send the request still
+		/// waiting for the candidate response to, while the hedging
+		/// budget lasts. The request to the slow candidate goes on.
+
+	bool can_hedge() const;
+
 	bool has_valid_candidate() const;
 
 	template<typename Peers>
@@ -64,27 +143,75 @@ public:
 
 	std::size_t inFlightRequests() const;
 
+	std::size_t concurrency() const;
+
 	bool have_all_requests_completed() const;
 
+	bool have_converged() const;
+		/// Returns true once the shortlist closest candidates have
+		/// all responded. The requests still in flight can't bring
+		/// closer peers then, they can be cancelled.
+
 	id const& get_key() const;
 
 protected:
-	~LookupTask() = default;
+	~LookupTask();
+		/// Records the lookup statistics.
 
 	template<typename Iterator>
 	LookupTask(id const & key, Iterator i, Iterator e,
 		const Poco::Net::SocketAddress& addressV4,
-		const Poco::Net::SocketAddress& addressV6)
+		const Poco::Net::SocketAddress& addressV6,
+		lookup_config const& config = lookup_config())
 		: key_{ key },
 		  in_flight_requests_count_{ 0 },
+		  shortlist_size_{ config.bucket_size_ },
 		  candidates_{},
+		  failed_candidates_{},
 		_addressV4(addressV4),
-		_addressV6(addressV6)
+		_addressV6(addressV6),
+		concurrency_(config.concurrent_requests_count_, config.min_concurrent_requests_count_,
+			config.max_concurrent_requests_count_, config.fast_response_time_),
+		stats_recorder_(config.stats_recorder_),
+		requests_count_(0),
+		timeouts_count_(0),
+		max_hedged_requests_count_(config.max_hedged_requests_count_),
+		hedged_requests_count_(0)
 	{
+		candidates_.reserve(shortlist_size_);
 		for (; i != e; ++i)
 			add_candidate(Peer{ i->first, i->second });
 	}
 
+	template<typename RoutingTableType>
+	LookupTask(id const & key, RoutingTableType & routing_table,
+		const Poco::Net::SocketAddress& addressV4,
+		const Poco::Net::SocketAddress& addressV6,
+		lookup_config const& config = lookup_config())
+		/// Starts from the routing table peers closest to the key.
+		/// The routing table round trip times of the candidates are
+		/// used to pick among the ones whose distances to the key
+		/// have as many leading zero bits.
+		: key_{ key },
+		  in_flight_requests_count_{ 0 },
+		  shortlist_size_{ config.bucket_size_ },
+		  candidates_{},
+		  failed_candidates_{},
+		_addressV4(addressV4),
+		_addressV6(addressV6),
+		peer_rtt_([&routing_table](id const& peer_id) { return routing_table.rtt(peer_id); }),
+		concurrency_(config.concurrent_requests_count_, config.min_concurrent_requests_count_,
+			config.max_concurrent_requests_count_, config.fast_response_time_),
+		stats_recorder_(config.stats_recorder_),
+		requests_count_(0),
+		timeouts_count_(0),
+		max_hedged_requests_count_(config.max_hedged_requests_count_),
+		hedged_requests_count_(0)
+	{
+		candidates_.reserve(shortlist_size_);
+		routing_table.closest(key, shortlist_size_, candidate_inserter{ this });
+	}
+
 	virtual bool isSelf(Poco::Net::SocketAddress& endpoint)
 	{
 		return (endpoint == _addressV4 || endpoint == _addressV6);
@@ -93,6 +220,7 @@ protected:
 private:
 	struct candidate final
 	{
+		id distance_;
 		Peer peer_;
 		enum
 		{
@@ -102,19 +230,55 @@ private:
 			STATE_TIMEDOUT,
 		} state_ = STATE_UNKNOWN;
 		int attempts_ = 0;
+		std::chrono::microseconds rtt_{ 0 };
+		id request_id_;
+		bool has_request_ = false;
+		timing_wheel::handle hedge_timer_;
+		std::chrono::steady_clock::time_point contacted_;
 	};
 
-	using candidates_type = std::map<id, candidate>;
+	using candidates_type = std::vector<candidate>;
+
+	struct candidate_inserter
+		/// Output iterator adding routing table entries as candidates.
+	{
+		candidate_inserter& operator * () { return *this; }
+		candidate_inserter& operator ++ () { return *this; }
+		candidate_inserter operator ++ (int) { return *this; }
+
+		template<typename Entry>
+		candidate_inserter& operator = (Entry const& e)
+		{
+			task_->add_candidate(Peer{ e.first, e.second });
+			return *this;
+		}
+
+		LookupTask* task_;
+	};
 
 	void add_candidate(Peer const& p);
 
 	candidates_type::iterator find_candidate(id const& candidate_id);
 
+	candidates_type::iterator lower_bound(id const& distance);
+
+	void trim_candidates();
+
 	id key_;
 	std::size_t in_flight_requests_count_;
+	std::size_t shortlist_size_;
 	candidates_type candidates_;
+	std::vector<id> failed_candidates_;
 	Poco::Net::SocketAddress _addressV4;
 	Poco::Net::SocketAddress _addressV6;
+	std::function<std::chrono::microseconds (id const&)> peer_rtt_;
+	std::vector<candidates_type::iterator> same_distance_class_;
+	concurrency_controller concurrency_;
+	std::shared_ptr<lookup_stats_recorder> stats_recorder_;
+	std::size_t requests_count_;
+	std::size_t timeouts_count_;
+	std::size_t max_hedged_requests_count_;
+	std::size_t hedged_requests_count_;
 	mutable Poco::Mutex _mutex;
 };
 
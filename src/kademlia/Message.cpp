@@ -133,6 +133,11 @@ enum
 	KADEMLIA_ENDPOINT_SERIALIZATION_IPV6 = 2
 };
 
+enum : std::uint8_t
+{
+	ROUTING_TABLE_SNAPSHOT_V1 = 1
+};
+
 
 inline void serialize(IPAddress const& address, buffer & b)
 {
@@ -247,6 +252,18 @@ std::ostream& operator << (std::ostream & out, Header::type const& t)
 			return out << "find_value_request";
 		case Header::FIND_VALUE_RESPONSE:
 			return out << "find_value_response";
+		case Header::MEMBERSHIP_DIGEST_REQUEST:
+			return out << "membership_digest_request";
+		case Header::MEMBERSHIP_DIGEST_RESPONSE:
+			return out << "membership_digest_response";
+		case Header::VALUE_PROBE_REQUEST:
+			return out << "value_probe_request";
+		case Header::VALUE_PROBE_RESPONSE:
+			return out << "value_probe_response";
+		case Header::FRAGMENT:
+			return out << "fragment";
+		case Header::FRAGMENT_ACK:
+			return out << "fragment_ack";
 	}
 }
 
@@ -327,6 +344,75 @@ std::error_code deserialize(buffer::const_iterator & i, buffer::const_iterator e
 	return deserialize(i, e, body.data_);
 }
 
+void serialize(ValueProbeRequestBody const& body, buffer & b)
+{
+	serialize(body.value_to_find_, b);
+}
+
+
+std::error_code deserialize(buffer::const_iterator & i, buffer::const_iterator e, ValueProbeRequestBody & body)
+{
+	return deserialize(i, e, body.value_to_find_);
+}
+
+
+void serialize(ValueProbeResponseBody const& body, buffer & b)
+{
+	serialize_integer(body.size_, b);
+	serialize(body.content_hash_, b);
+}
+
+
+std::error_code deserialize(buffer::const_iterator & i, buffer::const_iterator e, ValueProbeResponseBody & body)
+{
+	auto failure = deserialize_integer(i, e, body.size_);
+	if (failure) return failure;
+	return deserialize(i, e, body.content_hash_);
+}
+
+
+void serialize(FragmentBody const& body, buffer & b)
+{
+	serialize_integer(body.message_size_, b);
+	serialize_integer(body.index_, b);
+	serialize_integer(body.count_, b);
+	serialize_integer(body.flags_, b);
+	serialize(body.data_, b);
+}
+
+
+std::error_code deserialize(buffer::const_iterator & i, buffer::const_iterator e, FragmentBody & body)
+{
+	auto failure = deserialize_integer(i, e, body.message_size_);
+	if (failure) return failure;
+	failure = deserialize_integer(i, e, body.index_);
+	if (failure) return failure;
+	failure = deserialize_integer(i, e, body.count_);
+	if (failure) return failure;
+	failure = deserialize_integer(i, e, body.flags_);
+	if (failure) return failure;
+	body.data_.clear();
+	return deserialize(i, e, body.data_);
+}
+
+
+void serialize(FragmentAckBody const& body, buffer & b)
+{
+	serialize_integer(body.next_, b);
+	serialize_integer(body.received_mask_, b);
+	serialize_integer(body.window_, b);
+}
+
+
+std::error_code deserialize(buffer::const_iterator & i, buffer::const_iterator e, FragmentAckBody & body)
+{
+	auto failure = deserialize_integer(i, e, body.next_);
+	if (failure) return failure;
+	failure = deserialize_integer(i, e, body.received_mask_);
+	if (failure) return failure;
+	return deserialize_integer(i, e, body.window_);
+}
+
 void serialize(StoreValueRequestBody const& body, buffer & b)
 {
 	serialize(body.data_key_hash_, b);
@@ -340,5 +426,75 @@ std::error_code deserialize(buffer::const_iterator & i, buffer::const_iterator e
 	return deserialize(i, e, body.data_value_);
 }
 
+void serialize(MembershipDigestBody const& body, buffer & b)
+{
+	serialize_integer(body.heartbeat_, b);
+	serialize_integer(body.members_.size(), b);
+
+	for (auto const & m : body.members_)
+	{
+		serialize(m.peer_, b);
+		serialize_integer(m.heartbeat_, b);
+	}
+}
+
+std::error_code deserialize(buffer::const_iterator & i, buffer::const_iterator e, MembershipDigestBody & body)
+{
+	auto failure = deserialize_integer(i, e, body.heartbeat_);
+	if (failure) return failure;
+
+	std::uint64_t size;
+	failure = deserialize_integer(i, e, size);
+	for (; size > 0 && !failure; -- size)
+	{
+		body.members_.resize(body.members_.size() + 1);
+		failure = deserialize(i, e, body.members_.back().peer_);
+		if (!failure) failure = deserialize_integer(i, e, body.members_.back().heartbeat_);
+	}
+	return failure;
+}
+
+void serialize(RoutingTableSnapshot const& snapshot, buffer & b)
+{
+	b.push_back(ROUTING_TABLE_SNAPSHOT_V1);
+	serialize(snapshot.id_, b);
+	serialize_integer(snapshot.time_, b);
+	serialize_integer(snapshot.peers_.size(), b);
+
+	for (auto const & p : snapshot.peers_)
+	{
+		serialize(p.peer_, b);
+		serialize_integer(p.last_seen_, b);
+		serialize_integer(p.rtt_, b);
+	}
+}
+
+std::error_code deserialize(buffer::const_iterator & i, buffer::const_iterator e, RoutingTableSnapshot & snapshot)
+{
+	if (std::distance(i, e) < 1)
+		return make_error_code(TRUNCATED_HEADER);
+
+	if (*i++ != ROUTING_TABLE_SNAPSHOT_V1)
+		return make_error_code(UNKNOWN_PROTOCOL_VERSION);
+
+	auto failure = deserialize(i, e, snapshot.id_);
+	if (failure) return failure;
+
+	failure = deserialize_integer(i, e, snapshot.time_);
+	if (failure) return failure;
+
+	std::uint64_t size;
+	failure = deserialize_integer(i, e, size);
+	for (; size > 0 && !failure; -- size)
+	{
+		snapshot.peers_.resize(snapshot.peers_.size() + 1);
+		auto & p = snapshot.peers_.back();
+		failure = deserialize(i, e, p.peer_);
+		if (!failure) failure = deserialize_integer(i, e, p.last_seen_);
+		if (!failure) failure = deserialize_integer(i, e, p.rtt_);
+	}
+	return failure;
+}
+
 } // namespace detail
 } // namespace kademlia
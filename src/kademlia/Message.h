@@ -62,6 +62,12 @@ struct Header final
 		FIND_PEER_RESPONSE,
 		FIND_VALUE_REQUEST,
 		FIND_VALUE_RESPONSE,
+		MEMBERSHIP_DIGEST_REQUEST,
+		MEMBERSHIP_DIGEST_RESPONSE,
+		VALUE_PROBE_REQUEST,
+		VALUE_PROBE_RESPONSE,
+		FRAGMENT,
+		FRAGMENT_ACK,
 	} type_;
 
 	id source_id_;
@@ -163,6 +169,102 @@ void serialize(FindValueResponseBody const& body, buffer & b);
 
 std::error_code deserialize(buffer::const_iterator & i, buffer::const_iterator e, FindValueResponseBody & body);
 
+struct ValueProbeRequestBody final
+	/// Asks whether the value is held, without its content.
+{
+	id value_to_find_;
+};
+
+inline std::ostream & operator<< (std::ostream & out, ValueProbeRequestBody const& body)
+{
+	out << body.value_to_find_;
+	return out;
+}
+
+template<>
+struct message_traits< ValueProbeRequestBody >
+{ static CXX11_CONSTEXPR Header::type TYPE_ID = Header::VALUE_PROBE_REQUEST; };
+
+void serialize(ValueProbeRequestBody const& body, buffer & b);
+
+std::error_code deserialize(buffer::const_iterator & i, buffer::const_iterator e, ValueProbeRequestBody & body);
+
+struct ValueProbeResponseBody final
+	/// Metadata of a value held by the responder, which
+	/// is then fetched with a find value request.
+{
+	std::uint64_t size_ = 0;
+	id content_hash_;
+		/// SHA-1 of the value, as id(data).
+};
+
+inline std::ostream & operator<< (std::ostream & out, ValueProbeResponseBody const& body)
+{
+	out << body.size_ << ' ' << body.content_hash_;
+	return out;
+}
+
+template<>
+struct message_traits< ValueProbeResponseBody >
+{ static CXX11_CONSTEXPR Header::type TYPE_ID = Header::VALUE_PROBE_RESPONSE; };
+
+void serialize(ValueProbeResponseBody const& body, buffer & b);
+
+std::error_code deserialize(buffer::const_iterator & i, buffer::const_iterator e, ValueProbeResponseBody & body);
+
+struct FragmentBody final
+	/// A part of a message too large for a datagram. The header
+	/// random token identifies the transfer, the message is cut
+	/// into count_ parts of the same size (but the last one).
+{
+	enum : std::uint8_t { ACK_REQUESTED = 1 };
+
+	std::uint64_t message_size_ = 0;
+	std::uint32_t index_ = 0;
+	std::uint32_t count_ = 0;
+	std::uint8_t flags_ = 0;
+	std::vector<std::uint8_t> data_;
+};
+
+inline std::ostream & operator<< (std::ostream & out, FragmentBody const& body)
+{
+	out << body.index_ << '/' << body.count_ << " (" << body.message_size_ << " bytes)";
+	return out;
+}
+
+template<>
+struct message_traits< FragmentBody >
+{ static CXX11_CONSTEXPR Header::type TYPE_ID = Header::FRAGMENT; };
+
+void serialize(FragmentBody const& body, buffer & b);
+
+std::error_code deserialize(buffer::const_iterator & i, buffer::const_iterator e, FragmentBody & body);
+
+struct FragmentAckBody final
+	/// The fragments received so far: all those before next_,
+	/// and next_ + 1 + n for each bit n set in received_mask_.
+	/// window_ is the count of fragments the receiver accepts
+	/// in flight.
+{
+	std::uint32_t next_ = 0;
+	std::uint64_t received_mask_ = 0;
+	std::uint32_t window_ = 0;
+};
+
+inline std::ostream & operator<< (std::ostream & out, FragmentAckBody const& body)
+{
+	out << body.next_ << ' ' << body.received_mask_ << ' ' << body.window_;
+	return out;
+}
+
+template<>
+struct message_traits< FragmentAckBody >
+{ static CXX11_CONSTEXPR Header::type TYPE_ID = Header::FRAGMENT_ACK; };
+
+void serialize(FragmentAckBody const& body, buffer & b);
+
+std::error_code deserialize(buffer::const_iterator & i, buffer::const_iterator e, FragmentAckBody & body);
+
 struct StoreValueRequestBody final
 {
 	id data_key_hash_;
@@ -183,6 +285,75 @@ void serialize(StoreValueRequestBody const& body, buffer & b);
 
 std::error_code deserialize(buffer::const_iterator & i, buffer::const_iterator e, StoreValueRequestBody & body);
 
+struct MembershipEntry final
+{
+	Peer peer_;
+	std::uint64_t heartbeat_;
+};
+
+struct MembershipDigestBody
+	/// Gossiped part of a membership view, along
+	/// with the heartbeat of the sender.
+{
+	std::uint64_t heartbeat_ = 0;
+	std::vector<MembershipEntry> members_;
+};
+
+inline std::ostream & operator<< (std::ostream & out, MembershipDigestBody const& body)
+{
+	out << body.heartbeat_ << std::endl;
+	for (auto& m : body.members_)
+	{
+		out << '[' << m.peer_.endpoint_.toString() << "](" << m.peer_.id_ << "): " << m.heartbeat_ << std::endl;
+	}
+	return out;
+}
+
+void serialize(MembershipDigestBody const& body, buffer & b);
+
+std::error_code deserialize(buffer::const_iterator & i, buffer::const_iterator e, MembershipDigestBody & body);
+
+struct MembershipDigestRequestBody final : MembershipDigestBody
+{
+};
+
+template<>
+struct message_traits< MembershipDigestRequestBody >
+{ static CXX11_CONSTEXPR Header::type TYPE_ID = Header::MEMBERSHIP_DIGEST_REQUEST; };
+
+struct MembershipDigestResponseBody final : MembershipDigestBody
+{
+};
+
+template<>
+struct message_traits< MembershipDigestResponseBody >
+{ static CXX11_CONSTEXPR Header::type TYPE_ID = Header::MEMBERSHIP_DIGEST_RESPONSE; };
+
+struct RoutingTableSnapshotEntry final
+{
+	Peer peer_;
+	std::uint64_t last_seen_;
+		/// Milliseconds since the epoch.
+	std::uint32_t rtt_;
+		/// Round trip time, in milliseconds (0 if unknown).
+};
+
+struct RoutingTableSnapshot final
+	/// Routing table content saved across restarts. Not sent
+	/// over the network, but encoded like the message bodies.
+{
+	id id_;
+		/// Id of the node the routing table belongs to.
+	std::uint64_t time_ = 0;
+		/// When the snapshot has been taken, in milliseconds since the epoch.
+	std::vector<RoutingTableSnapshotEntry> peers_;
+		/// Peers, from the least to the most recently seen.
+};
+
+void serialize(RoutingTableSnapshot const& snapshot, buffer & b);
+
+std::error_code deserialize(buffer::const_iterator & i, buffer::const_iterator e, RoutingTableSnapshot & snapshot);
+
 } // namespace detail
 } // namespace kademlia
 
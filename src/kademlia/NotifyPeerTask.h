@@ -43,27 +43,28 @@ namespace kademlia {
 namespace detail {
 
 ///
-template<typename TrackerType, typename OnFinishType>
+template<typename TrackerType, typename RoutingTableType, typename OnFinishType>
 class NotifyPeerTask final : public LookupTask
 {
 public:
-	template<typename RoutingTableType>
-	static void start(detail::id const & key, TrackerType & tracker, RoutingTableType & routing_table, OnFinishType on_finish)
+	static void start(detail::id const & key, TrackerType & tracker, RoutingTableType & routing_table,
+		OnFinishType on_finish, lookup_config const& config = lookup_config())
 	{
 		std::shared_ptr<NotifyPeerTask> c;
-		c.reset(new NotifyPeerTask(key, tracker, routing_table, on_finish));
+		c.reset(new NotifyPeerTask(key, tracker, routing_table, on_finish, config));
 		try_to_notify_neighbors(c);
 	}
 
 private:
-	template<typename RoutingTableType>
-	NotifyPeerTask(detail::id const & key, TrackerType & tracker, RoutingTableType & routing_table, OnFinishType on_finish):
+	NotifyPeerTask(detail::id const & key, TrackerType & tracker, RoutingTableType & routing_table,
+		OnFinishType on_finish, lookup_config const& config):
 		LookupTask(key,
-			routing_table.find(key),
-			routing_table.end(),
+			routing_table,
 			tracker.addressV4(),
-			tracker.addressV6()),
+			tracker.addressV6(),
+			config),
 		tracker_(tracker),
+		routing_table_(routing_table),
 		on_finish_( on_finish )
 	{
 		LOG_DEBUG(NotifyPeerTask, this) << "create notify Peer task for '"<< key << "' Peer." << std::endl;
@@ -76,7 +77,7 @@ private:
 
 		FindPeerRequestBody const request{ task->get_key() };
 
-		auto closest_peers = task->select_new_closest_candidates(CONCURRENT_FIND_PEER_REQUESTS_COUNT);
+		auto closest_peers = task->select_new_closest_candidates(task->concurrency());
 
 		LOG_DEBUG(NotifyPeerTask, task.get()) << "sending find Peer to notify "
 				<< closest_peers.size() << " owner buckets." << std::endl;
@@ -102,11 +103,13 @@ private:
 		auto on_error = [ task, current_peer ] (std::error_code const&)
 		{
 			LOG_DEBUG(NotifyPeerTask, task.get()) << "invalid peer: '" << current_peer << "'." << std::endl;
+			task->routing_table_.flag_peer_as_unresponsive(current_peer.id_);
 			task->flag_candidate_as_invalid( current_peer.id_ );
             task->check_for_completion();
 		};
 
-		task->tracker_.send_request(request, current_peer.endpoint_, PEER_LOOKUP_TIMEOUT, on_message_received, on_error);
+		// The lookup tries unresponsive peers again itself.
+		task->tracker_.send_request(request, current_peer.endpoint_, PEER_LOOKUP_TIMEOUT, on_message_received, on_error, 0);
 	}
 
 	void check_for_completion()
@@ -139,15 +142,17 @@ private:
 
 private:
 	TrackerType & tracker_;
+	RoutingTableType & routing_table_;
 	OnFinishType on_finish_;
 };
 
 
 template<typename TrackerType, typename RoutingTableType, typename OnFinishType>
-void start_notify_peer_task(id const& key, TrackerType & tracker, RoutingTableType & routing_table, OnFinishType on_finish)
+void start_notify_peer_task(id const& key, TrackerType & tracker, RoutingTableType & routing_table,
+	OnFinishType on_finish, lookup_config const& config = lookup_config())
 {
-	using task = NotifyPeerTask<TrackerType, OnFinishType>;
-	task::start(key, tracker, routing_table, std::forward<OnFinishType>(on_finish));
+	using task = NotifyPeerTask<TrackerType, RoutingTableType, OnFinishType>;
+	task::start(key, tracker, routing_table, std::forward<OnFinishType>(on_finish), config);
 }
 
 } // namespace detail
@@ -1,5 +1,8 @@
 
 #include "ResponseRouter.h"
+#include <cassert>
+#include <utility>
+#include "kademlia/error_impl.hpp"
 #include "kademlia/log.hpp"
 
 using Poco::Net::SocketProactor;
@@ -8,8 +11,39 @@ using Poco::Net::SocketAddress;
 namespace kademlia {
 namespace detail {
 
+namespace {
 
-	ResponseRouter::ResponseRouter(SocketProactor &io_service): timer_(io_service)
+enum : std::size_t
+{
+	TOKEN_INDEX_OFFSET = 0,
+	TOKEN_GENERATION_OFFSET = 4
+};
+
+std::uint32_t read_token_field(id const& token, std::size_t offset)
+{
+	auto const b = token.begin() + offset;
+	return std::uint32_t(b[0]) << 24 | std::uint32_t(b[1]) << 16
+		| std::uint32_t(b[2]) << 8 | std::uint32_t(b[3]);
+}
+
+void write_token_field(id& token, std::size_t offset, std::uint32_t value)
+{
+	auto const b = token.begin() + offset;
+	b[0] = id::block_type(value >> 24);
+	b[1] = id::block_type(value >> 16);
+	b[2] = id::block_type(value >> 8);
+	b[3] = id::block_type(value);
+}
+
+} // anonymous namespace
+
+
+	ResponseRouter::ResponseRouter(SocketProactor &io_service):
+		slots_(),
+		free_slots_(),
+		pending_count_(0),
+		random_engine_(std::random_device{}()),
+		timer_(io_service)
 	{
 	}
 
@@ -18,14 +52,140 @@ namespace detail {
 											 buffer::const_iterator i, buffer::const_iterator e)
 	{
 		LOG_DEBUG(ResponseRouter, this) << "dispatching response from " << sender.toString() << std::endl;
-		std::error_code failure;
-		// Try to forward the message to its associated callback.
+		callback on_response_received;
+		{
+			Poco::Mutex::ScopedLock l(_mutex);
+			auto const s = find_slot(h.random_token_);
+			if (!s)
+			{
+				// Unknown or unassociated responses discarded.
+				LOG_DEBUG(ResponseRouter, this) << "dropping unknown response from " << sender.toString() << std::endl;
+				return;
+			}
+			on_response_received = std::move(s->on_response_received_);
+			release_slot(*s);
+		}
+		on_response_received(sender, h, i, e);
+	}
+
+
+	bool ResponseRouter::cancel(id const& token)
+	{
+		Poco::Mutex::ScopedLock l(_mutex);
+		auto const s = find_slot(token);
+		if (!s) return false;
+		release_slot(*s);
+		return true;
+	}
+
+
+	std::size_t ResponseRouter::pending_count() const
+	{
+		Poco::Mutex::ScopedLock l(_mutex);
+		return pending_count_;
+	}
+
+
+	id ResponseRouter::allocate_slot(callback const& on_response_received, error_callback const& on_error,
+		timeout_callback const& on_timeout)
+	{
+		std::uint32_t index;
+		if (free_slots_.empty())
+		{
+			index = std::uint32_t(slots_.size());
+			slots_.emplace_back();
+		}
+		else
+		{
+			index = free_slots_.back();
+			free_slots_.pop_back();
+		}
+
+		auto& s = slots_[index];
+		assert(!s.pending_);
+		++s.generation_;
+		s.token_ = id(random_engine_);
+		write_token_field(s.token_, TOKEN_INDEX_OFFSET, index);
+		write_token_field(s.token_, TOKEN_GENERATION_OFFSET, s.generation_);
+		s.on_response_received_ = on_response_received;
+		s.on_error_ = on_error;
+		s.on_timeout_ = on_timeout;
+		s.pending_ = true;
+		++pending_count_;
+		return s.token_;
+	}
+
+
+	ResponseRouter::slot* ResponseRouter::find_slot(id const& token)
+	{
+		auto const index = read_token_field(token, TOKEN_INDEX_OFFSET);
+		if (index >= slots_.size()) return nullptr;
+
+		// The random bits of the token are checked as well,
+		// so responses can't be forged from the index only.
+		auto& s = slots_[index];
+		if (!s.pending_ || s.token_ != token) return nullptr;
+		return &s;
+	}
+
+
+	void ResponseRouter::release_slot(slot& s)
+	{
+		s.pending_ = false;
+		s.on_response_received_ = nullptr;
+		s.on_error_ = nullptr;
+		s.on_timeout_ = nullptr;
+		timer_.cancel(s.timeout_);
+		s.timeout_ = Timer::handle();
+		--pending_count_;
+		free_slots_.push_back(read_token_field(s.token_, TOKEN_INDEX_OFFSET));
+	}
+
+
+	void ResponseRouter::wait_for_response(id const& token, Timer::duration const& ttl)
+	{
+		auto const h = timer_.expires_from_now(ttl, [this, token]
+		{
+			handle_timeout(token);
+		});
+
+		// The timeout is cancelled along with the slot.
+		Poco::Mutex::ScopedLock l(_mutex);
+		if (auto const s = find_slot(token)) s->timeout_ = h;
+		else timer_.cancel(h);
+	}
+
+
+	void ResponseRouter::handle_timeout(id const& token)
+	{
+		timeout_callback on_timeout;
+		{
+			Poco::Mutex::ScopedLock l(_mutex);
+			auto const s = find_slot(token);
+			// The response has been received.
+			if (!s) return;
+			on_timeout = s->on_timeout_;
+		}
+
+		// The slot is kept while on_timeout() decides, so
+		// that a response arriving meanwhile is delivered.
+		auto const ttl = on_timeout ? on_timeout() : Timer::duration::zero();
+
+		if (ttl > Timer::duration::zero())
+		{
+			wait_for_response(token, ttl);
+			return;
+		}
+
+		error_callback on_error;
 		{
 			Poco::Mutex::ScopedLock l(_mutex);
-			failure = response_callbacks_.dispatch_response(sender, h, i, e);
+			auto const s = find_slot(token);
+			if (!s) return;
+			on_error = std::move(s->on_error_);
+			release_slot(*s);
 		}
-		if (failure == UNASSOCIATED_MESSAGE_ID)// Unknown or unassociated responses discarded.
-			LOG_DEBUG(ResponseRouter, this) << "dropping unknown response from " << sender.toString() << std::endl;
+		on_error(make_error_code(std::errc::timed_out));
 	}
 
 } }
@@ -27,10 +27,15 @@
 #define KADEMLIA_RESPONSE_ROUTER_H
 
 
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <vector>
 #include "Poco/Net/SocketProactor.h"
 #include "kademlia/error.hpp"
+#include "kademlia/id.hpp"
 #include "Poco/Net/SocketAddress.h"
-#include "ResponseCallbacks.h"
+#include "Message.h"
 #include "kademlia/Timer.h"
 #include "kademlia/log.hpp"
 #include "Poco/Mutex.h"
@@ -41,8 +46,22 @@ namespace detail {
 
 
 class ResponseRouter final
+	/// Routes responses to the callbacks of the requests they answer.
+	///
+	/// Pending requests are kept in a slab of slots recycled through a
+	/// free list. The token of a request holds its slot index and the
+	/// slot generation (its remaining bits are random), so the slot of
+	/// a response is found in O(1) and a late response can't reach the
+	/// request which reused the slot. The timeout of a request is
+	/// cancelled as soon as its slot is released. A single lock protects
+	/// the slots and callbacks are called without holding it.
 {
 public:
+	using callback = std::function<void (Poco::Net::SocketAddress const& sender, Header const& h,
+		buffer::const_iterator i, buffer::const_iterator e)>;
+	using error_callback = std::function<void (std::error_code const& failure)>;
+	using timeout_callback = std::function<Timer::duration ()>;
+
 	explicit ResponseRouter(Poco::Net::SocketProactor& io_service);
 
 	ResponseRouter(ResponseRouter const&) = delete;
@@ -53,32 +72,70 @@ public:
 		buffer::const_iterator i, buffer::const_iterator e );
 
 	template< typename OnResponseReceived, typename OnError >
-	void register_temporary_callback(id const& response_id, Timer::duration const& callback_ttl
+	id register_temporary_callback(Timer::duration const& callback_ttl
 		, OnResponseReceived const& on_response_received, OnError const& on_error )
+		/// Returns the token the response must carry. on_error is told
+		/// the request timed out if the response doesn't arrive within
+		/// callback_ttl.
 	{
-		auto on_timeout = [ this, on_error, response_id ] ()
-		{
-			// If a callback is removed, that means
-			// the message has never been received
-			// hence report the timeout to the client.
-			Poco::Mutex::ScopedLock l(_mutex);
-			if (response_callbacks_.remove_callback( response_id ))
-				on_error(make_error_code(std::errc::timed_out));
-		};
+		return register_temporary_callback(callback_ttl, on_response_received, on_error,
+			timeout_callback());
+	}
 
-		// Associate the response id with the
-		// on_response_received callback.
+	template< typename OnResponseReceived, typename OnError, typename OnTimeout >
+	id register_temporary_callback(Timer::duration const& callback_ttl
+		, OnResponseReceived const& on_response_received, OnError const& on_error
+		, OnTimeout const& on_timeout )
+		/// Likewise, but on_timeout() is called first on each timeout
+		/// and returns how long to keep waiting for the response (e.g.
+		/// after a retransmission), zero to give up.
+	{
+		id token;
 		{
 			Poco::Mutex::ScopedLock l(_mutex);
-			response_callbacks_.push_callback(response_id, on_response_received);
+			token = allocate_slot(on_response_received, on_error, on_timeout);
 		}
-		timer_.expires_from_now(callback_ttl, on_timeout);
+		wait_for_response(token, callback_ttl);
+		return token;
 	}
 
+	bool cancel(id const& token);
+		/// Forgets a pending request, none of its callbacks will be called.
+		/// Returns false if the request wasn't pending.
+
+	std::size_t pending_count() const;
+		/// Returns the count of requests waiting for their response.
+
+private:
+	struct slot
+	{
+		id token_;
+		callback on_response_received_;
+		error_callback on_error_;
+		timeout_callback on_timeout_;
+		Timer::handle timeout_;
+		std::uint32_t generation_ = 0;
+		bool pending_ = false;
+	};
+
+	id allocate_slot(callback const& on_response_received, error_callback const& on_error,
+		timeout_callback const& on_timeout);
+
+	slot* find_slot(id const& token);
+
+	void release_slot(slot& s);
+
+	void wait_for_response(id const& token, Timer::duration const& ttl);
+
+	void handle_timeout(id const& token);
+
 private:
-	ResponseCallbacks response_callbacks_;
+	std::vector<slot> slots_;
+	std::vector<std::uint32_t> free_slots_;
+	std::size_t pending_count_;
+	std::default_random_engine random_engine_;
 	Timer timer_;
-	Poco::Mutex _mutex;
+	mutable Poco::Mutex _mutex;
 };
 
 } // namespace detail
@@ -18,6 +18,7 @@
 #include "kademlia/constants.hpp"
 #include "error_impl.hpp"
 #include "SocketAdapter.h"
+#include "BatchedSocketAdapter.h"
 #include "Engine.h"
 #include "Poco/Timespan.h"
 #include "Poco/Thread.h"
@@ -33,15 +34,26 @@ using Poco::Stopwatch;
 class EngineImpl
 {
 public:
+#if defined(KADEMLIA_BATCHED_SOCKET) && defined(__linux__)
+	using SocketType = kademlia::detail::BatchedSocketAdapter<Poco::Net::DatagramSocket>;
+#else
 	using SocketType = kademlia::detail::SocketAdapter<Poco::Net::DatagramSocket>;
+#endif
 	using EngineType = kademlia::detail::Engine<SocketType>;
 
-	EngineImpl(Poco::Net::SocketProactor& ioService, Endpoint const& ipv4, Endpoint const& ipv6):
-		_engine(ioService, ipv4, ipv6)
+	EngineImpl(Poco::Net::SocketProactor& ioService, Endpoint const& ipv4, Endpoint const& ipv6,
+		Session::ConfigType const& config):
+		_engine(ioService, ipv4, ipv6, kademlia::detail::id{}, true, config)
 	{}
 
-	EngineImpl(Poco::Net::SocketProactor& ioService, Endpoint const& initPeer, Endpoint const& ipv4, Endpoint const& ipv6):
-		_engine(ioService, initPeer, ipv4, ipv6)
+	EngineImpl(Poco::Net::SocketProactor& ioService, Endpoint const& initPeer, Endpoint const& ipv4, Endpoint const& ipv6,
+		Session::ConfigType const& config):
+		_engine(ioService, initPeer, ipv4, ipv6, kademlia::detail::id{}, config)
+	{}
+
+	EngineImpl(Poco::Net::SocketProactor& ioService, Endpoint const& initPeer, Endpoint const& ipv4, Endpoint const& ipv6,
+		std::string const& routingTableFile, Session::ConfigType const& config):
+		_engine(ioService, initPeer, ipv4, ipv6, routingTableFile, config)
 	{}
 
 	EngineType& engine()
@@ -57,11 +69,11 @@ private:
 const std::uint16_t Session::DEFAULT_PORT = 27980;
 
 
-Session::Session(Endpoint const& ipv4, Endpoint const& ipv6, int ms)
+Session::Session(Endpoint const& ipv4, Endpoint const& ipv6, int ms, ConfigType const& config)
 try:
 	_runMethod(this, &Kademlia::Session::run),
 	_ioService(Timespan(Timespan::TimeDiff(ms)*1000)),
-	_pEngine(new EngineImpl(_ioService, ipv4, ipv6))
+	_pEngine(new EngineImpl(_ioService, ipv4, ipv6, config))
 	{
 		result();
 		if (!tryWaitForIOService(static_cast<int>(kademlia::detail::INITIAL_CONTACT_RECEIVE_TIMEOUT.count())))
@@ -80,11 +92,36 @@ catch (...)
 }
 
 
-Session::Session(Endpoint const& initPeer, Endpoint const& ipv4, Endpoint const& ipv6, int ms)
+Session::Session(Endpoint const& initPeer, Endpoint const& ipv4, Endpoint const& ipv6, int ms,
+	ConfigType const& config)
 try :
 	_runMethod(this, &Kademlia::Session::run),
 	_ioService(Poco::Timespan(Poco::Timespan::TimeDiff(ms) * 1000)),
-	_pEngine(new EngineImpl(_ioService, initPeer, ipv4, ipv6))
+	_pEngine(new EngineImpl(_ioService, initPeer, ipv4, ipv6, config))
+	{
+		result();
+		if (!tryWaitForIOService(static_cast<int>(kademlia::detail::INITIAL_CONTACT_RECEIVE_TIMEOUT.count())))
+			throw Poco::TimeoutException("Session: IO service not available.");
+		Poco::Thread::sleep(100);
+	}
+catch (std::exception& ex)
+{
+	std::cerr << ex.what() << std::endl;
+	throw;
+}
+catch (...)
+{
+	std::cerr << "unknown exception" << std::endl;
+	throw;
+}
+
+
+Session::Session(Endpoint const& initPeer, Endpoint const& ipv4, Endpoint const& ipv6,
+	std::string const& routingTableFile, int ms, ConfigType const& config)
+try :
+	_runMethod(this, &Kademlia::Session::run),
+	_ioService(Poco::Timespan(Poco::Timespan::TimeDiff(ms) * 1000)),
+	_pEngine(new EngineImpl(_ioService, initPeer, ipv4, ipv6, routingTableFile, config))
 	{
 		result();
 		if (!tryWaitForIOService(static_cast<int>(kademlia::detail::INITIAL_CONTACT_RECEIVE_TIMEOUT.count())))
@@ -151,6 +188,18 @@ bool Session::initialized() const
 }
 
 
+void Session::enableOneHopRouting()
+{
+	_pEngine->engine().enable_one_hop_routing();
+}
+
+
+void Session::enableLoadCache(std::chrono::milliseconds period)
+{
+	_pEngine->engine().enable_load_cache(period);
+}
+
+
 std::error_code Session::run()
 {
 	Poco::FastMutex::ScopedLock l(_mutex);
@@ -194,4 +243,10 @@ const Session::ValueStoreType& Session::data() const
 	return _pEngine->engine().data();
 }
 
+
+Session::LookupStatsType Session::lookupStats() const
+{
+	return _pEngine->engine().lookup_statistics();
+}
+
 } // namespace kademlia
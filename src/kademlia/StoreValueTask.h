@@ -44,32 +44,35 @@ namespace kademlia {
 namespace detail {
 
 ///
-template< typename SaveHandlerType, typename TrackerType, typename DataType >
+template< typename SaveHandlerType, typename TrackerType, typename RoutingTableType, typename DataType >
 class StoreValueTask final : public LookupTask
 {
 public:
-	template< typename RoutingTableType >
 	static void
 	start(detail::id const & key, DataType&& data, TrackerType & tracker
-		, RoutingTableType & routing_table, SaveHandlerType handler)
+		, RoutingTableType & routing_table, SaveHandlerType handler
+		, lookup_config const& config = lookup_config())
 	{
 		std::shared_ptr< StoreValueTask > c;
-		c.reset(new StoreValueTask(key, std::move(data), tracker, routing_table, std::move(handler)));
+		c.reset(new StoreValueTask(key, std::move(data), tracker, routing_table, std::move(handler), config));
 		try_to_store_value(c);
 	}
 
 private:
-	template< typename RoutingTableType, typename HandlerType >
+	template< typename HandlerType >
 	StoreValueTask(detail::id const & key, DataType&& data, TrackerType & tracker
-		, RoutingTableType & routing_table, HandlerType && save_handler):
+		, RoutingTableType & routing_table, HandlerType && save_handler, lookup_config const& config):
 			LookupTask(key,
-				routing_table.find(key),
-				routing_table.end(),
+				routing_table,
 				tracker.addressV4(),
-				tracker.addressV6())
+				tracker.addressV6(),
+				config)
 			, tracker_(tracker)
+			, routing_table_(routing_table)
 			, data_(std::move(data))
 			, save_handler_(std::forward< HandlerType >(save_handler))
+			, redundant_save_count_(config.redundant_save_count_)
+			, is_finished_()
 	{
 		LOG_DEBUG(StoreValueTask, this)
 				<< "create store value task for '"
@@ -82,21 +85,27 @@ private:
 		save_handler_(failure);
 	}
 
+	bool is_finished() const
+	{
+		return is_finished_;
+	}
+
 	DataType const& get_data() const
 	{
 		return data_;
 	}
 
-	static void try_to_store_value(std::shared_ptr< StoreValueTask > task,
-		std::size_t concurrent_requests_count = CONCURRENT_FIND_PEER_REQUESTS_COUNT)
+	static void try_to_store_value(std::shared_ptr< StoreValueTask > task)
 	{
+		if (task->is_finished()) return;
+
 		LOG_DEBUG(StoreValueTask, task.get())
 				<< "trying to find closer Peer to store '"
 				<< task->get_key() << "' value." << std::endl;
 
 		FindPeerRequestBody const request{ task->get_key() };
 
-		auto const closest_candidates = task->select_new_closest_candidates(concurrent_requests_count);
+		auto const closest_candidates = task->select_new_closest_candidates(task->concurrency());
 
 		LOG_DEBUG(StoreValueTask, task.get()) << "inFlightRequests=" << task->inFlightRequests() <<
 		", closest candidates count: " << closest_candidates.size() << std::endl;
@@ -104,10 +113,10 @@ private:
 		for (auto const& c : closest_candidates)
 			send_find_peer_to_store_request(request, c, task);
 
-		// If no more requests are in flight
-		// we know the closest peers hence ask
-		// them to store the value.
-		if (task->have_all_requests_completed())
+		// If the closest peers responded or no more
+		// requests are in flight we know the closest
+		// peers hence ask them to store the value.
+		if (task->have_converged() || task->have_all_requests_completed())
 			send_store_requests(task);
 	}
 
@@ -129,14 +138,15 @@ private:
 		// On error, retry with another endpoint.
 		auto on_error = [ task, current_candidate ] (std::error_code const&)
 		{
-			// XXX: Can also flag candidate as invalid is
-			// present in routing table.
+			task->routing_table_.flag_peer_as_unresponsive(current_candidate.id_);
 			task->flag_candidate_as_invalid(current_candidate.id_);
 			try_to_store_value(task);
 		};
 
-		task->tracker_.send_request(request, current_candidate.endpoint_,
-			PEER_LOOKUP_TIMEOUT, on_message_received, on_error);
+		// The lookup tries unresponsive candidates again itself.
+		auto const response_id = task->tracker_.send_request(request, current_candidate.endpoint_,
+			PEER_LOOKUP_TIMEOUT, on_message_received, on_error, 0);
+		task->flag_request_in_flight(current_candidate.id_, response_id);
 	}
 
 	static void handle_find_peer_to_store_response(Poco::Net::SocketAddress const& s, Header const& h,
@@ -176,7 +186,12 @@ private:
 
 	static void send_store_requests(std::shared_ptr<StoreValueTask> task)
 	{
-		auto const & candidates = task->select_closest_valid_candidates(REDUNDANT_SAVE_COUNT);
+		if (task->is_finished()) return;
+		task->is_finished_ = true;
+		// The farther peers still looked up are of no use now.
+		task->cancel_requests(task->tracker_);
+
+		auto const & candidates = task->select_closest_valid_candidates(task->redundant_save_count_);
 		if (candidates.empty())
 			task->notify_caller(make_error_code(MISSING_PEERS));
 		else
@@ -202,8 +217,11 @@ private:
 
 private:
 	TrackerType & tracker_;
+	RoutingTableType & routing_table_;
 	DataType data_;
 	SaveHandlerType save_handler_;
+	std::size_t redundant_save_count_;
+	bool is_finished_;
 };
 
 /**
@@ -211,12 +229,12 @@ private:
  */
 template< typename DataType, typename TrackerType, typename RoutingTableType, typename HandlerType >
 void start_store_value_task(id const& key, DataType&& data, TrackerType& tracker,
-	RoutingTableType& routing_table, HandlerType&& save_handler)
+	RoutingTableType& routing_table, HandlerType&& save_handler, lookup_config const& config = lookup_config())
 {
 	using handler_type = typename std::decay< HandlerType >::type;
-	using task = StoreValueTask< handler_type, TrackerType, DataType >;
+	using task = StoreValueTask< handler_type, TrackerType, RoutingTableType, DataType >;
 
-	task::start(key, std::move(data), tracker, routing_table, std::forward< HandlerType >(save_handler));
+	task::start(key, std::move(data), tracker, routing_table, std::forward< HandlerType >(save_handler), config);
 }
 
 } // namespace detail
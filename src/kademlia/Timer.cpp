@@ -25,6 +25,9 @@
 
 #include "Timer.h"
 #include "kademlia/error_impl.hpp"
+#include <algorithm>
+#include <limits>
+#include <vector>
 
 using namespace std::chrono;
 using namespace Poco;
@@ -33,57 +36,81 @@ using namespace Poco::Net;
 namespace kademlia {
 namespace detail {
 
+namespace {
+
+auto const NO_TICK = std::numeric_limits<timing_wheel::tick_type>::max();
+
+} // anonymous namespace
+
+
 Timer::Timer(SocketProactor& ioService): _ioService(ioService),
-	timeouts_{}
+	epoch_(clock::now()),
+	timeouts_{},
+	scheduled_tick_(NO_TICK)
 {
 	LOG_DEBUG(Timer, this) << "Timer created." << std::endl;
 }
 
-void Timer::schedule_next_tick(time_point const& expiration_time)
+
+bool Timer::cancel(handle const& h)
 {
-	LOG_DEBUG(Timer, this) << "\tscheduling next tick ..." << std::endl;
-	auto on_fire = [this]()
-	{
-		Poco::Mutex::ScopedLock l(_mutex);
-		if (!timeouts_.empty())
-		{
-			LOG_DEBUG(Timer, this) << "\ttimeouts=" << timeouts_.size() << std::endl;
-			// The callbacks to execute are the first
-			// n callbacks with the same keys.
-			auto begin = timeouts_.begin();
-			auto end = timeouts_.upper_bound(begin->first);
-			// Call the user callbacks.
-			for (auto i = begin; i != end; ++i)
-			{
-				LOG_DEBUG(Timer, this) << "\tcallback()" << std::endl;
-				i->second();
-			}
-
-			// And remove the timeout.
-			timeouts_.erase(begin, end);
-		}
-		// If there is a remaining timeout, schedule it.
-		if (!timeouts_.empty())
-		{
-			LOG_DEBUG(Timer, this) << "\tschedule remaining timers" << std::endl;
-			schedule_next_tick(timeouts_.begin()->first);
-		}
-	};
+	// The scheduled work is kept, it will find nothing to do.
+	Poco::Mutex::ScopedLock l(_mutex);
+	return timeouts_.cancel(h);
+}
 
-	int tout = static_cast<int>(getTimeout(expiration_time));
-	if (tout < 0)
-		LOG_DEBUG(Timer, this) << "\ttimer expired: " << tout << " [ms]" << std::endl;
 
-	_ioService.addWork(std::move(on_fire), tout);
+std::size_t Timer::pending_count() const
+{
+	Poco::Mutex::ScopedLock l(_mutex);
+	return timeouts_.size();
+}
+
+
+Timer::tick_type Timer::to_tick(time_point const& t, rounding r) const
+{
+	auto const d = t - epoch_;
+	auto ticks = duration_cast<duration>(d).count();
+	if (r == ROUND_UP && duration(ticks) < d) ++ticks;
+	return tick_type(std::max<duration::rep>(ticks, 0));
+}
+
+
+void Timer::schedule_next_tick()
+{
+	if (timeouts_.empty()) return;
+
+	// A work already scheduled earlier will reschedule
+	// the next tick once done.
+	auto const next = timeouts_.next_tick();
+	if (next >= scheduled_tick_) return;
+
+	scheduled_tick_ = next;
+	auto const now = to_tick(clock::now(), ROUND_DOWN);
+	auto const tout = next > now ? Poco::Int64(next - now) : 0;
+	_ioService.addWork([this, next] { handle_tick(next); }, tout);
 	LOG_DEBUG(Timer, this) << "\tscheduled timer in " << tout << " [ms]" << std::endl;
 }
 
 
-Poco::Timestamp::TimeDiff Timer::getTimeout(time_point const& expiration_time)
+void Timer::handle_tick(tick_type tick)
 {
-	auto t = duration_cast<microseconds>(expiration_time.time_since_epoch());
-	Poco::Timestamp ts(t.count() - duration_cast<microseconds>(clock().now().time_since_epoch()).count());
-	return ts.epochMicroseconds()/1000;
+	std::vector<callback> expired;
+	{
+		Poco::Mutex::ScopedLock l(_mutex);
+		// Works superseded by an earlier one only advance the wheel.
+		if (tick == scheduled_tick_) scheduled_tick_ = NO_TICK;
+		timeouts_.advance(to_tick(clock::now(), ROUND_DOWN), [&expired](callback& c)
+		{
+			expired.push_back(std::move(c));
+		});
+		LOG_DEBUG(Timer, this) << "\texpired=" << expired.size()
+			<< " timeouts=" << timeouts_.size() << std::endl;
+		schedule_next_tick();
+	}
+
+	for (auto& c : expired)
+		c();
 }
 
 
@@ -27,10 +27,10 @@
 #define KADEMLIA_TIMER_H
 
 
-#include <map>
 #include <chrono>
 #include <functional>
 #include "Poco/Net/SocketProactor.h"
+#include "kademlia/timing_wheel.hpp"
 #include "kademlia/log.hpp"
 #include "Poco/Mutex.h"
 
@@ -40,62 +40,56 @@ namespace detail {
 
 
 class Timer final
+	/// Calls callbacks after a timeout, with a millisecond resolution.
+	///
+	/// Timeouts are kept in a timing_wheel, and a single proactor work
+	/// is scheduled at the next tick the wheel has something to do.
+	/// Expired callbacks are called without holding the lock.
 {
 public:
 	using clock = std::chrono::steady_clock;
 	using duration = std::chrono::milliseconds;
+	using handle = timing_wheel::handle;
 
 public:
 	explicit Timer(Poco::Net::SocketProactor& ioService);
 
 	template< typename Callback >
-	void expires_from_now(duration const& timeout, Callback const& on_timer_expired)
+	handle expires_from_now(duration const& timeout, Callback const& on_timer_expired)
+		/// Returns the handle to cancel() the timeout.
 	{
-		auto expiration_time = clock::now() + std::chrono::duration_cast<clock::duration>(timeout);
-
-		// this lambda is a workaround to enforce asio behavior (timer cancellation
-		// is considered a task); it removes all but one scheduled completion handler,
-		// and then removes itself (registered as permanent handler, always at the
-		// beginning of the handlers queue)
-		auto on_next_run = [this] ()
-		{
-			int schedComplHandlerCnt = _ioService.scheduledWork();
-			if (schedComplHandlerCnt > 0)
-			{
-				LOG_DEBUG(Timer, this) << "removing " << schedComplHandlerCnt << " scheduled handlers" << std::endl;
-				_ioService.removeScheduledWork(schedComplHandlerCnt-1);
-			}
-			_ioService.removePermanentWork(1);
-		};
+		auto const expiration_time = clock::now() + std::chrono::duration_cast<clock::duration>(timeout);
 
 		Poco::Mutex::ScopedLock l(_mutex);
-		// If the current expiration time will be the sooner to expire
-		// then cancel any pending wait and schedule this one instead.
-		if (timeouts_.empty() || expiration_time < timeouts_.begin()->first)
-		{
-			if (_ioService.scheduledWork())
-			{
-				_ioService.addWork(std::move(on_next_run),
-					Poco::Net::SocketProactor::PERMANENT_COMPLETION_HANDLER, 0);
-			}
-			schedule_next_tick(expiration_time);
-		}
-
-		timeouts_.emplace(expiration_time, on_timer_expired);
+		auto const h = timeouts_.insert(to_tick(expiration_time, ROUND_UP), on_timer_expired);
+		schedule_next_tick();
+		return h;
 	}
 
+	bool cancel(handle const& h);
+		/// Forgets the timeout, returns false if it already expired
+		/// or has been cancelled.
+
+	std::size_t pending_count() const;
+		/// Returns the count of timeouts not expired yet.
+
 private:
 	using time_point = clock::time_point;
-	using callback = std::function< void (void) >;
-	using timeouts = std::multimap< time_point, callback >;
+	using callback = timing_wheel::callback;
+	using tick_type = timing_wheel::tick_type;
+
+	enum rounding { ROUND_DOWN, ROUND_UP };
 
-	void schedule_next_tick(time_point const& expiration_time);
-	Poco::Timestamp::TimeDiff getTimeout(time_point const& expiration_time);
+	tick_type to_tick(time_point const& t, rounding r) const;
+	void schedule_next_tick();
+	void handle_tick(tick_type tick);
 
 private:
 	Poco::Net::SocketProactor& _ioService;
-	timeouts timeouts_;
-	Poco::Mutex _mutex;
+	time_point const epoch_;
+	timing_wheel timeouts_;
+	tick_type scheduled_tick_;
+	mutable Poco::Mutex _mutex;
 };
 
 } // namespace detail
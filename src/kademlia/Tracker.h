@@ -30,6 +30,13 @@
 #   pragma once
 #endif
 
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
 #include "Poco/Net/SocketProactor.h"
 #include "Poco/Net/SocketAddress.h"
 #include "kademlia/log.hpp"
@@ -40,6 +47,10 @@
 #include "kademlia/routing_table.hpp"
 #include "kademlia/value_store.hpp"
 #include "kademlia/constants.hpp"
+#include "kademlia/packed_endpoint.hpp"
+#include "kademlia/rtt_estimator.hpp"
+#include "kademlia/fragmentation.hpp"
+#include "Poco/Mutex.h"
 
 
 namespace kademlia {
@@ -51,15 +62,28 @@ class Tracker final
 {
 public:
 	using random_engine_type = RandomEngineType;
+	using round_trip_handler_type = std::function<void (id const& peer_id, std::chrono::microseconds rtt)>;
+	using message_sent_handler_type = std::function<void (std::error_code const&)>;
 
 public:
 	Tracker(Poco::Net::SocketProactor& io_service, id const& my_id,
-		NetworkType & network, random_engine_type & random_engine):
+		NetworkType & network, random_engine_type & random_engine,
+		round_trip_handler_type on_round_trip = round_trip_handler_type()):
+			/// on_round_trip is told the time elapsed between sending
+			/// each request and dispatching its response.
 			io_service_(io_service),
 			response_router_(io_service),
+			timer_(io_service),
 			message_serializer_(my_id),
 			network_(network),
-			random_engine_(random_engine)
+			random_engine_(random_engine),
+			on_round_trip_(std::move(on_round_trip)),
+			max_datagram_message_size_(MAX_DATAGRAM_MESSAGE_SIZE),
+			outgoing_transfers_(),
+			incoming_transfers_(),
+			completed_transfers_(),
+			reassembly_buffers_size_(0),
+			is_transfers_expiry_scheduled_(false)
 	{
 		LOG_DEBUG(Tracker, this) << "Tracker created" << std::endl;
 	}
@@ -73,29 +97,79 @@ public:
 	}
 
 	template< typename Request, typename OnResponseReceived, typename OnError >
-	void send_request(Request const& request, const Poco::Net::SocketAddress& e, Timer::duration const& timeout
-		, OnResponseReceived const& on_response_received, OnError const& on_error)
+	id send_request(Request const& request, const Poco::Net::SocketAddress& e, Timer::duration const& timeout
+		, OnResponseReceived const& on_response_received, OnError const& on_error
+		, std::size_t max_retransmissions_count = MAX_REQUEST_RETRANSMISSION_COUNT)
+		/// Waits for the response during the retransmission timeout
+		/// estimated from the round trip times measured with the peer
+		/// (timeout if none has been measured yet), then sends the
+		/// request again with the same token and twice the timeout, up
+		/// to max_retransmissions_count times, before on_error is told
+		/// the request timed out. Callers which retry on their own
+		/// (e.g. lookups) pass 0. Requests aren't retransmitted while
+		/// the request or its response is sent in fragments.
+		///
+		/// Returns the token of the request, to cancel_request() it.
 	{
 		waitOnIO();
-		id const response_id(random_engine_);
-		// Generate the request buffer.
-		auto message = message_serializer_.serialize(request, response_id);
+		auto r = std::make_shared<pending_request>();
+		r->endpoint_ = e;
+		r->timeout_ = request_timeout(e, timeout);
+		r->retransmissions_count_ = 0;
+		r->max_retransmissions_count_ = max_retransmissions_count;
 
-		// This lambda will keep the request message alive.
-		auto on_request_sent =
-			[this, response_id, on_response_received,
-				on_error, timeout](std::error_code const& failure)
+		auto on_response = [this, r, on_response_received](Poco::Net::SocketAddress const& s,
+			Header const& h, buffer::const_iterator i, buffer::const_iterator e)
 		{
-			if (failure) on_error(failure);
-			else
-				response_router_.register_temporary_callback(response_id,
-					timeout, on_response_received, on_error);
+			// A response to a retransmitted request may answer any of
+			// its transmissions, hence it isn't sampled (Karn's algorithm).
+			// Neither are fragmented transfers, which take longer.
+			if (r->retransmissions_count_ == 0 && r->transfer_id_ == id{}
+				&& std::size_t(std::distance(i, e)) < max_datagram_message_size())
+			{
+				auto const rtt = std::chrono::duration_cast<std::chrono::microseconds>(Timer::clock::now() - r->sent_);
+				{
+					Poco::Mutex::ScopedLock l(_mutex);
+					rtt_estimators_.update(packed_endpoint(r->endpoint_), rtt);
+				}
+				if (on_round_trip_)
+					on_round_trip_(h.source_id_, rtt);
+			}
+			on_response_received(s, h, i, e);
 		};
 
-		LOG_DEBUG(Tracker, this) << "sending message ..." << std::endl;
-		// Serialize the request and send it.
-		network_.send(std::move(message), e, std::move(on_request_sent));
-		LOG_DEBUG(Tracker, this) << "message sent." << std::endl;
+		auto on_timeout = [this, r, on_error]
+		{
+			if (is_transferring(r->transfer_id_, r->response_id_))
+				return r->timeout_;
+
+			if (r->retransmissions_count_ >= r->max_retransmissions_count_)
+				return Timer::duration::zero();
+
+			++r->retransmissions_count_;
+			r->timeout_ = std::min(r->timeout_ * 2, std::max(r->timeout_, MAX_REQUEST_TIMEOUT));
+			LOG_DEBUG(Tracker, this) << "retransmitting request to " << r->endpoint_.toString()
+				<< " (" << r->retransmissions_count_ << ")." << std::endl;
+			transmit(r, on_error);
+			return r->timeout_;
+		};
+
+		// The token is known before sending, hence
+		// even an immediate response finds its slot.
+		r->response_id_ = response_router_.register_temporary_callback(r->timeout_,
+			on_response, on_error, on_timeout);
+		// Generate the request buffer.
+		r->message_ = message_serializer_.serialize(request, r->response_id_);
+		transmit(r, on_error);
+		return r->response_id_;
+	}
+
+	bool cancel_request(id const& response_id)
+		/// Stops waiting for the response: the callbacks of the request
+		/// are released right away and won't be called. Returns false
+		/// if the request already completed.
+	{
+		return response_router_.cancel(response_id);
 	}
 
 	template<typename Request>
@@ -114,7 +188,7 @@ public:
 		auto on_response_sent = [] (std::error_code const& /* failure */)
 		{ };
 
-		network_.send(std::move(message), e, on_response_sent);
+		send_message(std::move(message), e, on_response_sent);
 	}
 
 	void handle_new_response(Poco::Net::SocketAddress const& s, Header const& h,
@@ -123,6 +197,123 @@ public:
 		response_router_.handle_new_response(s, h, i, e);
 	}
 
+	void fragment_messages_larger_than(std::size_t size)
+		/// Messages larger than size (MAX_DATAGRAM_MESSAGE_SIZE by
+		/// default) are sent in fragments of MAX_FRAGMENT_SIZE bytes.
+		/// Peers must understand fragments to receive them.
+	{
+		Poco::Mutex::ScopedLock l(_mutex);
+		max_datagram_message_size_ = std::min(std::max(size, MAX_FRAGMENT_SIZE), MAX_DATAGRAM_MESSAGE_SIZE);
+	}
+
+	template< typename OnMessageReassembled >
+	void handle_fragment(Poco::Net::SocketAddress const& s, Header const& h,
+		buffer::const_iterator i, buffer::const_iterator e, OnMessageReassembled const& on_message_reassembled)
+		/// Acknowledges the fragment when asked to, or when it isn't
+		/// the next one expected, and once the message is complete.
+		/// The message is then given to on_message_reassembled(buffer const&).
+	{
+		FragmentBody fragment;
+		if (auto failure = deserialize(i, e, fragment))
+		{
+			LOG_DEBUG(Tracker, this) << "failed to deserialize fragment ("
+				<< failure.message() << ")" << std::endl;
+			return;
+		}
+
+		FragmentAckBody ack;
+		buffer message;
+		bool is_ack_needed = false;
+		{
+			Poco::Mutex::ScopedLock l(_mutex);
+			auto const now = Timer::clock::now();
+			auto const t = find_incoming_transfer(s, h.random_token_, fragment, now);
+			if (t == incoming_transfers_.end())
+			{
+				// Fragments of completed transfers are acknowledged
+				// again, in case the last acknowledgement was lost.
+				if (!completed_transfers_.count(h.random_token_)) return;
+				ack.next_ = fragment.count_;
+				ack.window_ = std::uint32_t(fragment_window());
+				is_ack_needed = true;
+			}
+			else
+			{
+				auto& r = t->second.reassembler_;
+				auto const expected = r.next();
+				auto const is_new = r.add(fragment.index_, fragment.data_.cbegin(), fragment.data_.cend());
+				t->second.last_received_ = now;
+
+				// The first fragment tells which request a response answers.
+				Header message_header;
+				auto j = fragment.data_.cbegin();
+				if (is_new && fragment.index_ == 0 && !deserialize(j, fragment.data_.cend(), message_header))
+					t->second.response_id_ = message_header.random_token_;
+
+				is_ack_needed = !is_new || fragment.index_ != expected
+					|| (fragment.flags_ & FragmentBody::ACK_REQUESTED) || r.complete();
+				ack.next_ = r.next();
+				ack.received_mask_ = r.received_mask();
+				ack.window_ = std::uint32_t(fragment_window());
+
+				if (r.complete())
+				{
+					message.swap(r.message());
+					reassembly_buffers_size_ -= r.size();
+					incoming_transfers_.erase(t);
+					completed_transfers_.emplace(h.random_token_, now);
+				}
+			}
+		}
+
+		if (is_ack_needed)
+			send_response(h.random_token_, ack, s);
+		if (!message.empty())
+			on_message_reassembled(message);
+	}
+
+	void handle_fragment_ack(Poco::Net::SocketAddress const& s, Header const& h,
+		buffer::const_iterator i, buffer::const_iterator e)
+	{
+		FragmentAckBody ack;
+		if (auto failure = deserialize(i, e, ack))
+		{
+			LOG_DEBUG(Tracker, this) << "failed to deserialize fragment ack ("
+				<< failure.message() << ")" << std::endl;
+			return;
+		}
+
+		std::shared_ptr<outgoing_transfer> t;
+		bool progress = false, complete = false;
+		{
+			Poco::Mutex::ScopedLock l(_mutex);
+			auto const found = outgoing_transfers_.find(h.random_token_);
+			if (found == outgoing_transfers_.end() || found->second->endpoint_ != s) return;
+
+			t = found->second;
+			progress = t->sender_.on_ack(ack.next_, ack.received_mask_, ack.window_);
+			if (progress) t->timeouts_count_ = 0;
+
+			complete = t->sender_.complete();
+			if (complete)
+			{
+				timer_.cancel(t->timeout_);
+				outgoing_transfers_.erase(found);
+			}
+		}
+
+		if (complete)
+		{
+			LOG_DEBUG(Tracker, this) << "sent " << t->sender_.count() << " fragments to "
+				<< s.toString() << "." << std::endl;
+			t->on_message_sent_(std::error_code{});
+			return;
+		}
+
+		send_fragments(t);
+		if (progress) schedule_transfer_timeout(t);
+	}
+
 	Poco::Net::SocketAddress addressV4()
 	{
 		return network_.addressV4();
@@ -133,12 +324,331 @@ public:
 		return network_.addressV6();
 	}
 
+	Timer::duration request_timeout(Poco::Net::SocketAddress const& e, Timer::duration const& initial_timeout)
+		/// Returns the timeout of a first transmission to e.
+	{
+		Poco::Mutex::ScopedLock l(_mutex);
+		auto const estimator = rtt_estimators_.find(packed_endpoint(e));
+		if (!estimator) return initial_timeout;
+
+		auto const rto = estimator->rto(MIN_REQUEST_TIMEOUT, MAX_REQUEST_TIMEOUT, initial_timeout);
+		return std::chrono::duration_cast<Timer::duration>(rto + Timer::duration(1) - std::chrono::microseconds(1));
+	}
+
+	Timer::duration hedge_delay(Poco::Net::SocketAddress const& e)
+		/// Returns how long to wait for a response from e before
+		/// hedging the request: the time most of its responses take,
+		/// INITIAL_HEDGE_DELAY if none has been measured yet.
+	{
+		Poco::Mutex::ScopedLock l(_mutex);
+		auto const estimator = rtt_estimators_.find(packed_endpoint(e));
+		if (!estimator) return INITIAL_HEDGE_DELAY;
+
+		auto const delay = estimator->latency_bound(MIN_REQUEST_TIMEOUT, PEER_LOOKUP_TIMEOUT, INITIAL_HEDGE_DELAY);
+		return std::chrono::duration_cast<Timer::duration>(delay + Timer::duration(1) - std::chrono::microseconds(1));
+	}
+
+	template< typename Callback >
+	Timer::handle expires_from_now(Timer::duration const& timeout, Callback const& on_timer_expired)
+	{
+		return timer_.expires_from_now(timeout, on_timer_expired);
+	}
+
+	bool cancel_timer(Timer::handle const& h)
+	{
+		return timer_.cancel(h);
+	}
+
+private:
+	struct pending_request
+		/// Kept until the response or the last timeout,
+		/// for retransmissions.
+	{
+		id response_id_;
+		id transfer_id_;
+			/// Of the last transmission if fragmented, id{} otherwise.
+		buffer message_;
+		Poco::Net::SocketAddress endpoint_;
+		Timer::duration timeout_;
+		std::size_t retransmissions_count_;
+		std::size_t max_retransmissions_count_;
+		Timer::clock::time_point sent_;
+	};
+
+	template< typename OnError >
+	void transmit(std::shared_ptr<pending_request> const& r, OnError const& on_error)
+	{
+		// The original message is kept for retransmissions.
+		auto message = r->message_;
+
+		auto on_request_sent = [this, r, on_error](std::error_code const& failure)
+		{
+			if (failure && response_router_.cancel(r->response_id_))
+				on_error(failure);
+		};
+
+		LOG_DEBUG(Tracker, this) << "sending message ..." << std::endl;
+		r->sent_ = Timer::clock::now();
+		r->transfer_id_ = send_message(std::move(message), r->endpoint_, std::move(on_request_sent));
+		LOG_DEBUG(Tracker, this) << "message sent." << std::endl;
+	}
+
+	struct outgoing_transfer
+	{
+		outgoing_transfer(buffer&& message, Poco::Net::SocketAddress const& e, message_sent_handler_type&& on_message_sent):
+			sender_(std::move(message), MAX_FRAGMENT_SIZE, FRAGMENT_WINDOW_SIZE),
+			endpoint_(e),
+			on_message_sent_(std::move(on_message_sent)),
+			id_(),
+			timeout_(),
+			timeouts_count_(0)
+		{
+		}
+
+		fragment_sender sender_;
+		Poco::Net::SocketAddress endpoint_;
+		message_sent_handler_type on_message_sent_;
+		id id_;
+		Timer::handle timeout_;
+		std::size_t timeouts_count_;
+	};
+
+	struct incoming_transfer
+	{
+		Poco::Net::SocketAddress endpoint_;
+		fragment_reassembler reassembler_;
+		Timer::clock::time_point last_received_;
+		id response_id_;
+			/// The token of the message, once its first fragment is received.
+	};
+
+	using incoming_transfers_type = std::map<id, incoming_transfer>;
+
+	template< typename OnMessageSent >
+	id send_message(buffer&& message, Poco::Net::SocketAddress const& e, OnMessageSent const& on_message_sent)
+		/// Sends message in a datagram if small enough, in fragments
+		/// otherwise. Returns the id of the fragmented transfer, id{}
+		/// if none. on_message_sent is told the transfer completed.
+	{
+		if (message.size() <= max_datagram_message_size())
+		{
+			network_.send(std::move(message), e, on_message_sent);
+			return id{};
+		}
+
+		auto t = std::make_shared<outgoing_transfer>(std::move(message), e, message_sent_handler_type(on_message_sent));
+		t->id_ = id(random_engine_);
+		LOG_DEBUG(Tracker, this) << "sending " << t->sender_.message_size() << " bytes in "
+			<< t->sender_.count() << " fragments to " << e.toString() << "." << std::endl;
+		{
+			Poco::Mutex::ScopedLock l(_mutex);
+			outgoing_transfers_.emplace(t->id_, t);
+		}
+		send_fragments(t);
+		schedule_transfer_timeout(t);
+		return t->id_;
+	}
+
+	void send_fragments(std::shared_ptr<outgoing_transfer> const& t)
+	{
+		std::vector<buffer> messages;
+		{
+			Poco::Mutex::ScopedLock l(_mutex);
+			auto const indexes = t->sender_.select_fragments_to_send();
+			for (std::size_t n = 0; n != indexes.size(); ++n)
+			{
+				FragmentBody fragment;
+				fragment.message_size_ = t->sender_.message_size();
+				fragment.index_ = indexes[n];
+				fragment.count_ = t->sender_.count();
+				// The last fragment of a burst is acknowledged at once.
+				if (n + 1 == indexes.size()) fragment.flags_ = FragmentBody::ACK_REQUESTED;
+				auto const data = t->sender_.fragment(indexes[n]);
+				fragment.data_.assign(data.first, data.second);
+				messages.push_back(message_serializer_.serialize(fragment, t->id_));
+			}
+		}
+
+		// Lost fragments are sent again on timeout.
+		auto on_fragment_sent = [] (std::error_code const& /* failure */)
+		{ };
+
+		for (auto& m : messages)
+			network_.send(std::move(m), t->endpoint_, on_fragment_sent);
+	}
+
+	void schedule_transfer_timeout(std::shared_ptr<outgoing_transfer> const& t)
+		/// Waits twice as long for each consecutive timeout.
+	{
+		auto timeout = request_timeout(t->endpoint_, PEER_LOOKUP_TIMEOUT);
+		Poco::Mutex::ScopedLock l(_mutex);
+		for (std::size_t n = 0; n != t->timeouts_count_; ++n)
+			timeout = std::min(timeout * 2, std::max(timeout, MAX_REQUEST_TIMEOUT));
+
+		// The timer doesn't keep the transfer alive.
+		std::weak_ptr<outgoing_transfer> const weak_transfer = t;
+		timer_.cancel(t->timeout_);
+		t->timeout_ = timer_.expires_from_now(timeout, [this, weak_transfer]
+		{
+			if (auto const t = weak_transfer.lock())
+				handle_transfer_timeout(t);
+		});
+	}
+
+	void handle_transfer_timeout(std::shared_ptr<outgoing_transfer> const& t)
+	{
+		{
+			Poco::Mutex::ScopedLock l(_mutex);
+			auto const found = outgoing_transfers_.find(t->id_);
+			if (found == outgoing_transfers_.end()) return;
+
+			if (++t->timeouts_count_ <= MAX_FRAGMENT_TIMEOUT_COUNT)
+				t->sender_.on_timeout();
+			else
+				outgoing_transfers_.erase(found);
+		}
+
+		if (t->timeouts_count_ > MAX_FRAGMENT_TIMEOUT_COUNT)
+		{
+			LOG_DEBUG(Tracker, this) << "fragmented transfer to " << t->endpoint_.toString()
+				<< " timed out." << std::endl;
+			t->on_message_sent_(make_error_code(std::errc::timed_out));
+			return;
+		}
+
+		send_fragments(t);
+		schedule_transfer_timeout(t);
+	}
+
+	typename incoming_transfers_type::iterator find_incoming_transfer(Poco::Net::SocketAddress const& s,
+		id const& transfer_id, FragmentBody const& fragment, Timer::clock::time_point now)
+		/// Returns the transfer the fragment belongs to. Only a well
+		/// formed fragment starts a transfer, provided there is room
+		/// for its reassembly buffer, both overall and for the sender.
+	{
+		auto t = incoming_transfers_.find(transfer_id);
+		if (t != incoming_transfers_.end())
+		{
+			if (t->second.endpoint_ != s || !t->second.reassembler_.matches(fragment.message_size_, fragment.count_))
+				return incoming_transfers_.end();
+			return t;
+		}
+
+		if (completed_transfers_.count(transfer_id)
+			|| !fragment_reassembler::is_valid(fragment.message_size_, fragment.count_,
+				MAX_REASSEMBLY_BUFFERS_SIZE_PER_PEER, MAX_FRAGMENT_SIZE))
+			return incoming_transfers_.end();
+
+		fragment_reassembler reassembler(fragment.message_size_, fragment.count_);
+		if (!reassembler.fits(fragment.index_, fragment.data_.size()))
+			return incoming_transfers_.end();
+
+		auto const size = reassembler.size();
+		if (reassembly_buffers_size_ + size > MAX_REASSEMBLY_BUFFERS_SIZE
+			|| reassembly_buffers_size(s) + size > MAX_REASSEMBLY_BUFFERS_SIZE_PER_PEER)
+		{
+			LOG_DEBUG(Tracker, this) << "no room to reassemble a message of " << size
+				<< " bytes from " << s.toString() << "." << std::endl;
+			return incoming_transfers_.end();
+		}
+
+		reassembly_buffers_size_ += size;
+		incoming_transfer i{ s, std::move(reassembler), now, id{} };
+		t = incoming_transfers_.emplace(transfer_id, std::move(i)).first;
+		schedule_transfers_expiry();
+		return t;
+	}
+
+	std::size_t reassembly_buffers_size(Poco::Net::SocketAddress const& s) const
+		/// Returns the size of the messages being received from s.
+	{
+		std::size_t size = 0;
+		for (auto const& t : incoming_transfers_)
+		{
+			if (t.second.endpoint_ == s)
+				size += t.second.reassembler_.size();
+		}
+		return size;
+	}
+
+	std::size_t max_datagram_message_size() const
+	{
+		Poco::Mutex::ScopedLock l(_mutex);
+		return max_datagram_message_size_;
+	}
+
+	std::size_t fragment_window() const
+		/// The window is shared by the incoming transfers.
+	{
+		return std::max<std::size_t>(FRAGMENT_WINDOW_SIZE / std::max<std::size_t>(incoming_transfers_.size(), 1), 1);
+	}
+
+	void schedule_transfers_expiry()
+	{
+		if (is_transfers_expiry_scheduled_) return;
+		is_transfers_expiry_scheduled_ = true;
+		timer_.expires_from_now(FRAGMENT_REASSEMBLY_TIMEOUT, [this] { expire_transfers(); });
+	}
+
+	void expire_transfers()
+		/// Drops the reassemblies which got no fragment for
+		/// FRAGMENT_REASSEMBLY_TIMEOUT, and forgets the transfers
+		/// completed as long ago.
+	{
+		Poco::Mutex::ScopedLock l(_mutex);
+		is_transfers_expiry_scheduled_ = false;
+		auto const expired = Timer::clock::now() - FRAGMENT_REASSEMBLY_TIMEOUT;
+
+		for (auto i = incoming_transfers_.begin(); i != incoming_transfers_.end(); )
+		{
+			if (i->second.last_received_ > expired) ++i;
+			else
+			{
+				LOG_DEBUG(Tracker, this) << "dropping the reassembly of a message from "
+					<< i->second.endpoint_.toString() << "." << std::endl;
+				reassembly_buffers_size_ -= i->second.reassembler_.size();
+				i = incoming_transfers_.erase(i);
+			}
+		}
+
+		for (auto i = completed_transfers_.begin(); i != completed_transfers_.end(); )
+		{
+			if (i->second > expired) ++i;
+			else i = completed_transfers_.erase(i);
+		}
+
+		if (!incoming_transfers_.empty() || !completed_transfers_.empty())
+			schedule_transfers_expiry();
+	}
+
+	bool is_transferring(id const& transfer_id, id const& response_id) const
+		/// Returns true while the request identified by response_id is
+		/// sent in fragments, or its response is received in fragments.
+	{
+		Poco::Mutex::ScopedLock l(_mutex);
+		if (transfer_id != id{} && outgoing_transfers_.count(transfer_id))
+			return true;
+		return std::any_of(incoming_transfers_.begin(), incoming_transfers_.end(),
+			[&response_id](typename incoming_transfers_type::value_type const& t)
+			{ return t.second.response_id_ == response_id; });
+	}
+
 private:
 	Poco::Net::SocketProactor& io_service_;
 	ResponseRouter response_router_;
+	Timer timer_;
 	MessageSerializer message_serializer_;
 	NetworkType & network_;
 	random_engine_type & random_engine_;
+	round_trip_handler_type on_round_trip_;
+	rtt_estimators rtt_estimators_;
+	std::size_t max_datagram_message_size_;
+	std::map<id, std::shared_ptr<outgoing_transfer>> outgoing_transfers_;
+	incoming_transfers_type incoming_transfers_;
+	std::map<id, Timer::clock::time_point> completed_transfers_;
+	std::size_t reassembly_buffers_size_;
+	bool is_transfers_expiry_scheduled_;
+	mutable Poco::Mutex _mutex;
 };
 
 } // namespace detail
@@ -0,0 +1,95 @@
+//
+// concurrency_controller.hpp
+//
+// Library: Kademlia
+// Package: DHT
+// Module:  concurrency_controller
+//
+// Definition of the concurrency_controller class.
+//
+// Copyright (c) 2021, Aleph ONE Software Engineering and Contributors.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+#ifndef KADEMLIA_CONCURRENCY_CONTROLLER_HPP
+#define KADEMLIA_CONCURRENCY_CONTROLLER_HPP
+
+#ifdef _MSC_VER
+#   pragma once
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+
+namespace kademlia {
+namespace detail {
+
+
+class concurrency_controller final
+	/// Adapts the number of concurrent requests of a lookup (alpha)
+	/// to the observed loss and latency, between min and max.
+	///
+	/// A timeout raises alpha at once, so that the lookup tries more
+	/// candidates instead of waiting on lost requests. alpha responses
+	/// in a row faster than fast_response lower it by one, the extra
+	/// requests mostly duplicating work then.
+{
+public:
+	using duration = std::chrono::microseconds;
+
+	concurrency_controller(std::size_t initial, std::size_t min, std::size_t max, duration fast_response):
+		min_(std::max<std::size_t>(min, 1)),
+		max_(std::max(max, min_)),
+		value_(std::min(std::max(initial, min_), max_)),
+		highest_(value_),
+		fast_response_(fast_response),
+		fast_responses_count_(0)
+	{
+	}
+
+	std::size_t value() const
+	{
+		return value_;
+	}
+
+	std::size_t highest() const
+		/// Returns the highest alpha reached.
+	{
+		return highest_;
+	}
+
+	void on_response(duration latency)
+	{
+		if (latency > fast_response_)
+		{
+			fast_responses_count_ = 0;
+			return;
+		}
+
+		if (++fast_responses_count_ < value_) return;
+		fast_responses_count_ = 0;
+		if (value_ > min_) --value_;
+	}
+
+	void on_timeout()
+	{
+		fast_responses_count_ = 0;
+		if (value_ < max_) highest_ = std::max(highest_, ++value_);
+	}
+
+private:
+	std::size_t min_;
+	std::size_t max_;
+	std::size_t value_;
+	std::size_t highest_;
+	duration fast_response_;
+	std::size_t fast_responses_count_;
+};
+
+
+} // namespace detail
+} // namespace kademlia
+
+#endif
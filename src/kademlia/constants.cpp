@@ -32,9 +32,43 @@ std::size_t const ROUTING_TABLE_BUCKET_SIZE{ 20 };
 std::size_t const CONCURRENT_FIND_PEER_REQUESTS_COUNT{ 3 };
 std::size_t const MAX_FIND_PEER_ATTEMPT_COUNT{ 3 };
 std::size_t const REDUNDANT_SAVE_COUNT{ 3 };
+std::size_t const MAX_PEER_FAILURE_COUNT{ 3 };
 
 std::chrono::milliseconds const INITIAL_CONTACT_RECEIVE_TIMEOUT{ 1000 };
 std::chrono::milliseconds const PEER_LOOKUP_TIMEOUT{ 200 };
+std::chrono::milliseconds const FAST_LOOKUP_RESPONSE_TIME{ 50 };
+std::chrono::milliseconds const INITIAL_HEDGE_DELAY{ 100 };
+std::size_t const MAX_HEDGED_REQUESTS_COUNT{ 2 };
+std::size_t const MAX_PROBE_INLINE_VALUE_SIZE{ 1024 };
+std::chrono::milliseconds const RECENT_PEER_REFRESH_PERIOD{ 1000 };
+std::chrono::milliseconds const MIN_REQUEST_TIMEOUT{ 20 };
+std::chrono::milliseconds const MAX_REQUEST_TIMEOUT{ 2000 };
+std::size_t const MAX_REQUEST_RETRANSMISSION_COUNT{ 2 };
+
+std::size_t const MEMBERSHIP_DIGEST_SIZE{ 32 };
+std::chrono::milliseconds const MEMBERSHIP_DIGEST_PERIOD{ 1000 };
+std::chrono::milliseconds const MEMBERSHIP_ENTRY_TTL{ 30000 };
+std::chrono::milliseconds const MEMBERSHIP_VIEW_TTL{ 5000 };
+
+std::chrono::milliseconds const ROUTING_TABLE_SNAPSHOT_PERIOD{ 60000 };
+std::chrono::milliseconds const ROUTING_TABLE_SNAPSHOT_MAX_AGE{ 3600000 };
+
+std::chrono::milliseconds const K_BUCKET_REFRESH_PERIOD{ 3600000 };
+std::chrono::milliseconds const K_BUCKET_REFRESH_CHECK_PERIOD{ 60000 };
+std::size_t const MAX_CONCURRENT_K_BUCKET_REFRESH_COUNT{ 2 };
+
+std::size_t const LOAD_CACHE_CAPACITY{ 1024 };
+
+std::size_t const MAX_DATAGRAM_MESSAGE_SIZE{ 65507 };
+std::size_t const MAX_UNFRAGMENTED_MESSAGE_SIZE{ 1200 };
+std::size_t const MAX_FRAGMENT_SIZE{ 1024 };
+std::size_t const FRAGMENT_WINDOW_SIZE{ 32 };
+std::size_t const MAX_FRAGMENT_TIMEOUT_COUNT{ 4 };
+std::chrono::milliseconds const FRAGMENT_REASSEMBLY_TIMEOUT{ 10000 };
+std::size_t const MAX_REASSEMBLY_BUFFERS_SIZE{ 64 * 1024 * 1024 };
+std::size_t const MAX_REASSEMBLY_BUFFERS_SIZE_PER_PEER{ 16 * 1024 * 1024 };
+
+std::size_t const SOCKET_BATCH_SIZE{ 16 };
 
 } // namespace detail
 } // namespace kademlia
@@ -40,9 +40,43 @@ extern std::size_t const ROUTING_TABLE_BUCKET_SIZE;
 extern std::size_t const CONCURRENT_FIND_PEER_REQUESTS_COUNT;
 extern std::size_t const MAX_FIND_PEER_ATTEMPT_COUNT;
 extern std::size_t const REDUNDANT_SAVE_COUNT;
+extern std::size_t const MAX_PEER_FAILURE_COUNT;
 
 extern std::chrono::milliseconds const INITIAL_CONTACT_RECEIVE_TIMEOUT;
 extern std::chrono::milliseconds const PEER_LOOKUP_TIMEOUT;
+extern std::chrono::milliseconds const FAST_LOOKUP_RESPONSE_TIME;
+extern std::chrono::milliseconds const INITIAL_HEDGE_DELAY;
+extern std::size_t const MAX_HEDGED_REQUESTS_COUNT;
+extern std::size_t const MAX_PROBE_INLINE_VALUE_SIZE;
+extern std::chrono::milliseconds const RECENT_PEER_REFRESH_PERIOD;
+extern std::chrono::milliseconds const MIN_REQUEST_TIMEOUT;
+extern std::chrono::milliseconds const MAX_REQUEST_TIMEOUT;
+extern std::size_t const MAX_REQUEST_RETRANSMISSION_COUNT;
+
+extern std::size_t const MEMBERSHIP_DIGEST_SIZE;
+extern std::chrono::milliseconds const MEMBERSHIP_DIGEST_PERIOD;
+extern std::chrono::milliseconds const MEMBERSHIP_ENTRY_TTL;
+extern std::chrono::milliseconds const MEMBERSHIP_VIEW_TTL;
+
+extern std::chrono::milliseconds const ROUTING_TABLE_SNAPSHOT_PERIOD;
+extern std::chrono::milliseconds const ROUTING_TABLE_SNAPSHOT_MAX_AGE;
+
+extern std::chrono::milliseconds const K_BUCKET_REFRESH_PERIOD;
+extern std::chrono::milliseconds const K_BUCKET_REFRESH_CHECK_PERIOD;
+extern std::size_t const MAX_CONCURRENT_K_BUCKET_REFRESH_COUNT;
+
+extern std::size_t const LOAD_CACHE_CAPACITY;
+
+extern std::size_t const MAX_DATAGRAM_MESSAGE_SIZE;
+extern std::size_t const MAX_UNFRAGMENTED_MESSAGE_SIZE;
+extern std::size_t const MAX_FRAGMENT_SIZE;
+extern std::size_t const FRAGMENT_WINDOW_SIZE;
+extern std::size_t const MAX_FRAGMENT_TIMEOUT_COUNT;
+extern std::chrono::milliseconds const FRAGMENT_REASSEMBLY_TIMEOUT;
+extern std::size_t const MAX_REASSEMBLY_BUFFERS_SIZE;
+extern std::size_t const MAX_REASSEMBLY_BUFFERS_SIZE_PER_PEER;
+
+extern std::size_t const SOCKET_BATCH_SIZE;
 
 } // namespace detail
 } // namespace kademlia
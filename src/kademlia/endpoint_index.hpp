@@ -0,0 +1,173 @@
+//
+// endpoint_index.hpp
+//
+// Library: Kademlia
+// Package: DHT
+// Module:  endpoint_index
+//
+// Definition of the endpoint_index class.
+//
+// Copyright (c) 2021, Aleph ONE Software Engineering and Contributors.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+#ifndef KADEMLIA_ENDPOINT_INDEX_HPP
+#define KADEMLIA_ENDPOINT_INDEX_HPP
+
+#ifdef _MSC_VER
+#   pragma once
+#endif
+
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+#include "kademlia/id.hpp"
+#include "kademlia/packed_endpoint.hpp"
+
+namespace kademlia {
+namespace detail {
+
+
+class endpoint_index final
+	/// Maps packed endpoints to peer ids.
+	///
+	/// Open addressing hash table with linear probing and backward
+	/// shift deletion (no tombstones), kept at most half full.
+	/// Empty slots are the ones holding a FAMILY_NONE endpoint.
+{
+public:
+	enum { INITIAL_CAPACITY = 64 };
+
+	endpoint_index(): slots_(INITIAL_CAPACITY), size_(0)
+	{
+	}
+
+	std::size_t size() const
+	{
+		return size_;
+	}
+
+	bool empty() const
+	{
+		return size_ == 0;
+	}
+
+	id const* find(packed_endpoint const& endpoint) const
+		/// Returns the id the endpoint is known under, or nullptr.
+	{
+		assert(endpoint.family() != packed_endpoint::FAMILY_NONE);
+
+		for (std::size_t i = home(endpoint); ; i = next(i))
+		{
+			auto const& s = slots_[i];
+			if (is_empty(s)) return nullptr;
+			if (s.endpoint_ == endpoint) return &s.id_;
+		}
+	}
+
+	void insert(packed_endpoint const& endpoint, id const& peer_id)
+		/// Associates the endpoint with the id, replacing
+		/// any previous association.
+	{
+		assert(endpoint.family() != packed_endpoint::FAMILY_NONE);
+
+		if ((size_ + 1) * 2 > slots_.size())
+			rehash(slots_.size() * 2);
+
+		for (std::size_t i = home(endpoint); ; i = next(i))
+		{
+			auto& s = slots_[i];
+			if (is_empty(s))
+			{
+				s.endpoint_ = endpoint;
+				s.id_ = peer_id;
+				++size_;
+				return;
+			}
+			if (s.endpoint_ == endpoint)
+			{
+				s.id_ = peer_id;
+				return;
+			}
+		}
+	}
+
+	bool erase(packed_endpoint const& endpoint)
+		/// Removes the endpoint. Returns false if it was unknown.
+	{
+		assert(endpoint.family() != packed_endpoint::FAMILY_NONE);
+
+		std::size_t hole = home(endpoint);
+		for (; ; hole = next(hole))
+		{
+			auto const& s = slots_[hole];
+			if (is_empty(s)) return false;
+			if (s.endpoint_ == endpoint) break;
+		}
+
+		// Shift back the following entries of the cluster
+		// which are allowed to move into the hole.
+		for (std::size_t i = next(hole); !is_empty(slots_[i]); i = next(i))
+		{
+			std::size_t const h = home(slots_[i].endpoint_);
+			bool const movable = (hole <= i) ? (h <= hole || h > i) : (h <= hole && h > i);
+			if (movable)
+			{
+				slots_[hole] = slots_[i];
+				hole = i;
+			}
+		}
+
+		slots_[hole] = slot{};
+		--size_;
+		return true;
+	}
+
+	void clear()
+	{
+		std::vector<slot>(INITIAL_CAPACITY).swap(slots_);
+		size_ = 0;
+	}
+
+private:
+	struct slot
+	{
+		packed_endpoint endpoint_;
+		id id_;
+	};
+
+	static bool is_empty(slot const& s)
+	{
+		return s.endpoint_.family() == packed_endpoint::FAMILY_NONE;
+	}
+
+	std::size_t home(packed_endpoint const& endpoint) const
+	{
+		return endpoint.hash() & (slots_.size() - 1);
+	}
+
+	std::size_t next(std::size_t i) const
+	{
+		return (i + 1) & (slots_.size() - 1);
+	}
+
+	void rehash(std::size_t capacity)
+	{
+		std::vector<slot> old(capacity);
+		old.swap(slots_);
+		size_ = 0;
+		for (auto const& s : old)
+			if (!is_empty(s)) insert(s.endpoint_, s.id_);
+	}
+
+	std::vector<slot> slots_;
+	std::size_t size_;
+};
+
+
+} // namespace detail
+} // namespace kademlia
+
+#endif
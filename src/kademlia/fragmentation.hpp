@@ -0,0 +1,336 @@
+//
+// fragmentation.hpp
+//
+// Library: Kademlia
+// Package: DHT
+// Module:  fragmentation
+//
+// Definition of the fragment_sender and fragment_reassembler classes.
+//
+// Copyright (c) 2021, Aleph ONE Software Engineering and Contributors.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+#ifndef KADEMLIA_FRAGMENTATION_HPP
+#define KADEMLIA_FRAGMENTATION_HPP
+
+#ifdef _MSC_VER
+#   pragma once
+#endif
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "kademlia/buffer.hpp"
+
+namespace kademlia {
+namespace detail {
+
+
+class fragment_sender final
+	/// Cuts a message into fragments of at most max_fragment_size
+	/// bytes, and keeps at most window() of them in flight.
+	///
+	/// Each transmission of a fragment gets a sequence number: an
+	/// in flight fragment sent REORDERING_THRESHOLD transmissions
+	/// before an acknowledged one is deemed lost and sent again, so
+	/// that only the missing fragments are retransmitted. Timeouts
+	/// halve the window, acknowledgements grow it back up to
+	/// max_window or the window advertised by the receiver.
+{
+public:
+	enum : std::uint64_t { REORDERING_THRESHOLD = 3 };
+
+	using range = std::pair<buffer::const_iterator, buffer::const_iterator>;
+
+	fragment_sender(buffer message, std::size_t max_fragment_size, std::size_t max_window):
+		message_(std::move(message)),
+		count_(std::uint32_t((message_.size() + max_fragment_size - 1) / max_fragment_size)),
+		fragment_size_(count_ ? (message_.size() + count_ - 1) / count_ : 0),
+		max_window_(std::max<std::size_t>(max_window, 1)),
+		window_(max_window_),
+		advertised_window_(max_window_),
+		fragments_(count_),
+		lost_(),
+		next_new_(0),
+		first_unacked_(0),
+		in_flight_count_(0),
+		acked_count_(0),
+		last_sequence_(0),
+		highest_acked_sequence_(0)
+	{
+	}
+
+	std::uint64_t message_size() const
+	{
+		return message_.size();
+	}
+
+	std::uint32_t count() const
+	{
+		return count_;
+	}
+
+	range fragment(std::uint32_t index) const
+	{
+		auto const offset = std::size_t(index) * fragment_size_;
+		auto const size = std::min(fragment_size_, message_.size() - offset);
+		return range(message_.begin() + offset, message_.begin() + offset + size);
+	}
+
+	std::size_t window() const
+	{
+		return std::min(window_, advertised_window_);
+	}
+
+	std::size_t in_flight_count() const
+	{
+		return in_flight_count_;
+	}
+
+	bool complete() const
+	{
+		return acked_count_ == count_;
+	}
+
+	std::vector<std::uint32_t> select_fragments_to_send()
+		/// Returns the fragments to send now, lost ones first,
+		/// and flags them in flight.
+	{
+		std::vector<std::uint32_t> indexes;
+		while (in_flight_count_ < window())
+		{
+			std::uint32_t index;
+			if (!lost_.empty())
+			{
+				index = lost_.front();
+				lost_.pop_front();
+				if (fragments_[index].acked_) continue;
+			}
+			else if (next_new_ < count_)
+				index = next_new_++;
+			else
+				break;
+
+			fragments_[index].sequence_ = ++last_sequence_;
+			++in_flight_count_;
+			indexes.push_back(index);
+		}
+		return indexes;
+	}
+
+	bool on_ack(std::uint32_t next, std::uint64_t received_mask, std::uint32_t window)
+		/// Records the fragments the receiver got (see FragmentAckBody),
+		/// returns true if some were not acknowledged yet.
+	{
+		advertised_window_ = std::max<std::size_t>(window, 1);
+
+		bool progress = false;
+		for (auto i = first_unacked_; i < std::min(next, count_); ++i)
+			progress |= acknowledge(i);
+		for (std::uint64_t bit = 0; bit != 64; ++bit)
+		{
+			auto const index = std::uint64_t(next) + 1 + bit;
+			if (index < count_ && (received_mask >> bit & 1))
+				progress |= acknowledge(std::uint32_t(index));
+		}
+		while (first_unacked_ < count_ && fragments_[first_unacked_].acked_)
+			++first_unacked_;
+
+		for (auto i = first_unacked_; i < next_new_; ++i)
+		{
+			auto& f = fragments_[i];
+			if (f.sequence_ != 0 && f.sequence_ + REORDERING_THRESHOLD <= highest_acked_sequence_)
+				flag_as_lost(i);
+		}
+
+		if (progress && window_ < max_window_)
+			++window_;
+		return progress;
+	}
+
+	void on_timeout()
+		/// Deems all in flight fragments lost.
+	{
+		for (auto i = first_unacked_; i < next_new_; ++i)
+		{
+			if (fragments_[i].sequence_ != 0)
+				flag_as_lost(i);
+		}
+		window_ = std::max<std::size_t>(window_ / 2, 1);
+	}
+
+private:
+	struct fragment_state
+	{
+		std::uint64_t sequence_ = 0;
+			/// Of the transmission in flight, 0 if none.
+		bool acked_ = false;
+	};
+
+	bool acknowledge(std::uint32_t index)
+	{
+		auto& f = fragments_[index];
+		if (f.acked_) return false;
+
+		f.acked_ = true;
+		++acked_count_;
+		if (f.sequence_ != 0)
+		{
+			highest_acked_sequence_ = std::max(highest_acked_sequence_, f.sequence_);
+			f.sequence_ = 0;
+			--in_flight_count_;
+		}
+		return true;
+	}
+
+	void flag_as_lost(std::uint32_t index)
+	{
+		fragments_[index].sequence_ = 0;
+		--in_flight_count_;
+		lost_.push_back(index);
+	}
+
+	buffer const message_;
+	std::uint32_t const count_;
+	std::size_t const fragment_size_;
+	std::size_t const max_window_;
+	std::size_t window_;
+	std::size_t advertised_window_;
+	std::vector<fragment_state> fragments_;
+	std::deque<std::uint32_t> lost_;
+	std::uint32_t next_new_;
+	std::uint32_t first_unacked_;
+	std::size_t in_flight_count_;
+	std::uint32_t acked_count_;
+	std::uint64_t last_sequence_;
+	std::uint64_t highest_acked_sequence_;
+};
+
+
+class fragment_reassembler final
+	/// Gathers the count fragments of a message of message_size
+	/// bytes, received in any order. The fragments have the same
+	/// size, but the last one which may be shorter.
+	///
+	/// The message buffer is only allocated by the first fragment
+	/// add() accepts.
+{
+public:
+	static bool is_valid(std::uint64_t message_size, std::uint32_t count,
+		std::uint64_t max_message_size, std::uint64_t max_fragment_size)
+		/// Returns false if no fragment_sender cutting fragments of at
+		/// most max_fragment_size bytes would cut such a message.
+	{
+		if (count == 0 || message_size > max_message_size || count > message_size)
+			return false;
+		auto const fragment_size = (message_size + count - 1) / count;
+		return fragment_size <= max_fragment_size && (count - 1) * fragment_size < message_size;
+	}
+
+	fragment_reassembler(std::uint64_t message_size, std::uint32_t count):
+		message_(),
+		size_(std::size_t(message_size)),
+		count_(count),
+		fragment_size_(std::size_t((message_size + count - 1) / count)),
+		received_(),
+		received_count_(0),
+		next_(0)
+	{
+	}
+
+	bool matches(std::uint64_t message_size, std::uint32_t count) const
+	{
+		return size_ == message_size && count_ == count;
+	}
+
+	bool fits(std::uint32_t index, std::size_t size) const
+		/// Returns true if a fragment of size bytes can be the
+		/// index-th fragment of the message.
+	{
+		if (index >= count_) return false;
+		auto const offset = std::size_t(index) * fragment_size_;
+		return size == std::min(fragment_size_, size_ - offset);
+	}
+
+	template<typename Iterator>
+	bool add(std::uint32_t index, Iterator i, Iterator e)
+		/// Returns false if the fragment has already been
+		/// received or doesn't belong to the message.
+	{
+		if (!fits(index, std::size_t(std::distance(i, e)))) return false;
+		if (message_.empty())
+		{
+			message_.resize(size_);
+			received_.resize(count_);
+		}
+		if (received_[index]) return false;
+
+		std::copy(i, e, message_.begin() + std::size_t(index) * fragment_size_);
+		received_[index] = true;
+		++received_count_;
+		while (next_ < count_ && received_[next_])
+			++next_;
+		return true;
+	}
+
+	bool complete() const
+	{
+		return received_count_ == count_;
+	}
+
+	std::uint32_t next() const
+		/// Returns the first missing fragment, count() if none.
+	{
+		return next_;
+	}
+
+	std::uint64_t received_mask() const
+		/// Returns the fragments received among the 64 following next().
+	{
+		std::uint64_t mask = 0;
+		for (std::uint64_t bit = 0; bit != 64 && next_ + 1 + bit < received_.size(); ++bit)
+		{
+			if (received_[std::size_t(next_ + 1 + bit)])
+				mask |= std::uint64_t(1) << bit;
+		}
+		return mask;
+	}
+
+	std::uint32_t count() const
+	{
+		return count_;
+	}
+
+	std::size_t size() const
+	{
+		return size_;
+	}
+
+	buffer& message()
+		/// Empty until a fragment has been accepted.
+	{
+		return message_;
+	}
+
+private:
+	buffer message_;
+	std::size_t size_;
+	std::uint32_t count_;
+	std::size_t fragment_size_;
+	std::vector<bool> received_;
+	std::uint32_t received_count_;
+	std::uint32_t next_;
+};
+
+
+} // namespace detail
+} // namespace kademlia
+
+#endif
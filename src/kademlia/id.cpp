@@ -69,19 +69,18 @@ to_block
 id::id
     ( std::default_random_engine & random_engine )
 {
-    // The output of the generator is treated as boolean value.
-    std::uniform_int_distribution<> distribution
-            ( std::numeric_limits< block_type >::min()
-            , std::numeric_limits< block_type >::max() );
+    std::uniform_int_distribution< word_type > distribution;
 
-    std::generate( blocks_.begin(), blocks_.end()
+    std::generate( words_.begin(), words_.end()
                  , std::bind( distribution, std::ref( random_engine ) ) );
-	// an additional effort to prevent duplicates
-	std::shuffle(blocks_.begin(), blocks_.end(), random_engine);
+
+    // Clear the padding blocks.
+    std::fill( end(), reinterpret_cast< block_type * >( words_.data() + WORDS_COUNT ), 0 );
 }
 
 id::id
     ( std::string s )
+        : words_{ }
 {
     auto CXX11_CONSTEXPR STRING_MAX_SIZE = BLOCKS_COUNT * HEX_CHAR_PER_BLOCK;
 
@@ -93,15 +92,16 @@ id::id
 
     assert( s.size() == STRING_MAX_SIZE && "string padding failed" );
     for ( std::size_t i = 0; i != BLOCKS_COUNT; ++ i )
-        blocks_[ i ] = to_block( s.substr( i * HEX_CHAR_PER_BLOCK
+        begin()[ i ] = to_block( s.substr( i * HEX_CHAR_PER_BLOCK
                                          , HEX_CHAR_PER_BLOCK ) );
 }
 
 id::id
     ( value_to_hash_type const& value )
+        : words_{ }
 {
     // Use OpenSSL crypto hash.
-    SHA1( value.data(), value.size(), blocks_.data() );
+    SHA1( value.data(), value.size(), begin() );
 }
 
 std::ostream &
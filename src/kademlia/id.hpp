@@ -41,6 +41,10 @@
 
 #include <kademlia/detail/cxx11_macros.hpp>
 
+#ifdef _MSC_VER
+#   include <intrin.h>
+#endif
+
 namespace kademlia {
 namespace detail {
 
@@ -64,7 +68,25 @@ public:
     static CXX11_CONSTEXPR std::size_t BLOCKS_COUNT = BIT_SIZE / BIT_PER_BLOCK;
 
     ///
-    using blocks_type = std::array< block_type, BLOCKS_COUNT >;
+    using iterator = block_type *;
+
+    ///
+    using const_iterator = block_type const*;
+
+    /// Blocks are stored in machine words, so that comparison
+    /// and distance evaluation work on a few words at once.
+    using word_type = std::uint64_t;
+
+    ///
+    static CXX11_CONSTEXPR std::size_t BIT_PER_WORD = sizeof( word_type ) * 8;
+
+    ///
+    static CXX11_CONSTEXPR std::size_t WORDS_COUNT
+            = ( BIT_SIZE + BIT_PER_WORD - 1 ) / BIT_PER_WORD;
+
+    /// Blocks are laid out in the words memory from msb to lsb,
+    /// the trailing padding blocks are always 0.
+    using words_type = std::array< word_type, WORDS_COUNT >;
 
     ///
     using value_to_hash_type = std::vector< std::uint8_t >;
@@ -125,7 +147,7 @@ public:
      */
     id
         ( void )
-            : blocks_{ }
+            : words_{ }
     { }
 
     /**
@@ -152,36 +174,74 @@ public:
     /**
      *  @note From msb to lsb.
      */
-    blocks_type::iterator
+    iterator
     begin
         ( void )
-    { return blocks_.begin(); }
+    { return reinterpret_cast< block_type * >( words_.data() ); }
 
     /**
      *  @note From msb to lsb.
      */
-    blocks_type::iterator
+    iterator
     end
         ( void )
-    { return blocks_.end(); }
+    { return begin() + BLOCKS_COUNT; }
 
     /**
      *  @note From msb to lsb.
      */
-    blocks_type::const_iterator
+    const_iterator
     begin
         ( void )
         const
-    { return blocks_.begin(); }
+    { return reinterpret_cast< block_type const* >( words_.data() ); }
 
     /**
      *  @note From msb to lsb.
      */
-    blocks_type::const_iterator
+    const_iterator
     end
         ( void )
         const
-    { return blocks_.end(); }
+    { return begin() + BLOCKS_COUNT; }
+
+    /**
+     *  @brief Return a word of the id as an integer value.
+     *  @param index The index of the word (from 0 to WORDS_COUNT - 1).
+     *  @note Index 0 holds the msb.
+     */
+    word_type
+    get_word
+        ( std::size_t index )
+        const
+    {
+        // Assembling bytes in order is recognized by compilers
+        // as a (byte swapping) load on any endianness.
+        auto const b = begin() + index * sizeof( word_type );
+        return word_type( b[ 0 ] ) << 56 | word_type( b[ 1 ] ) << 48
+             | word_type( b[ 2 ] ) << 40 | word_type( b[ 3 ] ) << 32
+             | word_type( b[ 4 ] ) << 24 | word_type( b[ 5 ] ) << 16
+             | word_type( b[ 6 ] ) << 8 | word_type( b[ 7 ] );
+    }
+
+    /**
+     *  @brief Count the leading 0 bits of the id.
+     *  @return BIT_SIZE for a null id.
+     */
+    std::size_t
+    count_leading_zeros
+        ( void )
+        const
+    {
+        for ( std::size_t i = 0; i != WORDS_COUNT; ++ i )
+        {
+            auto const w = get_word( i );
+            if ( w != 0 )
+                return i * BIT_PER_WORD + count_leading_zeros( w );
+        }
+
+        return BIT_SIZE;
+    }
 
     /**
      *
@@ -190,7 +250,7 @@ public:
     operator==
         ( id const& o )
         const
-    { return o.blocks_ == blocks_; }
+    { return o.words_ == words_; }
 
     /**
      *
@@ -229,7 +289,7 @@ private:
     block_type &
     get_block
         ( std::size_t index )
-    { return blocks_[ index / BIT_PER_BLOCK ]; }
+    { return begin()[ index / BIT_PER_BLOCK ]; }
 
     /**
      *
@@ -238,7 +298,7 @@ private:
     get_block
         ( std::size_t index )
         const
-    { return blocks_[ index / BIT_PER_BLOCK ]; }
+    { return begin()[ index / BIT_PER_BLOCK ]; }
 
     /**
      *
@@ -248,9 +308,37 @@ private:
         ( std::size_t index )
     { return 0x80 >> index % BIT_PER_BLOCK; }
 
+    /**
+     *  @note w must not be 0.
+     */
+    static std::size_t
+    count_leading_zeros
+        ( word_type w )
+    {
+#if defined( __GNUC__ ) || defined( __clang__ )
+        return __builtin_clzll( w );
+#elif defined( _MSC_VER ) && defined( _M_X64 )
+        unsigned long index;
+        _BitScanReverse64( &index, w );
+        return BIT_PER_WORD - 1 - index;
+#else
+        std::size_t count = 0;
+        for ( word_type mask = word_type( 1 ) << ( BIT_PER_WORD - 1 )
+            ; ( w & mask ) == 0
+            ; mask >>= 1 )
+            ++ count;
+        return count;
+#endif
+    }
+
+    friend id
+    distance
+        ( id const& a
+        , id const& b );
+
 private:
     ///
-    blocks_type blocks_;
+    words_type words_;
 };
 
 /**
@@ -261,8 +349,14 @@ operator<
     ( id const& a
     , id const& b )
 {
-    return std::lexicographical_compare( a.begin(), a.end()
-                                       , b.begin(), b.end() );
+    for ( std::size_t i = 0; i != id::WORDS_COUNT; ++ i )
+    {
+        auto const wa = a.get_word( i ), wb = b.get_word( i );
+        if ( wa != wb )
+            return wa < wb;
+    }
+
+    return false;
 }
 
 /**
@@ -283,9 +377,9 @@ distance
 {
     id result;
 
-    std::transform( a.begin(), a.end(), b.begin()
-                  , result.begin()
-                  , std::bit_xor< id::block_type >{} );
+    // Xor doesn't depend on the blocks order within a word.
+    for ( std::size_t i = 0; i != id::WORDS_COUNT; ++ i )
+        result.words_[ i ] = a.words_[ i ] ^ b.words_[ i ];
 
     return result;
 }
@@ -0,0 +1,319 @@
+//
+// k_bucket.hpp
+//
+// Library: Kademlia
+// Package: DHT
+// Module:  k_bucket
+//
+// Definition of the k_bucket and k_bucket_bitmap classes.
+//
+// Copyright (c) 2021, Aleph ONE Software Engineering and Contributors.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+#ifndef KADEMLIA_K_BUCKET_HPP
+#define KADEMLIA_K_BUCKET_HPP
+
+#ifdef _MSC_VER
+#   pragma once
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+
+#include "kademlia/id.hpp"
+#include "kademlia/packed_endpoint.hpp"
+
+namespace kademlia {
+namespace detail {
+
+
+class k_bucket final
+	/// Contains peers sharing a common id prefix with the routing table owner.
+	///
+	/// Peer ids, endpoints, failure counts, last seen times and round trip
+	/// times are kept in parallel, contiguous arrays
+	/// allocated once with the bucket capacity, so lookups scan ids only
+	/// and push/remove never allocate per peer. Entries keep their insertion
+	/// order (oldest first), which routing_table uses as the least
+	/// recently seen order.
+{
+public:
+	using time_point = std::chrono::steady_clock::time_point;
+
+	k_bucket(): size_(0), capacity_(0)
+	{
+	}
+
+	k_bucket(k_bucket&&) = default;
+	k_bucket& operator = (k_bucket&&) = default;
+
+	k_bucket(k_bucket const&) = delete;
+	k_bucket& operator = (k_bucket const&) = delete;
+
+	std::size_t size() const
+	{
+		return size_;
+	}
+
+	bool empty() const
+	{
+		return size_ == 0;
+	}
+
+	id const& peer_id(std::size_t index) const
+	{
+		assert(index < size_);
+		return ids_[index];
+	}
+
+	packed_endpoint const& endpoint(std::size_t index) const
+	{
+		assert(index < size_);
+		return endpoints_[index];
+	}
+
+	std::uint8_t failures(std::size_t index) const
+		/// Returns the count of consecutive requests the peer failed to answer.
+	{
+		assert(index < size_);
+		return failures_[index];
+	}
+
+	void set_failures(std::size_t index, std::uint8_t failures)
+	{
+		assert(index < size_);
+		failures_[index] = failures;
+	}
+
+	time_point last_seen(std::size_t index) const
+		/// Returns when the peer has last been heard of.
+	{
+		assert(index < size_);
+		return last_seen_[index];
+	}
+
+	void set_last_seen(std::size_t index, time_point last_seen)
+	{
+		assert(index < size_);
+		last_seen_[index] = last_seen;
+	}
+
+	std::uint32_t rtt(std::size_t index) const
+		/// Returns the smoothed round trip time of the peer
+		/// in microseconds, 0 if unknown.
+	{
+		assert(index < size_);
+		return rtts_[index];
+	}
+
+	void set_rtt(std::size_t index, std::uint32_t rtt)
+	{
+		assert(index < size_);
+		rtts_[index] = rtt;
+	}
+
+	std::size_t find(id const& peer_id) const
+		/// Returns the index of the peer, or size() if not found.
+	{
+		return std::find(ids_.get(), ids_.get() + size_, peer_id) - ids_.get();
+	}
+
+	std::size_t find(packed_endpoint const& endpoint) const
+		/// Returns the index of the endpoint, or size() if not found.
+	{
+		return std::find(endpoints_.get(), endpoints_.get() + size_, endpoint) - endpoints_.get();
+	}
+
+	void push_back(id const& peer_id, packed_endpoint const& endpoint, time_point last_seen, std::size_t capacity)
+		/// Appends a peer. Storage is allocated on first use with the
+		/// requested capacity and only grows if that capacity is exceeded.
+	{
+		if (size_ == capacity_)
+			reserve(std::max(capacity, capacity_ * 2));
+
+		ids_[size_] = peer_id;
+		endpoints_[size_] = endpoint;
+		failures_[size_] = 0;
+		last_seen_[size_] = last_seen;
+		rtts_[size_] = 0;
+		++size_;
+	}
+
+	void erase(std::size_t index)
+		/// Removes a peer, preserving the order of the remaining ones.
+	{
+		assert(index < size_);
+		std::move(ids_.get() + index + 1, ids_.get() + size_, ids_.get() + index);
+		std::move(endpoints_.get() + index + 1, endpoints_.get() + size_, endpoints_.get() + index);
+		std::move(failures_.get() + index + 1, failures_.get() + size_, failures_.get() + index);
+		std::move(last_seen_.get() + index + 1, last_seen_.get() + size_, last_seen_.get() + index);
+		std::move(rtts_.get() + index + 1, rtts_.get() + size_, rtts_.get() + index);
+		--size_;
+	}
+
+	void move_to_back(std::size_t index)
+		/// Moves a peer after all the others, preserving
+		/// the order of the remaining ones.
+	{
+		assert(index < size_);
+		std::rotate(ids_.get() + index, ids_.get() + index + 1, ids_.get() + size_);
+		std::rotate(endpoints_.get() + index, endpoints_.get() + index + 1, endpoints_.get() + size_);
+		std::rotate(failures_.get() + index, failures_.get() + index + 1, failures_.get() + size_);
+		std::rotate(last_seen_.get() + index, last_seen_.get() + index + 1, last_seen_.get() + size_);
+		std::rotate(rtts_.get() + index, rtts_.get() + index + 1, rtts_.get() + size_);
+	}
+
+	void move_to_front(std::size_t index)
+		/// Moves a peer before all the others, preserving
+		/// the order of the remaining ones.
+	{
+		assert(index < size_);
+		std::rotate(ids_.get(), ids_.get() + index, ids_.get() + index + 1);
+		std::rotate(endpoints_.get(), endpoints_.get() + index, endpoints_.get() + index + 1);
+		std::rotate(failures_.get(), failures_.get() + index, failures_.get() + index + 1);
+		std::rotate(last_seen_.get(), last_seen_.get() + index, last_seen_.get() + index + 1);
+		std::rotate(rtts_.get(), rtts_.get() + index, rtts_.get() + index + 1);
+	}
+
+private:
+	void reserve(std::size_t capacity)
+	{
+		assert(capacity > size_);
+		std::unique_ptr<id[]> ids(new id[capacity]);
+		std::unique_ptr<packed_endpoint[]> endpoints(new packed_endpoint[capacity]);
+		std::unique_ptr<std::uint8_t[]> failures(new std::uint8_t[capacity]);
+		std::unique_ptr<time_point[]> last_seen(new time_point[capacity]);
+		std::unique_ptr<std::uint32_t[]> rtts(new std::uint32_t[capacity]);
+		std::copy(ids_.get(), ids_.get() + size_, ids.get());
+		std::copy(endpoints_.get(), endpoints_.get() + size_, endpoints.get());
+		std::copy(failures_.get(), failures_.get() + size_, failures.get());
+		std::copy(last_seen_.get(), last_seen_.get() + size_, last_seen.get());
+		std::copy(rtts_.get(), rtts_.get() + size_, rtts.get());
+		ids_ = std::move(ids);
+		endpoints_ = std::move(endpoints);
+		failures_ = std::move(failures);
+		last_seen_ = std::move(last_seen);
+		rtts_ = std::move(rtts);
+		capacity_ = capacity;
+	}
+
+	std::unique_ptr<id[]> ids_;
+	std::unique_ptr<packed_endpoint[]> endpoints_;
+	std::unique_ptr<std::uint8_t[]> failures_;
+	std::unique_ptr<time_point[]> last_seen_;
+	std::unique_ptr<std::uint32_t[]> rtts_;
+	std::size_t size_;
+	std::size_t capacity_;
+};
+
+
+template<std::size_t BitSize>
+class k_bucket_bitmap final
+	/// Flags the non empty buckets of a routing table, one bit
+	/// per bucket, so empty ones can be skipped without being read.
+{
+public:
+	enum : std::size_t { NPOS = std::numeric_limits<std::size_t>::max() };
+
+	k_bucket_bitmap(): words_{}
+	{
+	}
+
+	void set(std::size_t index, bool non_empty)
+	{
+		assert(index < BitSize);
+		word_type const mask = word_type(1) << (index % BIT_PER_WORD);
+		if (non_empty)
+			words_[index / BIT_PER_WORD] |= mask;
+		else
+			words_[index / BIT_PER_WORD] &= ~mask;
+	}
+
+	std::size_t next(std::size_t index) const
+		/// Returns the first flagged index >= index, or NPOS.
+	{
+		for (std::size_t i = index / BIT_PER_WORD; i < WORDS_COUNT; ++i)
+		{
+			word_type w = words_[i];
+			if (i == index / BIT_PER_WORD)
+				w &= ~word_type(0) << (index % BIT_PER_WORD);
+			if (w != 0)
+				return i * BIT_PER_WORD + count_trailing_zeros(w);
+		}
+		return NPOS;
+	}
+
+	std::size_t previous(std::size_t index) const
+		/// Returns the last flagged index <= index, or NPOS.
+	{
+		if (index >= WORDS_COUNT * BIT_PER_WORD)
+			index = WORDS_COUNT * BIT_PER_WORD - 1;
+
+		for (std::size_t i = index / BIT_PER_WORD + 1; i-- > 0; )
+		{
+			word_type w = words_[i];
+			if (i == index / BIT_PER_WORD)
+				w &= ~word_type(0) >> (BIT_PER_WORD - 1 - index % BIT_PER_WORD);
+			if (w != 0)
+				return i * BIT_PER_WORD + BIT_PER_WORD - 1 - count_leading_zeros(w);
+		}
+		return NPOS;
+	}
+
+private:
+	using word_type = id::word_type;
+
+	enum : std::size_t
+	{
+		BIT_PER_WORD = id::BIT_PER_WORD,
+		WORDS_COUNT = (BitSize + BIT_PER_WORD - 1) / BIT_PER_WORD
+	};
+
+	static std::size_t count_leading_zeros(word_type w)
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		return __builtin_clzll(w);
+#elif defined(_MSC_VER) && defined(_M_X64)
+		unsigned long index;
+		_BitScanReverse64(&index, w);
+		return BIT_PER_WORD - 1 - index;
+#else
+		std::size_t count = 0;
+		for (word_type mask = word_type(1) << (BIT_PER_WORD - 1); (w & mask) == 0; mask >>= 1)
+			++count;
+		return count;
+#endif
+	}
+
+	static std::size_t count_trailing_zeros(word_type w)
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		return __builtin_ctzll(w);
+#elif defined(_MSC_VER) && defined(_M_X64)
+		unsigned long index;
+		_BitScanForward64(&index, w);
+		return index;
+#else
+		std::size_t count = 0;
+		for (; (w & 1) == 0; w >>= 1)
+			++count;
+		return count;
+#endif
+	}
+
+	std::array<word_type, WORDS_COUNT> words_;
+};
+
+
+} // namespace detail
+} // namespace kademlia
+
+#endif
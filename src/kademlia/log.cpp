@@ -117,7 +117,6 @@ struct LogInitializer
 		//enableLogFor("MessageSocket");
 		//enableLogFor("Network");
 		//enableLogFor("NotifyPeerTask");
-		//enableLogFor("ResponseCallbacks");
 		//enableLogFor("ResponseRouter");
 		//enableLogFor("routing_table");
 		//enableLogFor("Session");
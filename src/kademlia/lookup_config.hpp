@@ -0,0 +1,117 @@
+//
+// lookup_config.hpp
+//
+// Library: Kademlia
+// Package: DHT
+// Module:  lookup_config
+//
+// Definition of the lookup_config struct.
+//
+// Copyright (c) 2021, Aleph ONE Software Engineering and Contributors.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+#ifndef KADEMLIA_LOOKUP_CONFIG_HPP
+#define KADEMLIA_LOOKUP_CONFIG_HPP
+
+#ifdef _MSC_VER
+#   pragma once
+#endif
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "kademlia/constants.hpp"
+#include "Poco/Mutex.h"
+
+namespace kademlia {
+namespace detail {
+
+
+struct lookup_stats
+{
+	std::uint64_t lookups_count_ = 0;
+	std::uint64_t requests_count_ = 0;
+	std::uint64_t timeouts_count_ = 0;
+	std::uint64_t hedged_requests_count_ = 0;
+		/// Requests sent because another one was slow, part of requests_count_.
+	std::vector<std::uint64_t> lookups_per_alpha_;
+		/// Count of the lookups by the highest alpha they used.
+};
+
+
+class lookup_stats_recorder final
+	/// Accumulates the lookup_stats of the lookups of an engine,
+	/// each lookup records itself once done.
+{
+public:
+	void record(std::size_t alpha, std::size_t requests_count, std::size_t timeouts_count,
+		std::size_t hedged_requests_count)
+	{
+		Poco::FastMutex::ScopedLock l(mutex_);
+		++stats_.lookups_count_;
+		stats_.requests_count_ += requests_count;
+		stats_.timeouts_count_ += timeouts_count;
+		stats_.hedged_requests_count_ += hedged_requests_count;
+		if (stats_.lookups_per_alpha_.size() <= alpha)
+			stats_.lookups_per_alpha_.resize(alpha + 1);
+		++stats_.lookups_per_alpha_[alpha];
+	}
+
+	lookup_stats stats() const
+	{
+		Poco::FastMutex::ScopedLock l(mutex_);
+		return stats_;
+	}
+
+private:
+	lookup_stats stats_;
+	mutable Poco::FastMutex mutex_;
+};
+
+
+struct lookup_config
+	/// Lookup and replication parameters of an engine.
+	///
+	/// Lookups start with concurrent_requests_count_ (alpha) requests
+	/// in flight, alpha then adapts between the min and max counts to
+	/// the losses and latency observed (see concurrency_controller).
+	/// It is fixed by default.
+	///
+	/// Value lookups hedge the requests slower than usual for their
+	/// peer with a request to the next candidate, up to
+	/// max_hedged_requests_count_ times (0 disables hedging).
+	///
+	/// With probe_values_, value lookups ask for the metadata of large
+	/// values and fetch them from a single holder. Every peer must
+	/// understand value probes before it is enabled.
+	///
+	/// Messages too large for a datagram are always sent in
+	/// fragments. With fragment_large_messages_, so are those larger
+	/// than MAX_UNFRAGMENTED_MESSAGE_SIZE, not to rely on IP
+	/// fragmentation. Every peer must understand fragments before
+	/// it is enabled.
+{
+	std::size_t concurrent_requests_count_ = CONCURRENT_FIND_PEER_REQUESTS_COUNT;
+	std::size_t min_concurrent_requests_count_ = CONCURRENT_FIND_PEER_REQUESTS_COUNT;
+	std::size_t max_concurrent_requests_count_ = CONCURRENT_FIND_PEER_REQUESTS_COUNT;
+	std::chrono::milliseconds fast_response_time_ = FAST_LOOKUP_RESPONSE_TIME;
+	std::size_t max_hedged_requests_count_ = MAX_HEDGED_REQUESTS_COUNT;
+	bool probe_values_ = false;
+	bool fragment_large_messages_ = false;
+	std::size_t redundant_save_count_ = REDUNDANT_SAVE_COUNT;
+	std::size_t bucket_size_ = ROUTING_TABLE_BUCKET_SIZE;
+		/// The routing table k-buckets size, also the lookups shortlist size.
+	std::shared_ptr<lookup_stats_recorder> stats_recorder_;
+		/// If set, the lookups record their statistics into it.
+};
+
+
+} // namespace detail
+} // namespace kademlia
+
+#endif
@@ -0,0 +1,294 @@
+//
+// membership_table.hpp
+//
+// Library: Kademlia
+// Package: DHT
+// Module:  membership_table
+//
+// Definition of the membership_table class.
+//
+// Copyright (c) 2021, Aleph ONE Software Engineering and Contributors.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+#ifndef KADEMLIA_MEMBERSHIP_TABLE_HPP
+#define KADEMLIA_MEMBERSHIP_TABLE_HPP
+
+#ifdef _MSC_VER
+#   pragma once
+#endif
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "kademlia/constants.hpp"
+#include "kademlia/endpoint_index.hpp"
+#include "kademlia/id.hpp"
+#include "kademlia/packed_endpoint.hpp"
+#include "kademlia/rtt_estimator.hpp"
+
+namespace kademlia {
+namespace detail {
+
+
+template<typename PeerType>
+class membership_table final
+	/// Complete view of the network members, used by the one hop
+	/// routing mode: every key owner is then reached directly.
+	///
+	/// Members are learned from the messages they send (direct contact)
+	/// and from gossiped digests. Each member advertises a heartbeat it
+	/// increments periodically. Gossip refreshes a member only when its
+	/// heartbeat increased, so members which stopped beating expire
+	/// (see expire()) rather than being kept alive by gossip echoes.
+	///
+	/// Provides the closest(), flag_peer_as_unresponsive() and rtt()
+	/// routing table operations, so lookup tasks can be seeded from it.
+{
+public:
+	using clock = std::chrono::steady_clock;
+	using peer_type = PeerType;
+	using value_type = std::pair<id, peer_type>;
+
+	explicit membership_table(id const& my_id): my_id_(my_id)
+	{
+	}
+
+	membership_table(membership_table const&) = delete;
+	membership_table& operator = (membership_table const&) = delete;
+
+	std::size_t size() const
+	{
+		return members_.size();
+	}
+
+	bool empty() const
+	{
+		return members_.empty();
+	}
+
+	bool push(id const& peer_id, peer_type const& peer, clock::time_point now)
+		/// Records a direct contact with the peer.
+		/// Returns true if the peer was unknown.
+	{
+		auto const m = find_or_insert(peer_id, packed_endpoint(peer), now);
+		if (!m.first) return false;
+		m.first->last_seen_ = now;
+		m.first->failures_ = 0;
+		return m.second;
+	}
+
+	bool merge(id const& peer_id, peer_type const& peer, std::uint64_t heartbeat, clock::time_point now)
+		/// Records a gossiped member. Returns true if the member was unknown.
+	{
+		auto const m = find_or_insert(peer_id, packed_endpoint(peer), now);
+		if (!m.first) return false;
+		if (m.second || heartbeat > m.first->heartbeat_)
+		{
+			m.first->heartbeat_ = heartbeat;
+			m.first->last_seen_ = now;
+		}
+		return m.second;
+	}
+
+	bool remove(id const& peer_id)
+	{
+		auto const i = index_.find(peer_id);
+		if (i == index_.end()) return false;
+
+		auto const position = i->second;
+		endpoints_.erase(members_[position].endpoint_);
+		index_.erase(i);
+
+		// Keep the vector dense by moving the last member in the hole.
+		if (position != members_.size() - 1)
+		{
+			members_[position] = members_.back();
+			index_[members_[position].id_] = position;
+		}
+		members_.pop_back();
+		return true;
+	}
+
+	void flag_peer_as_unresponsive(id const& peer_id)
+		/// Report a request the member failed to answer.
+		/// It is removed after MAX_PEER_FAILURE_COUNT consecutive failures.
+	{
+		auto const i = index_.find(peer_id);
+		if (i == index_.end()) return;
+
+		auto& m = members_[i->second];
+		if (++m.failures_ >= MAX_PEER_FAILURE_COUNT)
+			remove(peer_id);
+	}
+
+	void record_rtt(id const& peer_id, std::chrono::microseconds sample)
+		/// Records the round trip time of a request to the member.
+	{
+		auto const i = index_.find(peer_id);
+		if (i != index_.end())
+			members_[i->second].rtt_ = smooth_rtt(members_[i->second].rtt_, sample);
+	}
+
+	std::chrono::microseconds rtt(id const& peer_id) const
+		/// Returns the smoothed round trip time of the member, zero if unknown.
+	{
+		auto const i = index_.find(peer_id);
+		return std::chrono::microseconds(i != index_.end() ? members_[i->second].rtt_ : 0);
+	}
+
+	std::size_t expire(clock::time_point now, clock::duration ttl)
+		/// Removes the members not refreshed since ttl.
+		/// Returns the count of removed members.
+	{
+		std::size_t removed = 0;
+		for (std::size_t i = 0; i < members_.size(); )
+		{
+			if (now - members_[i].last_seen_ > ttl)
+			{
+				remove(id(members_[i].id_));
+				++removed;
+			}
+			else
+				++i;
+		}
+		return removed;
+	}
+
+	template<typename OutputIterator>
+	std::size_t closest(id const& target, std::size_t count, OutputIterator out)
+		/// Writes up to count members, sorted by increasing XOR
+		/// distance to the target, stale ones (see
+		/// flag_peer_as_unresponsive()) last.
+		/// Returns the number of members written.
+	{
+		closest_candidates_.clear();
+		for (std::size_t i = 0; i != members_.size(); ++i)
+			closest_candidates_.push_back(closest_candidate{ distance(target, members_[i].id_)
+				, i, members_[i].failures_ != 0 });
+
+		auto const found = std::min(count, closest_candidates_.size());
+		auto const last = std::next(closest_candidates_.begin(), found);
+		std::partial_sort(closest_candidates_.begin(), last, closest_candidates_.end()
+			, [](closest_candidate const& a, closest_candidate const& b)
+			{ return a.stale_ != b.stale_ ? b.stale_ : a.distance_ < b.distance_; });
+
+		for (auto i = closest_candidates_.begin(); i != last; ++i, ++out)
+		{
+			auto const& m = members_[i->index_];
+			*out = value_type{ m.id_, peer_type(m.endpoint_.address()) };
+		}
+
+		return found;
+	}
+
+	template<typename RandomEngineType, typename Function>
+	void sample(std::size_t count, RandomEngineType& random_engine, Function f) const
+		/// Calls f(id, peer, heartbeat) with up to count distinct members
+		/// picked at random.
+	{
+		auto const n = members_.size();
+		count = std::min(count, n);
+
+		// Partial Fisher-Yates shuffle over the member indexes.
+		sample_indexes_.resize(n);
+		for (std::size_t i = 0; i != n; ++i)
+			sample_indexes_[i] = i;
+
+		for (std::size_t i = 0; i != count; ++i)
+		{
+			std::uniform_int_distribution<std::size_t> pick(i, n - 1);
+			std::swap(sample_indexes_[i], sample_indexes_[pick(random_engine)]);
+
+			auto const& m = members_[sample_indexes_[i]];
+			f(m.id_, peer_type(m.endpoint_.address()), m.heartbeat_);
+		}
+	}
+
+private:
+	struct member
+	{
+		id id_;
+		packed_endpoint endpoint_;
+		std::uint64_t heartbeat_;
+		clock::time_point last_seen_;
+		std::size_t failures_;
+		std::uint32_t rtt_;
+	};
+
+	struct closest_candidate
+	{
+		id distance_;
+		std::size_t index_;
+		bool stale_;
+	};
+
+	std::pair<member*, bool> find_or_insert(id const& peer_id, packed_endpoint const& endpoint, clock::time_point now)
+	{
+		if (peer_id == my_id_) return { nullptr, false };
+
+		auto i = index_.find(peer_id);
+		if (i != index_.end())
+		{
+			if (!(members_[i->second].endpoint_ == endpoint))
+			{
+				// The member moved. Purging may move it in members_.
+				endpoints_.erase(members_[i->second].endpoint_);
+				purge_endpoint(endpoint);
+				i = index_.find(peer_id);
+				members_[i->second].endpoint_ = endpoint;
+				endpoints_.insert(endpoint, peer_id);
+			}
+			return { &members_[i->second], false };
+		}
+
+		// A known endpoint showing under a new id
+		// belongs to a restarted member.
+		purge_endpoint(endpoint);
+
+		index_[peer_id] = members_.size();
+		members_.push_back(member{ peer_id, endpoint, 0, now, 0, 0 });
+		endpoints_.insert(endpoint, peer_id);
+		return { &members_.back(), true };
+	}
+
+	void purge_endpoint(packed_endpoint const& endpoint)
+	{
+		if (auto known_id = endpoints_.find(endpoint))
+			remove(id(*known_id));
+	}
+
+private:
+	id const my_id_;
+		/// Own id, never a member.
+
+	std::vector<member> members_;
+		/// Members, unordered.
+
+	std::map<id, std::size_t> index_;
+		/// Position of each member in members_.
+
+	endpoint_index endpoints_;
+		/// Id of each member endpoint.
+
+	std::vector<closest_candidate> closest_candidates_;
+		/// Scratch buffer of closest(), reused across calls.
+
+	mutable std::vector<std::size_t> sample_indexes_;
+		/// Scratch buffer of sample(), reused across calls.
+};
+
+
+} // namespace detail
+} // namespace kademlia
+
+#endif
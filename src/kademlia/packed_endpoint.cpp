@@ -0,0 +1,45 @@
+//
+// packed_endpoint.cpp
+//
+// Library: Kademlia
+// Package: DHT
+// Module:  packed_endpoint
+//
+// Implementation of the packed_endpoint class.
+//
+// Copyright (c) 2021, Aleph ONE Software Engineering and Contributors.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "kademlia/packed_endpoint.hpp"
+#include "Poco/Net/IPAddress.h"
+
+using Poco::Net::IPAddress;
+using Poco::Net::SocketAddress;
+
+namespace kademlia {
+namespace detail {
+
+
+packed_endpoint::packed_endpoint(SocketAddress const& endpoint): address_{},
+	port_(endpoint.port()),
+	family_(endpoint.host().isV4() ? FAMILY_IPV4 : FAMILY_IPV6)
+{
+	IPAddress const& host = endpoint.host();
+	std::memcpy(address_.data(), host.addr(), host.length());
+}
+
+
+SocketAddress packed_endpoint::address() const
+{
+	if (family_ == FAMILY_NONE) return SocketAddress();
+
+	auto const length = (family_ == FAMILY_IPV4) ? 4 : 16;
+	return SocketAddress(IPAddress(address_.data(), length), port_);
+}
+
+
+} // namespace detail
+} // namespace kademlia
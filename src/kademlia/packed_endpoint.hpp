@@ -0,0 +1,111 @@
+//
+// packed_endpoint.hpp
+//
+// Library: Kademlia
+// Package: DHT
+// Module:  packed_endpoint
+//
+// Definition of the packed_endpoint class.
+//
+// Copyright (c) 2021, Aleph ONE Software Engineering and Contributors.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+#ifndef KADEMLIA_PACKED_ENDPOINT_HPP
+#define KADEMLIA_PACKED_ENDPOINT_HPP
+
+#ifdef _MSC_VER
+#   pragma once
+#endif
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "Poco/Net/SocketAddress.h"
+
+namespace kademlia {
+namespace detail {
+
+
+class packed_endpoint final
+	/// Compact, trivially copyable form of an IP:PORT endpoint.
+	/// The address is kept as raw network order bytes (IPv4 uses
+	/// the first four), so that endpoints can be stored in flat
+	/// arrays and compared without going through SocketAddress.
+{
+public:
+	using address_type = std::array<std::uint8_t, 16>;
+
+	enum family_type : std::uint8_t
+	{
+		FAMILY_NONE = 0,
+		FAMILY_IPV4 = 4,
+		FAMILY_IPV6 = 6
+	};
+
+	packed_endpoint(): address_{}, port_{}, family_{FAMILY_NONE}
+	{
+	}
+
+	explicit packed_endpoint(Poco::Net::SocketAddress const& endpoint);
+
+	Poco::Net::SocketAddress address() const;
+		/// Unpacks the endpoint.
+
+	std::uint16_t port() const
+	{
+		return port_;
+	}
+
+	family_type family() const
+	{
+		return family_;
+	}
+
+	address_type const& bytes() const
+	{
+		return address_;
+	}
+
+	std::size_t hash() const
+		/// Mixes the address, port and family into a hash value
+		/// suitable for open addressing (all bits are significant).
+	{
+		std::uint64_t high, low;
+		std::memcpy(&high, address_.data(), sizeof(high));
+		std::memcpy(&low, address_.data() + sizeof(high), sizeof(low));
+
+		std::uint64_t h = high * 0x9e3779b97f4a7c15ULL;
+		h ^= low + 0x632be59bd9b4e019ULL + (h << 6) + (h >> 2);
+		h ^= (std::uint64_t(port_) << 8 | family_) * 0xff51afd7ed558ccdULL;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53ULL;
+		h ^= h >> 33;
+		return static_cast<std::size_t>(h);
+	}
+
+	bool operator == (packed_endpoint const& o) const
+	{
+		return port_ == o.port_ && family_ == o.family_
+			&& std::memcmp(address_.data(), o.address_.data(), address_.size()) == 0;
+	}
+
+	bool operator != (packed_endpoint const& o) const
+	{
+		return !(*this == o);
+	}
+
+private:
+	address_type address_;
+	std::uint16_t port_;
+	family_type family_;
+};
+
+
+} // namespace detail
+} // namespace kademlia
+
+#endif
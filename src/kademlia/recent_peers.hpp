@@ -0,0 +1,96 @@
+//
+// recent_peers.hpp
+//
+// Library: Kademlia
+// Package: DHT
+// Module:  recent_peers
+//
+// Definition of the recent_peers class.
+//
+// Copyright (c) 2021, Aleph ONE Software Engineering and Contributors.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+#ifndef KADEMLIA_RECENT_PEERS_HPP
+#define KADEMLIA_RECENT_PEERS_HPP
+
+#ifdef _MSC_VER
+#   pragma once
+#endif
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "kademlia/id.hpp"
+
+namespace kademlia {
+namespace detail {
+
+
+class recent_peers final
+	/// Remembers when the routing table last refreshed a peer.
+	///
+	/// Direct mapped cache of SIZE slots indexed by a hash of the
+	/// peer id: a colliding peer simply replaces the previous one,
+	/// so lookups and updates are O(1) and never allocate. A miss
+	/// only costs a regular routing table update.
+{
+public:
+	using clock = std::chrono::steady_clock;
+
+	enum : std::size_t { SIZE = 1024 };
+
+	recent_peers(): slots_()
+	{
+	}
+
+	bool contains(id const& peer_id, clock::time_point now, clock::duration period) const
+		/// Returns true if the peer has been refreshed less than period ago.
+	{
+		auto const& s = slots_[slot_index(peer_id)];
+		return s.used_ && s.id_ == peer_id && now - s.refreshed_ < period;
+	}
+
+	void insert(id const& peer_id, clock::time_point now)
+	{
+		auto& s = slots_[slot_index(peer_id)];
+		s.id_ = peer_id;
+		s.refreshed_ = now;
+		s.used_ = true;
+	}
+
+	void erase(id const& peer_id)
+	{
+		auto& s = slots_[slot_index(peer_id)];
+		if (s.id_ == peer_id) s.used_ = false;
+	}
+
+private:
+	struct slot
+	{
+		id id_;
+		clock::time_point refreshed_;
+		bool used_ = false;
+	};
+
+	static std::size_t slot_index(id const& peer_id)
+	{
+		// Ids are not necessarily random (e.g. in tests),
+		// hence all the words are mixed (Fibonacci hashing).
+		id::word_type h = 0;
+		for (std::size_t i = 0; i != id::WORDS_COUNT; ++i)
+			h = (h ^ peer_id.get_word(i)) * 0x9e3779b97f4a7c15ULL;
+		return std::size_t(h >> 54) % SIZE;
+	}
+
+	std::array<slot, SIZE> slots_;
+};
+
+
+} // namespace detail
+} // namespace kademlia
+
+#endif
@@ -32,16 +32,24 @@
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cstdint>
 #include <iostream>
-#include <list>
+#include <iterator>
+#include <limits>
+#include <random>
 #include <utility>
 #include <vector>
-#include <iterator>
 
 #include "kademlia/detail/cxx11_macros.hpp"
+#include "kademlia/constants.hpp"
+#include "kademlia/endpoint_index.hpp"
 #include "kademlia/id.hpp"
+#include "kademlia/k_bucket.hpp"
 #include "kademlia/log.hpp"
+#include "kademlia/packed_endpoint.hpp"
+#include "kademlia/recent_peers.hpp"
+#include "kademlia/rtt_estimator.hpp"
 
 #ifdef _MSC_VER
 #   ifdef max
@@ -55,18 +63,62 @@
 namespace kademlia {
 namespace detail {
 
+/**
+ *  routing_table layout allocating one k_bucket per id bit up front.
+ *  @note Buckets never split, find() scans them from the far end.
+ */
+struct static_k_buckets
+{
+	enum { SPLIT_ON_DEMAND = false };
+};
+
+/**
+ *  routing_table layout starting with a single k_bucket, splitting
+ *  the one covering our own id when it overflows (as described in
+ *  the Kademlia paper).
+ *  @note Only about log2(peer_count / k) + 1 buckets are allocated,
+ *	 which matters when many engines share a process.
+ */
+struct split_k_buckets
+{
+	enum { SPLIT_ON_DEMAND = true };
+};
+
 /**
  *  This class keeps track of peers and find the known peer closed to an id.
- *  @note Current implementation use a discret symbol approach.
+ *  @note Current implementation use a discret symbol approach: ids are
+ *	 read as SymbolBitSize bits digits and each level (digit index)
+ *	 has 2^SymbolBitSize - 1 buckets, one per digit value differing
+ *	 from ours (see the accelerated lookups section of the Kademlia
+ *	 paper). Lookups then need about log_{2^SymbolBitSize}(n) hops
+ *	 instead of log2(n), at the cost of a larger table.
+ *  @note Buckets are ordered from the far to the close ones, the last
+ *	 bucket containing all the peers sharing at least as many digits
+ *	 with our id.
  */
-template<typename PeerType>
+template<typename PeerType, typename KBucketsLayout = static_k_buckets
+		, std::size_t SymbolBitSize = 1>
 class routing_table final
 {
+	static_assert( SymbolBitSize > 0 && SymbolBitSize <= 8
+				 && id::BIT_SIZE % SymbolBitSize == 0
+				 , "SymbolBitSize must be in [1, 8] and divide the id bit size" );
+
 public:
 	enum { DEFAULT_K_BUCKET_SIZE = 20 };
+	enum { DEFAULT_REPLACEMENT_CACHE_SIZE = 10 };
+
+	enum : std::size_t
+	{
+		SYMBOL_BIT_SIZE = SymbolBitSize,
+		LEVELS_COUNT = id::BIT_SIZE / SymbolBitSize,
+		K_BUCKETS_PER_LEVEL = ( 1U << SymbolBitSize ) - 1,
+		MAX_K_BUCKET_COUNT = LEVELS_COUNT * K_BUCKETS_PER_LEVEL
+	};
 
 	using peer_type = PeerType;
 	using value_type = std::pair< id, peer_type >;
+	using clock = std::chrono::steady_clock;
 
 	class iterator;
 
@@ -74,10 +126,17 @@ public:
 	/**
 	 *  Construct the routing_table implementation.
 	 */
-	routing_table(const id& my_id, std::size_t k_bucket_size = DEFAULT_K_BUCKET_SIZE )
-			: k_buckets_( id::BIT_SIZE ), my_id_( my_id )
+	routing_table(const id& my_id, std::size_t k_bucket_size = DEFAULT_K_BUCKET_SIZE
+			, std::size_t replacement_cache_size = DEFAULT_REPLACEMENT_CACHE_SIZE )
+			: k_buckets_( INITIAL_K_BUCKET_COUNT ), my_id_( my_id )
 			, peer_count_( 0 ), k_bucket_size_( k_bucket_size )
-			, largest_k_bucket_index_( 0 )
+			, replacement_caches_( INITIAL_K_BUCKET_COUNT )
+			, replacement_cache_size_( replacement_cache_size )
+			, liveness_checks_( INITIAL_K_BUCKET_COUNT, LIVENESS_CHECK_NONE )
+			, evictions_count_( 0 ), replacements_count_( 0 )
+			, non_empty_k_buckets_()
+			, lowest_k_bucket_index_( INITIAL_K_BUCKET_COUNT - 1 )
+			, k_bucket_lookups_( INITIAL_K_BUCKET_COUNT, clock::now() )
 	{
 		assert( k_bucket_size_ > 0 && "k_bucket size must be > 0" );
 
@@ -102,27 +161,40 @@ public:
 	std::size_t peer_count() const
 	{ return peer_count_; }
 
+	/**
+	 *  Count the number of allocated k_buckets.
+	 *  @note Complexity: O(1).
+	 */
+	std::size_t k_bucket_count() const
+	{ return k_buckets_.size(); }
+
 	/**
 	 *  Register a peer into the routing table.
 	 *  @return true if the peer has been inserted.
 	 *  @note This method takes ownership of the peer.
-	 *  @note The peer may not be pushed if the target bucket is full.
-	 *  @note Complexity: O(log n)
+	 *  @note An already known peer is moved to the tail of its bucket
+	 *	 (i.e. becomes the most recently seen one).
+	 *  @note If the target bucket is full, the peer is kept in the
+	 *	 bucket replacement cache and the least recently seen peer of
+	 *	 the bucket should be checked (see begin_liveness_check()).
+	 *	 With split_k_buckets, a full last bucket is split instead.
+	 *  @note A peer already refreshed less than
+	 *	 RECENT_PEER_REFRESH_PERIOD ago is left as is, hence its
+	 *	 bucket order and last seen time lag by at most that period.
+	 *  @note Complexity: O(1) for recently refreshed peers, O(k) otherwise.
 	 */
 	bool push(const id& peer_id, const peer_type& new_peer )
-	{
-		auto k_bucket_index = find_k_bucket_index(peer_id);
-		auto& bucket = k_buckets_[ k_bucket_index ];
-
-		// If there is room in the bucket.
-		if ( bucket.size() == k_bucket_size_ )
-		{
-			update_largest_k_bucket_index( k_bucket_index );
-
-			if ( k_bucket_index != largest_k_bucket_index_ )
-				return false;
-		}
+	{ return push( peer_id, new_peer, clock::now() ); }
 
+	/**
+	 *  Register a peer last seen at a given time.
+	 *  @note Peers of a bucket are kept in the order they are pushed,
+	 *	 hence peers restored from a previous run (see
+	 *	 for_each_peer()) should be pushed from the least to the most
+	 *	 recently seen one.
+	 */
+	bool push(const id& peer_id, const peer_type& new_peer, clock::time_point last_seen)
+	{
 		// prevent entries in the routing table
 		// - no self ID
 		// - no duplicate IDs
@@ -131,33 +203,48 @@ public:
 		// don't add self
 		if (peer_id == my_id_) return false;
 
-		// If the peer ID is already known, do nothing.
-		auto isPeerKnown = [&peer_id] (value_type const& entry)
-		{ return entry.first == peer_id; };
-		auto const end = bucket.end();
-		if (std::find_if(bucket.begin(), end, isPeerKnown) != end)
+		// Peers sending bursts of messages are only
+		// refreshed once per period.
+		if (recent_peers_.contains(peer_id, last_seen, RECENT_PEER_REFRESH_PERIOD))
 			return false;
 
-		// If this is a known endpoint (IP:PORT), coming under a
-		// different ID, then the old entry needs to be removed.
-		auto ipIt = _knownPeers.find(new_peer);
-		if (ipIt != _knownPeers.end())
-		{
-			std::size_t bIdx = find_k_bucket_index(ipIt->second);
-			auto& b = k_buckets_[bIdx];
-			auto isIPKnown = [&new_peer](value_type const &entry)
-			{ return entry.second == new_peer; };
+		auto k_bucket_index = find_k_bucket_index(peer_id);
 
-			auto it = std::find_if(b.begin(), b.end(), isIPKnown);
-			while (b.end() != it)
+		// If the peer ID is already known, it has just been seen.
+		{
+			auto& bucket = k_buckets_[ k_bucket_index ];
+			auto const known = bucket.find(peer_id);
+			if (known != bucket.size())
 			{
-				remove(it->first);
-				it = std::find_if(b.begin(), b.end(), isIPKnown);
+				mark_as_seen(bucket, known, last_seen);
+				recent_peers_.insert(peer_id, last_seen);
+				return false;
 			}
 		}
-		bucket.insert(end, value_type{peer_id, new_peer});
-		++ peer_count_;
-		_knownPeers[new_peer] = peer_id;
+
+		packed_endpoint const endpoint(new_peer);
+
+		while ( KBucketsLayout::SPLIT_ON_DEMAND
+				&& k_buckets_[ k_bucket_index ].size() >= k_bucket_size_
+				&& k_bucket_index == k_buckets_.size() - 1
+				&& k_buckets_.size() < MAX_K_BUCKET_COUNT )
+		{
+			split_last_k_bucket();
+			k_bucket_index = find_k_bucket_index(peer_id);
+		}
+
+		auto& bucket = k_buckets_[ k_bucket_index ];
+
+		// If there is no room in the bucket, keep the
+		// peer aside until an entry gets evicted.
+		if ( bucket.size() >= k_bucket_size_ )
+		{
+			add_replacement( k_bucket_index, peer_id, endpoint, last_seen );
+			return false;
+		}
+
+		insert( k_bucket_index, peer_id, endpoint, last_seen );
+		recent_peers_.insert( peer_id, last_seen );
 		LOG_DEBUG( routing_table, this ) << "pushed peer '"
 				<< new_peer.toString() << "' as '"
 				<< peer_id << "'." << std::endl;
@@ -168,47 +255,338 @@ public:
 	/**
 	 *  Remove a peer from the routing table.
 	 *  @return true if the peer has been removed.
-	 *  @note Complexity: O(log n)
+	 *  @note Complexity: O(k)
 	 */
 	bool remove(const id& peer_id)
 	{
 		// Find the closest bucket.
-		auto & bucket = k_buckets_[find_k_bucket_index(peer_id)];
-
-		auto is_peer_known = [&peer_id] ( value_type const& entry )
-		{ return entry.first == peer_id; };
+		auto const index = find_k_bucket_index(peer_id);
+		auto & bucket = k_buckets_[index];
 
-		auto i = std::find_if( bucket.begin(), bucket.end(), is_peer_known );
-		if (i == bucket.end()) return false;
+		auto const i = bucket.find(peer_id);
+		if (i == bucket.size()) return false;
 
-		_knownPeers.erase(i->second);
+		_knownPeers.erase(bucket.endpoint(i));
+		recent_peers_.erase(peer_id);
 		bucket.erase(i);
 		--peer_count_;
+		k_bucket_resized(index);
 
 		LOG_DEBUG(routing_table, this) << "removed peer '"
 			<< peer_id << "' ..." << std::endl;
 		return true;
 	}
 
+	/**
+	 *  Start checking the liveness of a bucket least recently seen peer.
+	 *  @param peer_id An id belonging to the bucket to check.
+	 *  @param least_recently_seen Receives the peer to ping.
+	 *  @return true if a peer has been refused by this (full) bucket
+	 *	 since its last check and no check is in progress. The caller
+	 *	 must then ping the peer and report with end_liveness_check().
+	 */
+	bool begin_liveness_check(const id& peer_id, value_type& least_recently_seen)
+	{
+		auto const index = find_k_bucket_index(peer_id);
+		if (liveness_checks_[index] != LIVENESS_CHECK_WANTED)
+			return false;
+
+		auto const& bucket = k_buckets_[index];
+		if (bucket.empty())
+		{
+			liveness_checks_[index] = LIVENESS_CHECK_NONE;
+			return false;
+		}
+
+		liveness_checks_[index] = LIVENESS_CHECK_PENDING;
+		least_recently_seen.first = bucket.peer_id(0);
+		least_recently_seen.second = peer_type(bucket.endpoint(0).address());
+		return true;
+	}
+
+	/**
+	 *  Complete a liveness check started with begin_liveness_check().
+	 *  @param peer_id The pinged peer.
+	 *  @param alive Whether the peer answered.
+	 *  @note A dead peer is evicted and replaced by the most
+	 *	 recently seen peer of the bucket replacement cache.
+	 */
+	void end_liveness_check(const id& peer_id, bool alive)
+	{
+		auto const index = find_k_bucket_index(peer_id);
+		if (liveness_checks_[index] == LIVENESS_CHECK_PENDING)
+			liveness_checks_[index] = LIVENESS_CHECK_NONE;
+
+		if (alive)
+		{
+			// The answer may have been handled by push() already.
+			auto& bucket = k_buckets_[index];
+			auto const i = bucket.find(peer_id);
+			if (i != bucket.size()) mark_as_seen(bucket, i, clock::now());
+		}
+		else
+			evict(index, peer_id);
+	}
+
+	/**
+	 *  Report a request the peer failed to answer.
+	 *  @note The peer becomes stale and the least recently seen
+	 *	 of its bucket, until it is seen again. It is evicted after
+	 *	 MAX_PEER_FAILURE_COUNT consecutive failures.
+	 */
+	void flag_peer_as_unresponsive(const id& peer_id)
+	{
+		auto const index = find_k_bucket_index(peer_id);
+		auto& bucket = k_buckets_[index];
+		auto const i = bucket.find(peer_id);
+		if (i == bucket.size()) return;
+
+		std::size_t const failures = bucket.failures(i) + 1;
+		if (failures >= MAX_PEER_FAILURE_COUNT)
+		{
+			LOG_DEBUG(routing_table, this) << "evicting stale peer '"
+				<< peer_id << "'." << std::endl;
+			evict(index, peer_id);
+			return;
+		}
+
+		// The next message of the peer must reset its failures.
+		recent_peers_.erase(peer_id);
+		bucket.set_failures(i, std::uint8_t(failures));
+		bucket.move_to_front(i);
+	}
+
+	/**
+	 *  Record the round trip time of a request to a peer.
+	 *  @note Unknown peers are ignored.
+	 */
+	void record_rtt(const id& peer_id, std::chrono::microseconds sample)
+	{
+		auto& bucket = k_buckets_[ find_k_bucket_index( peer_id ) ];
+		auto const i = bucket.find( peer_id );
+		if ( i != bucket.size() )
+			bucket.set_rtt( i, smooth_rtt( bucket.rtt( i ), sample ) );
+	}
+
+	/**
+	 *  @return The smoothed round trip time of a peer, zero if unknown.
+	 */
+	std::chrono::microseconds rtt(const id& peer_id) const
+	{
+		auto const& bucket = k_buckets_[ find_k_bucket_index( peer_id ) ];
+		auto const i = bucket.find( peer_id );
+		return std::chrono::microseconds( i != bucket.size() ? bucket.rtt( i ) : 0 );
+	}
+
+	/**
+	 *  Call f(id, peer, last_seen) for each peer, from the far
+	 *  buckets to the close ones and from the least to the most
+	 *  recently seen peer of each bucket.
+	 */
+	template<typename Function>
+	void for_each_peer(Function f) const
+	{
+		for ( std::size_t i = non_empty_k_buckets_.next( 0 )
+			; i != k_bucket_bitmap_type::NPOS
+			; i = non_empty_k_buckets_.next( i + 1 ) )
+		{
+			auto const& bucket = k_buckets_[ i ];
+			for ( std::size_t j = 0; j != bucket.size(); ++ j )
+				f( bucket.peer_id( j ), peer_type( bucket.endpoint( j ).address() )
+				 , bucket.last_seen( j ) );
+		}
+	}
+
+	/**
+	 *  Record a lookup of an id, which refreshes the bucket covering it.
+	 */
+	void mark_as_looked_up(const id& target, clock::time_point now)
+	{ k_bucket_lookups_[ find_k_bucket_index( target ) ] = now; }
+
+	/**
+	 *  @return When the bucket covering an id was last looked up
+	 *	 (or when the routing table was created).
+	 */
+	clock::time_point last_lookup(const id& target) const
+	{ return k_bucket_lookups_[ find_k_bucket_index( target ) ]; }
+
+	/**
+	 *  Call f(target) with a random id of each bucket not looked up
+	 *  for idle_period, then record these buckets as looked up at now.
+	 *  @note The closest buckets, holding less than k peers
+	 *	 altogether, are reached by a single lookup of an id close
+	 *	 to ours, hence they are reported once, first.
+	 */
+	template<typename Function>
+	void take_idle_k_buckets(clock::time_point now, clock::duration idle_period
+			, std::default_random_engine& random_engine, Function f)
+	{
+		std::size_t const last_index = k_buckets_.size() - 1;
+		std::size_t closest_peer_count = 0;
+		bool closest_idle = false;
+
+		for ( std::size_t i = last_index + 1; i-- != 0; )
+		{
+			closest_peer_count += k_buckets_[ i ].size();
+			bool const closest = closest_peer_count < k_bucket_size_;
+			if ( ! closest && closest_idle )
+			{
+				f( random_id_in_k_bucket( last_index, random_engine ) );
+				closest_idle = false;
+			}
+
+			if ( now - k_bucket_lookups_[ i ] < idle_period )
+				continue;
+
+			k_bucket_lookups_[ i ] = now;
+			if ( closest )
+				closest_idle = true;
+			else
+				f( random_id_in_k_bucket( i, random_engine ) );
+		}
+
+		if ( closest_idle )
+			f( random_id_in_k_bucket( last_index, random_engine ) );
+	}
+
+	/**
+	 *  Draw an id covered by a bucket.
+	 *  @note Ids of the bucket of level l and digit d share their
+	 *	 first l digits with ours and their digit l is ours xor d.
+	 *	 The last bucket of a split table covers all the ids sharing
+	 *	 at least its level digits with ours.
+	 */
+	id random_id_in_k_bucket(std::size_t index, std::default_random_engine& random_engine) const
+	{
+		assert( index < k_buckets_.size() );
+
+		std::size_t const level = index / K_BUCKETS_PER_LEVEL;
+		std::size_t const prefix_bit_size = level * SymbolBitSize;
+		id result( random_engine );
+		for ( std::size_t bit = 0; bit != prefix_bit_size; ++ bit )
+			result[ bit ] = bool( my_id_[ bit ] );
+
+		bool const is_split_last_k_bucket = index == k_buckets_.size() - 1
+				&& k_buckets_.size() != MAX_K_BUCKET_COUNT;
+		if ( ! is_split_last_k_bucket )
+		{
+			auto const digit = get_digit( my_id_, level )
+					^ ( K_BUCKETS_PER_LEVEL - index % K_BUCKETS_PER_LEVEL );
+			for ( std::size_t bit = 0; bit != SymbolBitSize; ++ bit )
+				result[ prefix_bit_size + bit ] = ( digit >> ( SymbolBitSize - 1 - bit ) & 1 ) != 0;
+		}
+
+		return result;
+	}
+
+	/**
+	 *  Count the peers evicted because they didn't answer.
+	 */
+	std::size_t evictions_count() const
+	{ return evictions_count_; }
+
+	/**
+	 *  Count the peers moved from a replacement cache to a bucket.
+	 */
+	std::size_t replacements_count() const
+	{ return replacements_count_; }
+
 	/**
 	 *  Find closest peers to an id.
 	 *  @return An iterator to the closest peer from the id to the far.
-	 *  @note Complexity: O(log n)
+	 *  @note Complexity: O(1), empty buckets are skipped while iterating.
 	 */
 	iterator find(const id& id_to_find )
 	{
 		//LOG_DEBUG( routing_table, this ) << "finding peer near '" << id_to_find << "'." << std::endl;
 
-		auto index = std::max( get_lowest_k_bucket_index()
+		auto index = std::max( lowest_k_bucket_index_
 							 , find_k_bucket_index( id_to_find ) );
 
-		auto i = std::next( k_buckets_.begin(), index );
+		return iterator( &k_buckets_, &non_empty_k_buckets_, index, 0 );
+	}
+
+	/**
+	 *  Find the peers closest to an id.
+	 *  @param target The id to look around.
+	 *  @param count The maximum number of peers to return.
+	 *  @param out Receives up to count value_type, sorted by
+	 *	 increasing XOR distance to the target.
+	 *  @return The number of peers written to out.
+	 *  @note Stale peers (see flag_peer_as_unresponsive()) are
+	 *	 returned only when not enough responsive ones are known.
+	 *  @note Buckets are visited by increasing distance to the target
+	 *	 and visiting stops as soon as count responsive peers are
+	 *	 known, hence only the closest buckets are scanned. Ids are
+	 *	 ranked in a scratch buffer kept between the calls made by
+	 *	 the same thread.
+	 */
+	template<typename OutputIterator>
+	std::size_t closest(const id& target, std::size_t count, OutputIterator out)
+	{
+		if ( count == 0 )
+			return 0;
+
+		auto& candidates = closest_candidates();
+		candidates.clear();
+		std::size_t responsive_count = 0;
+
+		// Peers of the bucket of level l and digit d share their
+		// first l digits with our id and their digit l is ours xor d.
+		// Hence their distance to the target shares its first l digits
+		// with the distance between the target and our id, x, and its
+		// digit l is x's one xor d. So each bucket spans its own
+		// distance range: at each level, buckets whose digit is below
+		// x's one come first (from the far level to the close one),
+		// then the closer levels (including the last bucket, whose
+		// peers distance shares all its leading digits with x), then
+		// the buckets whose digit is above x's one (from the close
+		// level to the far one).
+		id const x = distance( target, my_id_ );
+		bool const has_last_k_bucket = k_buckets_.size() != MAX_K_BUCKET_COUNT;
+		std::size_t const full_levels_count = has_last_k_bucket
+				? ( k_buckets_.size() - 1 ) / K_BUCKETS_PER_LEVEL
+				: LEVELS_COUNT;
+
+		for ( std::size_t level = 0
+			; level != full_levels_count && responsive_count < count
+			; ++ level )
+		{
+			auto const x_digit = get_digit( x, level );
+			for ( std::size_t v = 0
+				; v != x_digit && responsive_count < count
+				; ++ v )
+				responsive_count += add_closest_candidates( candidates, target, get_k_bucket_index( level, v ^ x_digit ) );
+		}
 
-		// Find the first non empty k_bucket.
-		while ( i->empty() && i != k_buckets_.begin() )
-			-- i;
+		if ( has_last_k_bucket && responsive_count < count )
+			responsive_count += add_closest_candidates( candidates, target, k_buckets_.size() - 1 );
 
-		return iterator( &k_buckets_, i, i->begin() );
+		for ( std::size_t level = full_levels_count
+			; level != 0 && responsive_count < count
+			; -- level )
+		{
+			auto const x_digit = get_digit( x, level - 1 );
+			for ( std::size_t v = x_digit + 1
+				; v <= K_BUCKETS_PER_LEVEL && responsive_count < count
+				; ++ v )
+				responsive_count += add_closest_candidates( candidates, target, get_k_bucket_index( level - 1, v ^ x_digit ) );
+		}
+
+		auto const found = std::min( count, candidates.size() );
+		auto const last = std::next( candidates.begin(), found );
+		std::partial_sort( candidates.begin(), last, candidates.end()
+						 , []( closest_candidate const& a, closest_candidate const& b )
+						 { return a.stale_ != b.stale_ ? b.stale_ : a.distance_ < b.distance_; } );
+
+		for ( auto i = candidates.begin(); i != last; ++ i, ++ out )
+		{
+			auto const& bucket = k_buckets_[ i->k_bucket_index_ ];
+			*out = value_type{ bucket.peer_id( i->entry_index_ )
+							 , peer_type( bucket.endpoint( i->entry_index_ ).address() ) };
+		}
+
+		return found;
 	}
 
 	/**
@@ -217,9 +595,8 @@ public:
 	iterator end()
 	{
 		assert( k_buckets_.size() > 0 && "routing_table must always contains k_buckets" );
-		auto const first_k_bucket = k_buckets_.begin();
 
-		return iterator( &k_buckets_, first_k_bucket, first_k_bucket->end() );
+		return iterator( &k_buckets_, &non_empty_k_buckets_ );
 	}
 
 	/**
@@ -240,7 +617,7 @@ public:
 		{
 			out << "\t{" << std::endl
 				<< "\t\t\"index\": " << i << "," << std::endl
-				<< "\t\t\"bit_value\": " << bool(table.my_id_[i]) << "," << std::endl
+				<< "\t\t\"bit_value\": " << get_digit(table.my_id_, i / K_BUCKETS_PER_LEVEL) << "," << std::endl
 				<< "\t\t\"peer_count\": " << table.k_buckets_[i].size() << std::endl
 				<< "\t}" << std::endl;
 		}
@@ -249,47 +626,244 @@ public:
 	}
 
 private:
-	/// Contains peer with a common base id.
-	using k_bucket = std::list< value_type >;
+	/// Progress of a bucket liveness check.
+	enum liveness_check_state : std::uint8_t
+	{
+		LIVENESS_CHECK_NONE,
+		LIVENESS_CHECK_WANTED,
+		LIVENESS_CHECK_PENDING
+	};
+
+	/// Ranks a peer in closest().
+	struct closest_candidate
+	{
+		id distance_;
+		std::uint32_t k_bucket_index_;
+		std::uint32_t entry_index_;
+		bool stale_;
+	};
+
 	/// Contains all the k_bucket.
 	/// @note Algorithms expect a vector here, do not change this.
 	using k_buckets = std::vector< k_bucket >;
 
+	using k_bucket_bitmap_type = k_bucket_bitmap< MAX_K_BUCKET_COUNT >;
+
+	enum : std::size_t
+	{
+		INITIAL_K_BUCKET_COUNT = KBucketsLayout::SPLIT_ON_DEMAND ? 1 : MAX_K_BUCKET_COUNT
+	};
+
 private:
-	std::size_t find_k_bucket_index(const id& id_to_find) const
+	static std::size_t get_digit(const id& i, std::size_t level)
+	{
+		std::size_t digit = 0;
+		for ( std::size_t bit = level * SymbolBitSize, e = bit + SymbolBitSize
+			; bit != e
+			; ++ bit )
+			digit = digit << 1 | bool( i[ bit ] );
+		return digit;
+	}
+
+	static std::size_t get_k_bucket_index(std::size_t level, std::size_t digit)
+	{
+		// Within a level, the lower the distance digit,
+		// the closer the peer, the higher the index.
+		assert( digit != 0 && digit <= K_BUCKETS_PER_LEVEL );
+		return level * K_BUCKETS_PER_LEVEL + K_BUCKETS_PER_LEVEL - digit;
+	}
+
+	std::size_t find_unbounded_k_bucket_index(const id& id_to_find) const
 	{
 		// Find closest bucket from the peer id.
-		// i.e. the index of the first different bit
-		// in the id of the new peer vs our id is equal to the
-		// index of the closest bucket in the buckets container.
-		std::size_t bit_index = 0;
-		while ( bit_index < id::BIT_SIZE - 1
-			  && id_to_find[ bit_index ] == my_id_[ bit_index ] )
-			++ bit_index;
+		// i.e. the level of the first different digit
+		// in the id of the new peer vs our id, and the
+		// value of that digit in their distance.
+		id const d = distance( id_to_find, my_id_ );
+		std::size_t const bit_index = d.count_leading_zeros();
+		if ( bit_index == id::BIT_SIZE )
+			return MAX_K_BUCKET_COUNT - 1;
+
+		auto const level = bit_index / SymbolBitSize;
+		return get_k_bucket_index( level, get_digit( d, level ) );
+	}
 
-		//LOG_DEBUG( routing_table, this ) << "found bucket at index '" << bit_index << "'." << std::endl;
+	std::size_t find_k_bucket_index(const id& id_to_find) const
+	{
+		// The last bucket covers all the ids sharing at least
+		// as many digits with ours (including our own id).
+		return std::min( find_unbounded_k_bucket_index( id_to_find )
+					   , k_buckets_.size() - 1 );
+	}
 
-		return bit_index;
+	void split_last_k_bucket()
+	{
+		auto const last_index = k_buckets_.size() - 1;
+
+		LOG_DEBUG( routing_table, this ) << "splitting bucket '"
+				<< last_index << "'." << std::endl;
+
+		// The last bucket becomes the first one of its level and
+		// peers of the other buckets of the level or of closer
+		// levels move to the new buckets. The last level has no
+		// closer one.
+		k_buckets_.resize( std::min< std::size_t >( last_index + 1 + K_BUCKETS_PER_LEVEL
+												  , MAX_K_BUCKET_COUNT ) );
+		replacement_caches_.resize( k_buckets_.size() );
+		liveness_checks_.resize( k_buckets_.size(), LIVENESS_CHECK_NONE );
+		liveness_checks_[ last_index ] = LIVENESS_CHECK_NONE;
+		k_bucket_lookups_.resize( k_buckets_.size(), k_bucket_lookups_[ last_index ] );
+
+		move_closer_entries( k_buckets_, last_index, k_bucket_size_ );
+		move_closer_entries( replacement_caches_, last_index, replacement_cache_size_ );
+
+		for ( std::size_t i = last_index; i != k_buckets_.size(); ++ i )
+			non_empty_k_buckets_.set( i, ! k_buckets_[ i ].empty() );
+		lowest_k_bucket_index_ = get_lowest_k_bucket_index();
 	}
 
-	std::size_t get_lowest_k_bucket_index() const
+	void move_closer_entries(k_buckets& buckets, std::size_t from_index
+			, std::size_t capacity)
+	{
+		auto& from = buckets[ from_index ];
+		for ( std::size_t i = 0; i != from.size(); )
+		{
+			auto const index = find_k_bucket_index( from.peer_id( i ) );
+			if ( index == from_index )
+			{
+				++ i;
+				continue;
+			}
+
+			auto& to = buckets[ index ];
+			to.push_back( from.peer_id( i ), from.endpoint( i ), from.last_seen( i ), capacity );
+			to.set_failures( to.size() - 1, from.failures( i ) );
+			to.set_rtt( to.size() - 1, from.rtt( i ) );
+			from.erase( i );
+		}
+	}
+
+	/**
+	 *  @return The scratch buffer of closest(). Each thread has its
+	 *	 own, as both the network and the caller threads query the
+	 *	 table.
+	 */
+	static std::vector< closest_candidate >& closest_candidates()
 	{
-		std::size_t i = 0ULL, e = k_buckets_.size() - 1;
+		static thread_local std::vector< closest_candidate > candidates;
+		return candidates;
+	}
+
+	/**
+	 *  @return The number of responsive peers added.
+	 */
+	std::size_t add_closest_candidates(std::vector< closest_candidate >& candidates
+			, const id& target, std::size_t index) const
+	{
+		std::size_t responsive_count = 0;
+		auto const& bucket = k_buckets_[ index ];
+		for ( std::size_t i = 0, e = bucket.size(); i != e; ++ i )
+		{
+			bool const stale = bucket.failures( i ) != 0;
+			candidates.push_back( closest_candidate{ distance( target, bucket.peer_id( i ) )
+												   , std::uint32_t( index )
+												   , std::uint32_t( i )
+												   , stale } );
+			responsive_count += ! stale;
+		}
+		return responsive_count;
+	}
 
-		for ( std::size_t peer_count = 0ULL
-			; i != e && peer_count <= k_bucket_size_
-			; ++ i )
+	std::size_t get_lowest_k_bucket_index() const
+	{
+		// The first bucket after the (far) ones
+		// containing more than k_bucket_size_ peers.
+		std::size_t const e = k_buckets_.size() - 1;
+		std::size_t peer_count = 0ULL;
+
+		for ( std::size_t i = non_empty_k_buckets_.next( 0 )
+			; i < e
+			; i = non_empty_k_buckets_.next( i + 1 ) )
+		{
 			peer_count += k_buckets_[ i ].size();
+			if ( peer_count > k_bucket_size_ )
+				return i + 1;
+		}
+
+		return e;
+	}
+
+	void k_bucket_resized(std::size_t index)
+	{
+		non_empty_k_buckets_.set( index, ! k_buckets_[ index ].empty() );
 
-		//LOG_DEBUG( routing_table, this ) << "bottom bucket is at index '" << i << "'." << std::endl;
+		// Only the buckets before the lowest one are counted.
+		if ( index < lowest_k_bucket_index_ )
+			lowest_k_bucket_index_ = get_lowest_k_bucket_index();
+	}
 
-		return i;
+	static void mark_as_seen(k_bucket& bucket, std::size_t index, clock::time_point last_seen)
+	{
+		bucket.set_failures(index, 0);
+		bucket.set_last_seen(index, last_seen);
+		bucket.move_to_back(index);
 	}
 
-	void update_largest_k_bucket_index(std::size_t index)
+	void insert(std::size_t index, const id& peer_id, packed_endpoint const& endpoint
+			, clock::time_point last_seen)
 	{
-		if ( k_buckets_[ largest_k_bucket_index_ ].size() <= k_bucket_size_ )
-			largest_k_bucket_index_ = index;
+		// If this is a known endpoint (IP:PORT), coming under a
+		// different ID, then the old entry needs to be removed.
+		if (auto known_id = _knownPeers.find(endpoint))
+			remove(id(*known_id));
+
+		auto& cache = replacement_caches_[ index ];
+		auto const replacement = cache.find(peer_id);
+		if ( replacement != cache.size() )
+			cache.erase(replacement);
+
+		k_buckets_[ index ].push_back(peer_id, endpoint, last_seen, k_bucket_size_);
+		++ peer_count_;
+		k_bucket_resized( index );
+		_knownPeers.insert(endpoint, peer_id);
+	}
+
+	void add_replacement(std::size_t index, const id& peer_id, packed_endpoint const& endpoint
+			, clock::time_point last_seen)
+	{
+		if ( replacement_cache_size_ == 0 )
+			return;
+
+		// Keep the most recently seen peers.
+		auto& cache = replacement_caches_[ index ];
+		auto const known = cache.find(peer_id);
+		if ( known != cache.size() )
+			cache.erase(known);
+		else if ( cache.size() == replacement_cache_size_ )
+			cache.erase(0);
+		cache.push_back(peer_id, endpoint, last_seen, replacement_cache_size_);
+
+		if ( liveness_checks_[ index ] == LIVENESS_CHECK_NONE )
+			liveness_checks_[ index ] = LIVENESS_CHECK_WANTED;
+	}
+
+	void evict(std::size_t index, const id& peer_id)
+	{
+		if ( ! remove(peer_id) )
+			return;
+
+		++ evictions_count_;
+
+		auto& cache = replacement_caches_[ index ];
+		while ( ! cache.empty() && k_buckets_[ index ].size() < k_bucket_size_ )
+		{
+			auto const last = cache.size() - 1;
+			id const replacement_id = cache.peer_id(last);
+			packed_endpoint const replacement_endpoint = cache.endpoint(last);
+
+			insert( index, replacement_id, replacement_endpoint, cache.last_seen(last) );
+			++ replacements_count_;
+		}
 	}
 
 private:
@@ -305,48 +879,75 @@ private:
 	std::size_t k_bucket_size_;
 		/// Max number of peers stored per k_bucket.
 
-	std::size_t largest_k_bucket_index_;
-		/// Keeps the index of the largest subtree.
+	k_buckets replacement_caches_;
+		/// Peers refused by full buckets, most recently seen last.
+
+	std::size_t replacement_cache_size_;
+		/// Max number of peers stored per replacement cache.
+
+	std::vector<std::uint8_t> liveness_checks_;
+		/// Per bucket liveness_check_state.
 
-	using KnownPeerMap = std::map<Poco::Net::SocketAddress, id>;
-	KnownPeerMap _knownPeers;
+	std::size_t evictions_count_;
+		/// Count of peers evicted after a failed liveness check.
+
+	std::size_t replacements_count_;
+		/// Count of peers moved from a replacement cache to a bucket.
+
+	recent_peers recent_peers_;
+		/// Peers refreshed less than RECENT_PEER_REFRESH_PERIOD ago.
+
+	endpoint_index _knownPeers;
 		/// Keeps a cache of known peers
 		/// Used to purge provably dead (ie. peers
 		/// with known IP:PORT showing under a new ID)
+
+	k_bucket_bitmap_type non_empty_k_buckets_;
+		/// Flags the k_buckets_ containing peers.
+
+	std::size_t lowest_k_bucket_index_;
+		/// Where find() starts at the latest, kept up to
+		/// date as the buckets before it are modified.
+
+	std::vector<clock::time_point> k_bucket_lookups_;
+		/// Per bucket time of the last lookup of an id it covers.
 };
 
 
-template<typename PeerType>
-class routing_table<PeerType>::iterator
+template<typename PeerType, typename KBucketsLayout, std::size_t SymbolBitSize>
+class routing_table<PeerType, KBucketsLayout, SymbolBitSize>::iterator
+	/// Walks the buckets from the one it has been created with
+	/// down to the first (far) one. The current entry is unpacked
+	/// on first dereference and kept until the iterator moves.
 {
 public:
 	using iterator_category = std::forward_iterator_tag;
-	using value_type = PeerType;
+	using value_type = typename routing_table::value_type;
 	using difference_type = std::ptrdiff_t;
-	using pointer = PeerType*;
-	using reference = PeerType&;
+	using pointer = value_type const*;
+	using reference = value_type const&;
+
+	iterator(k_buckets const* buckets, k_bucket_bitmap_type const* non_empty_buckets)
+		/// Creates the end iterator.
+		: k_buckets_( buckets )
+		, non_empty_k_buckets_( non_empty_buckets )
+		, current_k_bucket_( 0 )
+		, current_entry_( END_ENTRY )
+		, unpacked_( false )
+	{ }
 
 	iterator
-		( k_buckets * buckets
-		, typename k_buckets::iterator current_bucket
-		, typename k_bucket::iterator current_peer )
+		( k_buckets const* buckets
+		, k_bucket_bitmap_type const* non_empty_buckets
+		, std::size_t current_bucket
+		, std::size_t current_peer )
 		: k_buckets_( buckets )
+		, non_empty_k_buckets_( non_empty_buckets )
 		, current_k_bucket_( current_bucket )
 		, current_entry_( current_peer )
-	{ }
-
-	iterator(const iterator& other): k_buckets_(other.k_buckets_),
-		current_k_bucket_(other.current_k_bucket_),
-		current_entry_(other.current_entry_)
-	{ }
-
-	iterator& operator = (const iterator& o)
+		, unpacked_( false )
 	{
-		k_buckets_ = o.k_buckets_;
-		current_k_bucket_ = o.current_k_bucket_;
-		current_entry_ = o.current_entry_;
-
-		return *this;
+		skip_exhausted_k_buckets();
 	}
 
 	bool operator == (const iterator& other) const
@@ -359,12 +960,12 @@ public:
 		return !equal(other);
 	}
 
-	typename routing_table::value_type& operator * () const
+	reference operator * () const
 	{
 		return dereference();
 	}
 
-	typename routing_table::value_type* operator -> () const
+	pointer operator -> () const
 	{
 		return &dereference();
 	}
@@ -375,7 +976,6 @@ public:
 		return *this;
 	}
 
-
 	iterator operator ++ (int)
 	{
 		iterator old(*this);
@@ -384,25 +984,34 @@ public:
 	}
 
 private:
+	enum : std::size_t { END_ENTRY = std::numeric_limits<std::size_t>::max() };
+
 	void increment()
 	{
 		++ current_entry_;
+		unpacked_ = false;
+		skip_exhausted_k_buckets();
+	}
 
-		// If the current entry is not at the end of the bucket
-		// then there is nothing more to do.
-		if ( current_entry_ != current_k_bucket_->end() )
-			return;
-
-		// If the current bucket is already the first (far)
-		// then there is nothing more to do, we reach the end of the routing table.
-		if ( current_k_bucket_ == k_buckets_->begin() )
-			return;
-
+	void skip_exhausted_k_buckets()
+	{
 		// Go to the next non-empty bucket and start from its first entry.
-		do
-			-- current_k_bucket_;
-		while ( current_k_bucket_->empty() && current_k_bucket_ != k_buckets_->begin() );
-		current_entry_ = current_k_bucket_->begin();
+		// Once the first (far) bucket is exhausted, we reach the end
+		// of the routing table.
+		while ( current_entry_ >= (*k_buckets_)[ current_k_bucket_ ].size() )
+		{
+			auto const previous = current_k_bucket_ == 0
+					? std::size_t( k_bucket_bitmap_type::NPOS )
+					: non_empty_k_buckets_->previous( current_k_bucket_ - 1 );
+			if ( previous == k_bucket_bitmap_type::NPOS )
+			{
+				current_k_bucket_ = 0;
+				current_entry_ = END_ENTRY;
+				return;
+			}
+			current_k_bucket_ = previous;
+			current_entry_ = 0;
+		}
 	}
 
 	bool equal(iterator const& o) const
@@ -412,16 +1021,25 @@ private:
 				&& current_entry_ == o.current_entry_;
 	}
 
-	typename routing_table::value_type& dereference() const
+	reference dereference() const
 	{
-		return *current_entry_;
+		if ( ! unpacked_ )
+		{
+			auto const& bucket = (*k_buckets_)[ current_k_bucket_ ];
+			current_.first = bucket.peer_id( current_entry_ );
+			current_.second = peer_type( bucket.endpoint( current_entry_ ).address() );
+			unpacked_ = true;
+		}
+		return current_;
 	}
 
 private:
-	k_buckets * k_buckets_;
-	typename k_buckets::iterator current_k_bucket_;
-	typename k_bucket::iterator current_entry_;
-
+	k_buckets const* k_buckets_;
+	k_bucket_bitmap_type const* non_empty_k_buckets_;
+	std::size_t current_k_bucket_;
+	std::size_t current_entry_;
+	mutable value_type current_;
+	mutable bool unpacked_;
 };
 
 } // namespace detail
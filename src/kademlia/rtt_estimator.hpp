@@ -0,0 +1,162 @@
+//
+// rtt_estimator.hpp
+//
+// Library: Kademlia
+// Package: DHT
+// Module:  rtt_estimator
+//
+// Definition of the rtt_estimator and rtt_estimators classes.
+//
+// Copyright (c) 2021, Aleph ONE Software Engineering and Contributors.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+#ifndef KADEMLIA_RTT_ESTIMATOR_HPP
+#define KADEMLIA_RTT_ESTIMATOR_HPP
+
+#ifdef _MSC_VER
+#   pragma once
+#endif
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+
+#include "kademlia/packed_endpoint.hpp"
+
+namespace kademlia {
+namespace detail {
+
+
+inline std::uint32_t smooth_rtt(std::uint32_t srtt, std::chrono::microseconds sample)
+	/// Returns the smoothed round trip time srtt (in microseconds,
+	/// 0 if unknown) updated with a new sample. As in TCP (RFC 6298),
+	/// each sample accounts for 1/8 of the estimate.
+{
+	using rep = std::chrono::microseconds::rep;
+	auto const s = std::uint32_t(std::min<rep>(std::max<rep>(sample.count(), 1),
+		std::numeric_limits<std::uint32_t>::max()));
+	if (srtt == 0) return s;
+	return std::uint32_t(std::max<std::int64_t>(std::int64_t(srtt) + (std::int64_t(s) - std::int64_t(srtt)) / 8, 1));
+}
+
+
+class rtt_estimator final
+	/// Derives a retransmission timeout from round trip time samples
+	/// the way TCP does (RFC 6298): RTO = SRTT + 4 * RTTVAR, where
+	/// RTTVAR tracks the mean deviation of the samples.
+{
+public:
+	using duration = std::chrono::microseconds;
+
+	rtt_estimator(): srtt_(0), rttvar_(0)
+	{
+	}
+
+	bool empty() const
+		/// Returns true until the first sample.
+	{
+		return srtt_ == 0;
+	}
+
+	void update(duration sample)
+	{
+		auto const r = std::max<duration::rep>(sample.count(), 1);
+		if (empty())
+		{
+			srtt_ = r;
+			rttvar_ = r / 2;
+			return;
+		}
+
+		rttvar_ += (std::abs(srtt_ - r) - rttvar_) / 4;
+		srtt_ += (r - srtt_) / 8;
+	}
+
+	duration srtt() const
+	{
+		return duration(srtt_);
+	}
+
+	duration rttvar() const
+	{
+		return duration(rttvar_);
+	}
+
+	duration rto(duration min, duration max, duration initial) const
+		/// Returns the timeout within [min, max], initial if empty().
+	{
+		if (empty()) return initial;
+		auto const rto = duration(srtt_ + std::max<duration::rep>(4 * rttvar_, 1000));
+		return std::min(std::max(rto, min), max);
+	}
+
+	duration latency_bound(duration min, duration max, duration initial) const
+		/// Returns SRTT + 2 * RTTVAR within [min, max], initial if
+		/// empty(): most responses arrive within it (about 95% if the
+		/// round trip times were normally distributed).
+	{
+		if (empty()) return initial;
+		auto const bound = duration(srtt_ + 2 * rttvar_);
+		return std::min(std::max(bound, min), max);
+	}
+
+private:
+	duration::rep srtt_;
+	duration::rep rttvar_;
+};
+
+
+class rtt_estimators final
+	/// Keeps a rtt_estimator per endpoint.
+	///
+	/// Direct mapped cache of SIZE slots indexed by a hash of the
+	/// endpoint, like recent_peers: a colliding endpoint replaces
+	/// the previous one, which then starts over from the initial
+	/// timeout.
+{
+public:
+	enum : std::size_t { SIZE = 1024 };
+
+	rtt_estimators(): slots_()
+	{
+	}
+
+	rtt_estimator const* find(packed_endpoint const& endpoint) const
+		/// Returns the estimator of the endpoint, nullptr if unknown.
+	{
+		auto const& s = slots_[endpoint.hash() % SIZE];
+		return s.endpoint_ == endpoint ? &s.estimator_ : nullptr;
+	}
+
+	void update(packed_endpoint const& endpoint, rtt_estimator::duration sample)
+	{
+		auto& s = slots_[endpoint.hash() % SIZE];
+		if (s.endpoint_ != endpoint)
+		{
+			s.endpoint_ = endpoint;
+			s.estimator_ = rtt_estimator();
+		}
+		s.estimator_.update(sample);
+	}
+
+private:
+	struct slot
+	{
+		packed_endpoint endpoint_;
+		rtt_estimator estimator_;
+	};
+
+	std::array<slot, SIZE> slots_;
+};
+
+
+} // namespace detail
+} // namespace kademlia
+
+#endif
@@ -0,0 +1,329 @@
+//
+// timing_wheel.hpp
+//
+// Library: Kademlia
+// Package: DHT
+// Module:  timing_wheel
+//
+// Definition of the timing_wheel class.
+//
+// Copyright (c) 2021, Aleph ONE Software Engineering and Contributors.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+#ifndef KADEMLIA_TIMING_WHEEL_HPP
+#define KADEMLIA_TIMING_WHEEL_HPP
+
+#ifdef _MSC_VER
+#   pragma once
+#   include <intrin.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace kademlia {
+namespace detail {
+
+
+class timing_wheel final
+	/// Hierarchical timing wheel (Varghese & Lauck).
+	///
+	/// Time is counted in ticks. LEVEL_COUNT wheels of SLOT_COUNT slots
+	/// cover 2^32 ticks: level l holds the timers expiring between
+	/// SLOT_COUNT^l and SLOT_COUNT^(l+1) ticks from now, and its slots
+	/// are cascaded into the lower levels as time reaches them.
+	///
+	/// Timers are nodes of a slab linked into their slot by index,
+	/// so that insert() and cancel() are O(1) and only allocate when
+	/// the slab grows. A handle holds the node index and generation:
+	/// cancelling an expired (or already cancelled) timer is a no-op.
+{
+public:
+	using tick_type = std::uint64_t;
+	using callback = std::function<void ()>;
+
+	enum : std::size_t
+	{
+		LEVEL_BITS = 8,
+		SLOT_COUNT = std::size_t(1) << LEVEL_BITS,
+		LEVEL_COUNT = 4
+	};
+
+	enum : std::uint32_t { NIL = std::numeric_limits<std::uint32_t>::max() };
+
+	struct handle
+	{
+		std::uint32_t index_ = NIL;
+		std::uint32_t generation_ = 0;
+	};
+
+	timing_wheel(): nodes_(), free_(NIL), now_(0), size_(0), heads_(), tails_(), bits_()
+	{
+		heads_.fill(NIL);
+		tails_.fill(NIL);
+	}
+
+	tick_type now() const
+		/// Returns the next tick to process.
+	{
+		return now_;
+	}
+
+	std::size_t size() const
+	{
+		return size_;
+	}
+
+	bool empty() const
+	{
+		return size_ == 0;
+	}
+
+	handle insert(tick_type expiry, callback on_expired)
+		/// Adds a timer expiring at tick expiry. Past expiries expire
+		/// at the next tick, expiries beyond the range of the wheel
+		/// are brought back to its last tick.
+	{
+		auto const last = now_ + (tick_type(1) << (LEVEL_BITS * LEVEL_COUNT)) - 1;
+		expiry = std::min(std::max(expiry, now_), last);
+
+		std::uint32_t index = free_;
+		if (index != NIL)
+			free_ = nodes_[index].next_;
+		else
+		{
+			index = std::uint32_t(nodes_.size());
+			nodes_.emplace_back();
+		}
+
+		auto& n = nodes_[index];
+		n.expiry_ = expiry;
+		n.on_expired_ = std::move(on_expired);
+		link(index);
+		++size_;
+
+		handle h;
+		h.index_ = index;
+		h.generation_ = n.generation_;
+		return h;
+	}
+
+	bool cancel(handle const& h)
+		/// Removes the timer, returns false if it already expired
+		/// or has been cancelled.
+	{
+		if (h.index_ >= nodes_.size()) return false;
+		auto& n = nodes_[h.index_];
+		if (!n.linked_ || n.generation_ != h.generation_) return false;
+		unlink(h.index_);
+		release(h.index_);
+		return true;
+	}
+
+	tick_type next_tick() const
+		/// Returns the next tick advance() has something to do at:
+		/// either a timer expiry or a cascade of a higher level slot.
+		/// The wheel must not be empty().
+	{
+		assert(!empty());
+		auto next = std::numeric_limits<tick_type>::max();
+
+		auto const offset = find_next_slot(0, now_ % SLOT_COUNT);
+		if (offset != SLOT_COUNT) next = now_ + offset;
+
+		for (std::size_t level = 1; level != LEVEL_COUNT; ++level)
+		{
+			// Slots are cascaded at the start of their span.
+			auto const shift = LEVEL_BITS * level;
+			auto const span = (now_ + (tick_type(1) << shift) - 1) >> shift;
+			auto const o = find_next_slot(level, span % SLOT_COUNT);
+			if (o != SLOT_COUNT) next = std::min(next, (span + o) << shift);
+		}
+		return next;
+	}
+
+	template<typename OnExpired>
+	void advance(tick_type tick, OnExpired on_expired)
+		/// Processes the ticks up to tick (included), calling
+		/// on_expired(callback&) for each expired timer, in expiry order.
+		/// on_expired must not modify the wheel.
+	{
+		while (now_ <= tick)
+		{
+			if (empty())
+			{
+				now_ = tick + 1;
+				return;
+			}
+
+			cascade();
+			expire(on_expired);
+			++now_;
+
+			// Skip the empty slots until the next cascade.
+			if (now_ % SLOT_COUNT != 0)
+			{
+				auto const offset = find_next_slot(0, now_ % SLOT_COUNT);
+				auto const next = offset < SLOT_COUNT - now_ % SLOT_COUNT
+					? now_ + offset : (now_ | (SLOT_COUNT - 1)) + 1;
+				now_ = std::min(next, tick + 1);
+			}
+		}
+	}
+
+private:
+	enum : std::size_t { WORD_BITS = 64, WORDS_PER_LEVEL = SLOT_COUNT / WORD_BITS };
+
+	struct node
+	{
+		tick_type expiry_ = 0;
+		callback on_expired_;
+		std::uint32_t prev_ = NIL;
+		std::uint32_t next_ = NIL;
+		std::uint32_t generation_ = 0;
+		std::uint16_t slot_ = 0;
+		bool linked_ = false;
+	};
+
+	void link(std::uint32_t index)
+	{
+		auto& n = nodes_[index];
+		auto const delta = n.expiry_ - now_;
+		std::size_t level = 0;
+		while (level != LEVEL_COUNT - 1 && delta >> (LEVEL_BITS * (level + 1)) != 0)
+			++level;
+
+		auto const slot = level * SLOT_COUNT + (n.expiry_ >> (LEVEL_BITS * level)) % SLOT_COUNT;
+		n.slot_ = std::uint16_t(slot);
+		n.prev_ = tails_[slot];
+		n.next_ = NIL;
+		n.linked_ = true;
+		if (n.prev_ != NIL) nodes_[n.prev_].next_ = index;
+		else heads_[slot] = index;
+		tails_[slot] = index;
+		bits_[slot / WORD_BITS] |= std::uint64_t(1) << slot % WORD_BITS;
+	}
+
+	void unlink(std::uint32_t index)
+	{
+		auto& n = nodes_[index];
+		if (n.prev_ != NIL) nodes_[n.prev_].next_ = n.next_;
+		else heads_[n.slot_] = n.next_;
+		if (n.next_ != NIL) nodes_[n.next_].prev_ = n.prev_;
+		else tails_[n.slot_] = n.prev_;
+		if (heads_[n.slot_] == NIL)
+			bits_[n.slot_ / WORD_BITS] &= ~(std::uint64_t(1) << n.slot_ % WORD_BITS);
+		n.linked_ = false;
+	}
+
+	void release(std::uint32_t index)
+	{
+		auto& n = nodes_[index];
+		n.on_expired_ = nullptr;
+		++n.generation_;
+		n.next_ = free_;
+		free_ = index;
+		--size_;
+	}
+
+	std::uint32_t detach(std::size_t slot)
+		/// Empties the slot, returns its first node.
+	{
+		auto const first = heads_[slot];
+		heads_[slot] = NIL;
+		tails_[slot] = NIL;
+		bits_[slot / WORD_BITS] &= ~(std::uint64_t(1) << slot % WORD_BITS);
+		return first;
+	}
+
+	void cascade()
+		/// Moves the timers of the higher level slots starting at
+		/// now_ to the levels matching their remaining delay.
+	{
+		std::size_t level = 1;
+		while (level != LEVEL_COUNT && now_ % (tick_type(1) << (LEVEL_BITS * level)) == 0)
+			++level;
+
+		while (--level != 0)
+		{
+			auto const slot = level * SLOT_COUNT + (now_ >> (LEVEL_BITS * level)) % SLOT_COUNT;
+			for (auto i = detach(slot); i != NIL; )
+			{
+				auto const next = nodes_[i].next_;
+				link(i);
+				i = next;
+			}
+		}
+	}
+
+	template<typename OnExpired>
+	void expire(OnExpired& on_expired)
+	{
+		for (auto i = detach(now_ % SLOT_COUNT); i != NIL; )
+		{
+			auto& n = nodes_[i];
+			auto const next = n.next_;
+			n.linked_ = false;
+			auto c = std::move(n.on_expired_);
+			release(i);
+			on_expired(c);
+			i = next;
+		}
+	}
+
+	std::size_t find_next_slot(std::size_t level, std::size_t from) const
+		/// Returns the offset from slot from of the next non-empty slot
+		/// of the level (wrapping around), SLOT_COUNT if the level is empty.
+	{
+		auto const words = &bits_[level * WORDS_PER_LEVEL];
+		for (std::size_t offset = 0, i = from; offset < SLOT_COUNT; )
+		{
+			auto const bit = i % WORD_BITS;
+			auto const w = words[i / WORD_BITS] >> bit;
+			if (w != 0) return std::min<std::size_t>(offset + count_trailing_zeros(w), SLOT_COUNT);
+			offset += WORD_BITS - bit;
+			i = (i + WORD_BITS - bit) % SLOT_COUNT;
+		}
+		return SLOT_COUNT;
+	}
+
+	static std::size_t count_trailing_zeros(std::uint64_t w)
+		/// w must not be 0.
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		return __builtin_ctzll(w);
+#elif defined(_MSC_VER) && defined(_M_X64)
+		unsigned long index;
+		_BitScanForward64(&index, w);
+		return index;
+#else
+		std::size_t count = 0;
+		for (; (w & 1) == 0; w >>= 1)
+			++count;
+		return count;
+#endif
+	}
+
+	std::vector<node> nodes_;
+	std::uint32_t free_;
+	tick_type now_;
+	std::size_t size_;
+	std::array<std::uint32_t, LEVEL_COUNT * SLOT_COUNT> heads_;
+	std::array<std::uint32_t, LEVEL_COUNT * SLOT_COUNT> tails_;
+	std::array<std::uint64_t, LEVEL_COUNT * WORDS_PER_LEVEL> bits_;
+};
+
+
+} // namespace detail
+} // namespace kademlia
+
+#endif
@@ -0,0 +1,131 @@
+//
+// value_cache.hpp
+//
+// Library: Kademlia
+// Package: DHT
+// Module:  value_cache
+//
+// Definition of the value_cache class.
+//
+// Copyright (c) 2021, Aleph ONE Software Engineering and Contributors.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+#ifndef KADEMLIA_VALUE_CACHE_HPP
+#define KADEMLIA_VALUE_CACHE_HPP
+
+#ifdef _MSC_VER
+#   pragma once
+#endif
+
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <utility>
+
+#include "kademlia/id.hpp"
+#include "kademlia/value_store.hpp"
+
+namespace kademlia {
+namespace detail {
+
+
+class value_cache final
+	/// Keeps the values just loaded from the network for a short
+	/// period, so that loads of hot keys are served locally.
+	///
+	/// Values expire period after being inserted, in insertion order,
+	/// and at most capacity values are kept (the oldest go first).
+	/// A zero period disables the cache.
+{
+public:
+	using clock = std::chrono::steady_clock;
+
+	value_cache(clock::duration period, std::size_t capacity):
+		period_(period), capacity_(capacity), values_(), insertions_()
+	{
+	}
+
+	bool enabled() const
+	{
+		return period_ > clock::duration::zero() && capacity_ > 0;
+	}
+
+	void configure(clock::duration period, std::size_t capacity)
+		/// Changes the period and capacity, forgetting all values.
+	{
+		period_ = period;
+		capacity_ = capacity;
+		values_.clear();
+		insertions_.clear();
+	}
+
+	data_type const* find(id const& key, clock::time_point now)
+		/// Returns the value, nullptr if unknown or expired.
+	{
+		expire(now);
+		auto const i = values_.find(key);
+		return i != values_.end() ? &i->second.data_ : nullptr;
+	}
+
+	void insert(id const& key, data_type const& data, clock::time_point now)
+	{
+		if (!enabled()) return;
+
+		expire(now);
+		auto& v = values_[key];
+		v.data_ = data;
+		v.inserted_ = now;
+		insertions_.emplace_back(now, key);
+
+		while (values_.size() > capacity_)
+			pop_oldest();
+	}
+
+	void erase(id const& key)
+	{
+		// Its insertion is forgotten as it expires.
+		values_.erase(key);
+	}
+
+	std::size_t size() const
+	{
+		return values_.size();
+	}
+
+private:
+	struct value
+	{
+		data_type data_;
+		clock::time_point inserted_;
+	};
+
+	void expire(clock::time_point now)
+	{
+		while (!insertions_.empty() && now - insertions_.front().first >= period_)
+			pop_oldest();
+	}
+
+	void pop_oldest()
+	{
+		auto const& oldest = insertions_.front();
+		// A value inserted again is removed along with its last insertion.
+		auto const i = values_.find(oldest.second);
+		if (i != values_.end() && i->second.inserted_ == oldest.first)
+			values_.erase(i);
+		insertions_.pop_front();
+	}
+
+	clock::duration period_;
+	std::size_t capacity_;
+	std::map<id, value> values_;
+	std::deque<std::pair<clock::time_point, id>> insertions_;
+};
+
+
+} // namespace detail
+} // namespace kademlia
+
+#endif
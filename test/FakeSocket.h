@@ -67,6 +67,8 @@ public:
 
 	using packets = std::queue<packet>;
 
+	using packet_filter = std::function<bool (packet const&)>;
+
 public:
 	FakeSocket(Poco::Net::SocketProactor* io_service,
 		const Poco::Net::SocketAddress& address, bool reuseAddress = true, bool ipV6Only = true):
@@ -190,7 +192,14 @@ public:
 		LOG_DEBUG(FakeSocket, this) << "asyncSendTo(" << buffer.size() << " bytes)" << std::endl;
 		// Ensure the destination socket is listening.
 		auto target = get_socket(to);
-		if (! target)
+		auto const& filter = get_packet_filter();
+		if (filter && ! filter(packet{ local_endpoint_, to, buffer }))
+		{
+			LOG_DEBUG(FakeSocket, this) << "packet lost." << std::endl;
+			// As far as the sender knows, the packet has been sent.
+			callback(std::error_code(), buffer.size());
+		}
+		else if (! target)
 		{
 			LOG_DEBUG(FakeSocket, this) << "network unreachable." << std::endl;
 			callback(make_error_code(std::errc::network_unreachable), 0ULL);
@@ -218,6 +227,13 @@ public:
 		return logged_packets_;
 	}
 
+	static packet_filter& get_packet_filter()
+		/// The packets the filter returns false for are lost.
+	{
+		static packet_filter filter_;
+		return filter_;
+	}
+
 	static Poco::Net::IPAddress get_first_ipv4()
 	{
 		return Poco::Net::IPAddress("10.0.0.0");
@@ -23,7 +23,9 @@
 // (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
 // SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <chrono>
 #include <memory>
+#include <string>
 #include "Poco/Net/SocketProactor.h"
 #include "kademlia/Session.h"
 #include "kademlia/endpoint.hpp"
@@ -48,12 +50,80 @@ public:
 	{ }
 
 	TestEngine(Poco::Net::SocketProactor& service, endpoint const & initial_peer
-		, endpoint const & ipv4, endpoint const & ipv6, detail::id const& new_id)
-			: engine_(service, initial_peer, ipv4, ipv6, new_id),
+		, endpoint const & ipv4, endpoint const & ipv6, detail::id const& new_id
+		, detail::lookup_config const& config = detail::lookup_config())
+			: engine_(service, initial_peer, ipv4, ipv6, new_id, config),
 			listen_ipv4_(FakeSocket::get_last_allocated_ipv4(), Session::DEFAULT_PORT),
 			listen_ipv6_(FakeSocket::get_last_allocated_ipv6(), Session::DEFAULT_PORT)
 	{ }
 
+	TestEngine(Poco::Net::SocketProactor& service, endpoint const & initial_peer
+		, endpoint const & ipv4, endpoint const & ipv6, std::string const& routing_table_path)
+			: engine_(service, initial_peer, ipv4, ipv6, routing_table_path),
+			listen_ipv4_(FakeSocket::get_last_allocated_ipv4(), Session::DEFAULT_PORT),
+			listen_ipv6_(FakeSocket::get_last_allocated_ipv6(), Session::DEFAULT_PORT)
+	{ }
+
+	bool initialized() const
+	{
+		return engine_.initialized();
+	}
+
+	detail::RoutingTableSnapshot routing_table_snapshot() const
+	{
+		return engine_.routing_table_snapshot();
+	}
+
+	bool save_routing_table()
+	{
+		return engine_.save_routing_table();
+	}
+
+	void enable_one_hop_routing()
+	{
+		engine_.enable_one_hop_routing();
+	}
+
+	std::size_t members_count() const
+	{
+		return engine_.members_count();
+	}
+
+	bool has_fresh_membership_view() const
+	{
+		return engine_.has_fresh_membership_view();
+	}
+
+	void enable_load_cache(std::chrono::milliseconds period)
+	{
+		engine_.enable_load_cache(period);
+	}
+
+	std::size_t pending_loads_count() const
+	{
+		return engine_.pending_loads_count();
+	}
+
+	void refresh_idle_k_buckets(std::chrono::milliseconds idle_period)
+	{
+		engine_.refresh_idle_k_buckets(idle_period);
+	}
+
+	std::size_t k_bucket_refreshes_count() const
+	{
+		return engine_.k_bucket_refreshes_count();
+	}
+
+	std::size_t pending_k_bucket_refreshes_count() const
+	{
+		return engine_.pending_k_bucket_refreshes_count();
+	}
+
+	std::chrono::milliseconds k_bucket_refresh_check_delay() const
+	{
+		return engine_.k_bucket_refresh_check_delay();
+	}
+
 	template< typename Callable >
 	void asyncSave(std::string const& key, std::string&& data, Callable & callable)
 	{
@@ -0,0 +1,179 @@
+//
+// IdBenchmark.cpp
+//
+// Measures id operations used on the routing hot paths. The byte
+// wise implementation id used previously is reproduced here as a
+// baseline.
+//
+// Copyright (c) 2021, Aleph ONE Software Engineering and Contributors.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+#include "kademlia/id.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+namespace kd = kademlia::detail;
+
+struct legacy_id
+	/// 20 uint8_t blocks, processed one byte (or bit) at a time.
+{
+	using blocks_type = std::array<std::uint8_t, 20>;
+
+	legacy_id(): blocks{}
+	{
+	}
+
+	explicit legacy_id(kd::id const& i)
+	{
+		std::copy(i.begin(), i.end(), blocks.begin());
+	}
+
+	explicit legacy_id(std::default_random_engine& random_engine)
+	{
+		std::uniform_int_distribution<> distribution(
+			std::numeric_limits<std::uint8_t>::min(),
+			std::numeric_limits<std::uint8_t>::max());
+		std::generate(blocks.begin(), blocks.end(),
+			std::bind(distribution, std::ref(random_engine)));
+		std::shuffle(blocks.begin(), blocks.end(), random_engine);
+	}
+
+	bool bit(std::size_t index) const
+	{
+		return (blocks[index / 8] & (0x80 >> index % 8)) != 0;
+	}
+
+	bool operator == (legacy_id const& o) const
+	{
+		return blocks == o.blocks;
+	}
+
+	bool operator < (legacy_id const& o) const
+	{
+		return std::lexicographical_compare(blocks.begin(), blocks.end(),
+			o.blocks.begin(), o.blocks.end());
+	}
+
+	blocks_type blocks;
+};
+
+
+legacy_id distance(legacy_id const& a, legacy_id const& b)
+{
+	legacy_id result;
+	std::transform(a.blocks.begin(), a.blocks.end(), b.blocks.begin(),
+		result.blocks.begin(), std::bit_xor<std::uint8_t>{});
+	return result;
+}
+
+
+std::size_t k_bucket_index(legacy_id const& my_id, legacy_id const& other)
+{
+	std::size_t bit_index = 0;
+	while (bit_index < kd::id::BIT_SIZE - 1 && other.bit(bit_index) == my_id.bit(bit_index))
+		++bit_index;
+	return bit_index;
+}
+
+
+std::size_t k_bucket_index(kd::id const& my_id, kd::id const& other)
+{
+	std::size_t const bit_index = distance(my_id, other).count_leading_zeros();
+	return bit_index == kd::id::BIT_SIZE ? kd::id::BIT_SIZE - 1 : bit_index;
+}
+
+
+using clock_type = std::chrono::steady_clock;
+
+
+template<typename Function>
+void measure(std::string const& name, std::size_t operations, Function f)
+{
+	auto const start = clock_type::now();
+	std::size_t const checksum = f();
+	double const seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+	std::cout << name << ": " << static_cast<std::size_t>(operations / seconds)
+		<< " ops/s (checksum " << checksum << ")" << std::endl;
+}
+
+
+template<typename IdType>
+void run(std::string const& name, std::vector<IdType> const& ids, std::size_t rounds)
+{
+	std::size_t const count = ids.size();
+	IdType const& my_id = ids.front();
+
+	measure(name + " k_bucket_index", count * rounds, [&]
+	{
+		std::size_t sum = 0;
+		for (std::size_t r = 0; r < rounds; ++r)
+			for (auto const& i : ids)
+				sum += k_bucket_index(my_id, i);
+		return sum;
+	});
+
+	measure(name + " distance+less", count * rounds, [&]
+	{
+		std::size_t sum = 0;
+		for (std::size_t r = 0; r < rounds; ++r)
+			for (std::size_t i = 1; i < count; ++i)
+				sum += distance(my_id, ids[i]) < distance(my_id, ids[i - 1]);
+		return sum;
+	});
+
+	measure(name + " equal", count * rounds, [&]
+	{
+		std::size_t sum = 0;
+		for (std::size_t r = 0; r < rounds; ++r)
+			for (std::size_t i = 1; i < count; ++i)
+				sum += ids[i] == ids[i - 1];
+		return sum;
+	});
+
+	measure(name + " random", count, [&]
+	{
+		std::default_random_engine random_engine;
+		std::size_t sum = 0;
+		for (std::size_t i = 0; i < count; ++i)
+			sum += IdType(random_engine) == my_id;
+		return sum;
+	});
+}
+
+} // namespace
+
+
+int main(int argc, char** argv)
+	/// Usage: id_benchmark [id_count] [rounds]
+{
+	std::size_t const count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+	std::size_t const rounds = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100;
+
+	std::default_random_engine random_engine;
+	std::vector<kd::id> ids;
+	std::vector<legacy_id> legacy_ids;
+	ids.reserve(count);
+	legacy_ids.reserve(count);
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		ids.emplace_back(random_engine);
+		legacy_ids.emplace_back(ids.back());
+	}
+
+	run("id", ids, rounds);
+	run("legacy_id", legacy_ids, rounds);
+
+	return 0;
+}
@@ -0,0 +1,176 @@
+//
+// ResponseRouterBenchmark.cpp
+//
+// Measures ResponseRouter registration/dispatch throughput with many
+// outstanding requests. The std::map of callbacks the router used
+// previously is measured as a baseline.
+//
+// Copyright (c) 2021, Aleph ONE Software Engineering and Contributors.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+#include "kademlia/ResponseRouter.h"
+#include "Poco/Net/SocketProactor.h"
+#include "Poco/Net/SocketAddress.h"
+#include "Poco/Mutex.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+namespace kd = kademlia::detail;
+using Poco::Net::SocketAddress;
+
+
+using clock_type = std::chrono::steady_clock;
+
+
+class map_response_callbacks final
+	/// The callbacks of the responses by token, as
+	/// the router kept them before its slab.
+{
+public:
+	using callback = std::function< void (SocketAddress const& sender, kd::Header const& h,
+		kd::buffer::const_iterator i, kd::buffer::const_iterator e) >;
+
+	void push_callback(kd::id const& message_id, callback const& on_message_received)
+	{
+		Poco::Mutex::ScopedLock l(_mutex);
+		callbacks_.emplace(message_id, on_message_received);
+	}
+
+	bool dispatch_response(SocketAddress const& sender, kd::Header const& h,
+		kd::buffer::const_iterator i, kd::buffer::const_iterator e)
+	{
+		Poco::Mutex::ScopedLock l(_mutex);
+		auto const c = callbacks_.find(h.random_token_);
+		if (c == callbacks_.end()) return false;
+
+		c->second(sender, h, i, e);
+		callbacks_.erase(c);
+		return true;
+	}
+
+private:
+	std::map<kd::id, callback> callbacks_;
+	Poco::Mutex _mutex;
+};
+
+
+double seconds_since(clock_type::time_point start)
+{
+	return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+
+void report(std::string const& name, std::size_t operations, double seconds)
+{
+	std::cout << name << ": " << operations << " ops in " << seconds << " s, "
+		<< static_cast<std::size_t>(operations / seconds) << " ops/s" << std::endl;
+}
+
+
+void run_router(std::size_t outstanding_count, std::size_t round_count)
+	/// Keeps outstanding_count requests pending, answering them
+	/// (in a shuffled order) and registering new ones round after round.
+{
+	Poco::Net::SocketProactor io_service;
+	kd::ResponseRouter router(io_service);
+	SocketAddress const sender;
+	kd::buffer const body;
+	std::size_t received = 0;
+	auto on_response = [&received](SocketAddress const&, kd::Header const&,
+		kd::buffer::const_iterator, kd::buffer::const_iterator) { ++received; };
+	auto on_error = [](std::error_code const&) {};
+
+	std::default_random_engine random_engine;
+	std::vector<kd::id> tokens(outstanding_count);
+
+	auto start = clock_type::now();
+	for (auto& t : tokens)
+		t = router.register_temporary_callback(std::chrono::hours(1), on_response, on_error);
+	report("ResponseRouter register", tokens.size(), seconds_since(start));
+
+	std::size_t operations = 0;
+	start = clock_type::now();
+	for (std::size_t r = 0; r < round_count; ++r)
+	{
+		std::shuffle(tokens.begin(), tokens.end(), random_engine);
+		for (auto& t : tokens)
+		{
+			router.handle_new_response(sender,
+				kd::Header{kd::Header::V1, kd::Header::PING_RESPONSE, kd::id{}, t},
+				body.begin(), body.end());
+			t = router.register_temporary_callback(std::chrono::hours(1), on_response, on_error);
+			operations += 2;
+		}
+	}
+	report("ResponseRouter dispatch + register", operations, seconds_since(start));
+	std::cout << "ResponseRouter received " << received << " responses, "
+		<< router.pending_count() << " pending" << std::endl;
+}
+
+
+void run_callbacks(std::size_t outstanding_count, std::size_t round_count)
+	/// Same workload, random tokens in a std::map.
+{
+	map_response_callbacks callbacks;
+	SocketAddress const sender;
+	kd::buffer const body;
+	std::size_t received = 0;
+	auto on_response = [&received](SocketAddress const&, kd::Header const&,
+		kd::buffer::const_iterator, kd::buffer::const_iterator) { ++received; };
+
+	std::default_random_engine random_engine;
+	std::vector<kd::id> tokens;
+	tokens.reserve(outstanding_count);
+
+	auto start = clock_type::now();
+	for (std::size_t i = 0; i < outstanding_count; ++i)
+	{
+		tokens.emplace_back(random_engine);
+		callbacks.push_callback(tokens.back(), on_response);
+	}
+	report("std::map register", tokens.size(), seconds_since(start));
+
+	std::size_t operations = 0;
+	start = clock_type::now();
+	for (std::size_t r = 0; r < round_count; ++r)
+	{
+		std::shuffle(tokens.begin(), tokens.end(), random_engine);
+		for (auto& t : tokens)
+		{
+			callbacks.dispatch_response(sender,
+				kd::Header{kd::Header::V1, kd::Header::PING_RESPONSE, kd::id{}, t},
+				body.begin(), body.end());
+			t = kd::id(random_engine);
+			callbacks.push_callback(t, on_response);
+			operations += 2;
+		}
+	}
+	report("std::map dispatch + register", operations, seconds_since(start));
+	std::cout << "std::map received " << received << " responses" << std::endl;
+}
+
+} // namespace
+
+
+int main(int argc, char** argv)
+	/// Usage: response_router_benchmark [outstanding_count] [round_count]
+{
+	std::size_t const outstanding_count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+	std::size_t const round_count = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 10;
+
+	run_router(outstanding_count, round_count);
+	run_callbacks(outstanding_count, round_count);
+
+	return 0;
+}
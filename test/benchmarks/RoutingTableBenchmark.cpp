@@ -0,0 +1,262 @@
+//
+// RoutingTableBenchmark.cpp
+//
+// Measures routing_table push/find throughput, including the
+// repeated pushes of a hot peer set. The list based
+// bucket storage the routing_table used previously is reproduced
+// here as a baseline.
+//
+// Copyright (c) 2021, Aleph ONE Software Engineering and Contributors.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+#include "kademlia/routing_table.hpp"
+#include "Poco/Net/SocketAddress.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <list>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+namespace kd = kademlia::detail;
+using Poco::Net::SocketAddress;
+
+class legacy_routing_table
+	/// std::list based k_buckets, as routing_table used to have.
+{
+public:
+	using value_type = std::pair<kd::id, SocketAddress>;
+	using k_bucket = std::list<value_type>;
+
+	legacy_routing_table(kd::id const& my_id, std::size_t k_bucket_size):
+		k_buckets_(kd::id::BIT_SIZE), my_id_(my_id),
+		k_bucket_size_(k_bucket_size), largest_k_bucket_index_(0)
+	{
+	}
+
+	bool push(kd::id const& peer_id, SocketAddress const& new_peer)
+	{
+		auto index = find_k_bucket_index(peer_id);
+		auto& bucket = k_buckets_[index];
+		if (bucket.size() == k_bucket_size_)
+		{
+			if (k_buckets_[largest_k_bucket_index_].size() <= k_bucket_size_)
+				largest_k_bucket_index_ = index;
+			if (index != largest_k_bucket_index_) return false;
+		}
+		if (peer_id == my_id_) return false;
+		for (auto const& e : bucket)
+			if (e.first == peer_id) return false;
+		auto ipIt = known_peers_.find(new_peer);
+		if (ipIt != known_peers_.end())
+		{
+			auto& b = k_buckets_[find_k_bucket_index(ipIt->second)];
+			b.remove_if([&new_peer](value_type const& e) { return e.second == new_peer; });
+		}
+		bucket.push_back(value_type{peer_id, new_peer});
+		known_peers_[new_peer] = peer_id;
+		return true;
+	}
+
+	std::size_t find(kd::id const& target, std::size_t count) const
+	{
+		std::size_t index = std::max(get_lowest_k_bucket_index(), find_k_bucket_index(target));
+		std::size_t visited = 0;
+		for (;;)
+		{
+			for (auto const& e : k_buckets_[index])
+			{
+				if (visited == count) return visited;
+				SocketAddress const peer(e.second);
+				visited += (peer.port() != 0);
+			}
+			if (index == 0) return visited;
+			--index;
+		}
+	}
+
+private:
+	std::size_t get_lowest_k_bucket_index() const
+	{
+		std::size_t i = 0, e = k_buckets_.size() - 1;
+		for (std::size_t peer_count = 0; i != e && peer_count <= k_bucket_size_; ++i)
+			peer_count += k_buckets_[i].size();
+		return i;
+	}
+
+	std::size_t find_k_bucket_index(kd::id const& id) const
+	{
+		std::size_t bit_index = 0;
+		while (bit_index < kd::id::BIT_SIZE - 1 && id[bit_index] == my_id_[bit_index])
+			++bit_index;
+		return bit_index;
+	}
+
+	std::vector<k_bucket> k_buckets_;
+	kd::id const my_id_;
+	std::size_t k_bucket_size_;
+	std::size_t largest_k_bucket_index_;
+	std::map<SocketAddress, kd::id> known_peers_;
+};
+
+
+using clock_type = std::chrono::steady_clock;
+
+
+double seconds_since(clock_type::time_point start)
+{
+	return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+
+void report(std::string const& name, std::size_t operations, double seconds)
+{
+	std::cout << name << ": " << operations << " ops in " << seconds << " s, "
+		<< static_cast<std::size_t>(operations / seconds) << " ops/s" << std::endl;
+}
+
+
+template<typename RoutingTable, typename FindFunction>
+void run(std::string const& name, RoutingTable& table,
+	std::vector<kd::id> const& ids, std::vector<SocketAddress> const& endpoints,
+	std::vector<kd::id> const& targets, FindFunction find)
+{
+	auto start = clock_type::now();
+	std::size_t pushed = 0;
+	for (std::size_t i = 0; i < ids.size(); ++i)
+		pushed += table.push(ids[i], endpoints[i]);
+	report(name + " push", ids.size(), seconds_since(start));
+	std::cout << name << " stored " << pushed << " peers" << std::endl;
+
+	start = clock_type::now();
+	std::size_t found = 0;
+	for (auto const& target : targets)
+		found += find(table, target);
+	report(name + " find", targets.size(), seconds_since(start));
+	std::cout << name << " visited " << found << " peers" << std::endl;
+}
+
+
+void run_hot_peers(std::string const& name, std::vector<kd::id> const& ids,
+	std::vector<SocketAddress> const& endpoints, kd::id const& my_id, std::size_t k,
+	std::size_t message_count, clock_type::duration message_interval)
+	/// Replays messages from the peers of a full table, as the
+	/// Engine pushes each message sender, message_interval apart.
+{
+	kd::routing_table<SocketAddress> table(my_id, k);
+	std::vector<kd::routing_table<SocketAddress>::value_type> hot_peers;
+	auto now = clock_type::now();
+	for (std::size_t i = 0; i < ids.size(); ++i)
+		if (table.push(ids[i], endpoints[i], now))
+			hot_peers.emplace_back(ids[i], endpoints[i]);
+
+	auto const start = clock_type::now();
+	std::size_t pushed = 0;
+	for (std::size_t i = 0; i < message_count; ++i)
+	{
+		auto const& p = hot_peers[(i * 7919) % hot_peers.size()];
+		now += message_interval;
+		pushed += table.push(p.first, p.second, now);
+	}
+	report(name, message_count, seconds_since(start));
+	std::cout << name << " " << hot_peers.size() << " hot peers, pushed "
+		<< pushed << " peers" << std::endl;
+}
+
+} // namespace
+
+
+int main(int argc, char** argv)
+	/// Usage: routing_table_benchmark [peer_count] [find_count]
+{
+	std::size_t const peer_count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+	std::size_t const find_count = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100000;
+	std::size_t const k = kd::routing_table<SocketAddress>::DEFAULT_K_BUCKET_SIZE;
+
+	std::default_random_engine random_engine;
+	kd::id const my_id(random_engine);
+
+	std::vector<kd::id> ids;
+	std::vector<SocketAddress> endpoints;
+	ids.reserve(peer_count);
+	endpoints.reserve(peer_count);
+	for (std::size_t i = 0; i < peer_count; ++i)
+	{
+		ids.emplace_back(random_engine);
+		std::string const host = "10." + std::to_string((i >> 16) & 0xff) + "."
+			+ std::to_string((i >> 8) & 0xff) + "." + std::to_string(i & 0xff);
+		endpoints.emplace_back(host, static_cast<std::uint16_t>(1024 + i % 50000));
+	}
+
+	std::vector<kd::id> targets;
+	targets.reserve(find_count);
+	for (std::size_t i = 0; i < find_count; ++i)
+		targets.emplace_back(random_engine);
+
+	{
+		kd::routing_table<SocketAddress> table(my_id, k);
+		run("routing_table", table, ids, endpoints, targets,
+			[k](kd::routing_table<SocketAddress>& t, kd::id const& target)
+			{
+				std::size_t visited = 0;
+				for (auto i = t.find(target), e = t.end(); i != e && visited < k; ++i)
+					visited += (i->second.port() != 0);
+				return visited;
+			});
+	}
+
+	{
+		using table_type = kd::routing_table<SocketAddress>;
+		std::vector<table_type::value_type> peers;
+		table_type table(my_id, k);
+		run("routing_table closest", table, ids, endpoints, targets,
+			[k, &peers](table_type& t, kd::id const& target)
+			{
+				peers.clear();
+				return t.closest(target, k, std::back_inserter(peers));
+			});
+	}
+
+	{
+		using table_type = kd::routing_table<SocketAddress, kd::split_k_buckets>;
+		std::vector<table_type::value_type> peers;
+		table_type table(my_id, k);
+		run("split routing_table closest", table, ids, endpoints, targets,
+			[k, &peers](table_type& t, kd::id const& target)
+			{
+				peers.clear();
+				return t.closest(target, k, std::back_inserter(peers));
+			});
+		std::cout << "split routing_table allocated " << table.k_bucket_count()
+			<< " k_buckets" << std::endl;
+	}
+
+	{
+		// 100k msgs/s from the peers of the table, then
+		// as many messages, each one refreshing its sender.
+		std::size_t const message_count = 1000000;
+		run_hot_peers("routing_table hot peers push", ids, endpoints, my_id, k,
+			message_count, std::chrono::microseconds(10));
+		run_hot_peers("routing_table hot peers push (no fast path)", ids, endpoints, my_id, k,
+			message_count, kd::RECENT_PEER_REFRESH_PERIOD);
+	}
+
+	{
+		legacy_routing_table table(my_id, k);
+		run("legacy_routing_table", table, ids, endpoints, targets,
+			[k](legacy_routing_table& t, kd::id const& target)
+			{
+				return t.find(target, k);
+			});
+	}
+
+	return 0;
+}
@@ -0,0 +1,144 @@
+//
+// TimerBenchmark.cpp
+//
+// Measures timer insert/cancel/expire throughput, the way
+// ResponseRouter arms a timeout per request and cancels it when
+// the response arrives. The std::multimap Timer used previously
+// is reproduced here as a baseline (without cancellation, answered
+// requests leave their timeout until it expires).
+//
+// Copyright (c) 2021, Aleph ONE Software Engineering and Contributors.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+#include "kademlia/timing_wheel.hpp"
+#include "kademlia/Timer.h"
+#include "Poco/Net/SocketProactor.h"
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+namespace kd = kademlia::detail;
+using tick_type = kd::timing_wheel::tick_type;
+
+
+using clock_type = std::chrono::steady_clock;
+
+
+double seconds_since(clock_type::time_point start)
+{
+	return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+
+void report(std::string const& name, std::size_t operations, double seconds)
+{
+	std::cout << name << ": " << operations << " ops in " << seconds << " s, "
+		<< static_cast<std::size_t>(operations / seconds) << " ops/s" << std::endl;
+}
+
+
+std::vector<tick_type> make_timeouts(std::size_t count)
+	/// Request timeouts between 20 ms and 2 s.
+{
+	std::default_random_engine random_engine;
+	std::uniform_int_distribution<tick_type> timeout(20, 2000);
+	std::vector<tick_type> timeouts(count);
+	for (auto& t : timeouts)
+		t = timeout(random_engine);
+	return timeouts;
+}
+
+
+void run_wheel(std::vector<tick_type> const& timeouts, std::size_t outstanding_count,
+	std::size_t answered_percent)
+	/// One request per tick: arms its timeout, and the request sent
+	/// outstanding_count requests ago is answered (its timeout
+	/// cancelled) answered_percent of the time. Expired timeouts fire.
+{
+	kd::timing_wheel wheel;
+	std::vector<kd::timing_wheel::handle> handles(outstanding_count);
+	std::size_t expired = 0;
+	auto on_expired = [&expired](kd::timing_wheel::callback& c) { c(); };
+
+	auto const start = clock_type::now();
+	for (std::size_t i = 0; i < timeouts.size(); ++i)
+	{
+		auto& h = handles[i % outstanding_count];
+		if (i % 100 < answered_percent) wheel.cancel(h);
+		h = wheel.insert(i + timeouts[i], [&expired] { ++expired; });
+		wheel.advance(i, on_expired);
+	}
+	report("timing_wheel " + std::to_string(answered_percent) + "% answered",
+		2 * timeouts.size(), seconds_since(start));
+	std::cout << "timing_wheel " << expired << " expired, "
+		<< wheel.size() << " pending" << std::endl;
+}
+
+
+void run_multimap(std::vector<tick_type> const& timeouts)
+	/// Same workload, nothing is cancelled.
+{
+	std::multimap<tick_type, std::function<void ()>> multimap;
+	std::size_t expired = 0;
+
+	auto const start = clock_type::now();
+	for (std::size_t i = 0; i < timeouts.size(); ++i)
+	{
+		multimap.emplace(i + timeouts[i], [&expired] { ++expired; });
+		auto const end = multimap.upper_bound(i);
+		for (auto j = multimap.begin(); j != end; ++j)
+			j->second();
+		multimap.erase(multimap.begin(), end);
+	}
+	report("multimap", 2 * timeouts.size(), seconds_since(start));
+	std::cout << "multimap " << expired << " expired, "
+		<< multimap.size() << " pending" << std::endl;
+}
+
+
+void run_timer(std::size_t count)
+	/// Timer::expires_from_now() then cancel(), as ResponseRouter does
+	/// for answered requests.
+{
+	Poco::Net::SocketProactor io_service;
+	kd::Timer timer(io_service);
+	std::size_t expired = 0;
+
+	auto const start = clock_type::now();
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		auto const h = timer.expires_from_now(std::chrono::seconds(2), [&expired] { ++expired; });
+		timer.cancel(h);
+	}
+	report("Timer expires_from_now + cancel", 2 * count, seconds_since(start));
+	std::cout << "Timer " << timer.pending_count() << " pending" << std::endl;
+}
+
+} // namespace
+
+
+int main(int argc, char** argv)
+	/// Usage: timer_benchmark [operation_count] [outstanding_count]
+{
+	// 1M requests (a request per ms, answered after 10 ms).
+	std::size_t const count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+	std::size_t const outstanding_count = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 10;
+
+	auto const timeouts = make_timeouts(count);
+	run_wheel(timeouts, outstanding_count, 100);
+	run_wheel(timeouts, outstanding_count, 90);
+	run_wheel(timeouts, outstanding_count, 0);
+	run_multimap(timeouts);
+	run_timer(count);
+
+	return 0;
+}
@@ -0,0 +1,151 @@
+// Copyright (c) 2021, Aleph ONE Software Engineering and Contributors.
+//
+// SPDX-License-Identifier:	BSL-1.0
+
+
+#ifdef __linux__
+
+#include "Poco/Net/DatagramSocket.h"
+#include "kademlia/BatchedSocketAdapter.h"
+#include "kademlia/log.hpp"
+#include "kademlia/detail/Util.h"
+#include "gtest/gtest.h"
+#include "TaskFixture.h"
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace kademlia::detail;
+using namespace kademlia::test;
+using namespace Poco::Net;
+
+struct BatchedSocketAdapterTest : TaskFixture
+{
+    BatchedSocketAdapterTest(): TaskFixture()
+    {
+        LOG_DEBUG(BatchedSocketAdapterTest, this) << "Created BatchedSocketAdapterTest." << std::endl;
+    }
+};
+
+
+TEST_F(BatchedSocketAdapterTest, copy_and_move)
+{
+    std::uint16_t port = getAvailablePort(SocketAddress::IPv4);
+    SocketAddress addr("127.0.0.1", port);
+    Poco::Net::SocketProactor ioService;
+    BatchedSocketAdapter<DatagramSocket> sock1(&ioService, addr, false, true);
+    BatchedSocketAdapter<DatagramSocket> sock2(sock1);
+    EXPECT_EQ(sock1.address(), sock2.address());
+    BatchedSocketAdapter<DatagramSocket> sock3(std::move(sock1));
+    EXPECT_EQ(sock2.address(), sock3.address());
+}
+
+
+TEST_F(BatchedSocketAdapterTest, receives_a_batch_of_datagrams_in_order)
+{
+    Poco::Net::SocketProactor ioService;
+
+    std::uint16_t port1 = getAvailablePort(SocketAddress::IPv4);
+    std::uint16_t port2 = getAvailablePort(SocketAddress::IPv4, port1+1);
+    SocketAddress addr1("127.0.0.1", port1);
+    SocketAddress addr2("127.0.0.1", port2);
+
+    BatchedSocketAdapter<DatagramSocket> sock1(&ioService, addr1, false, true);
+    BatchedSocketAdapter<DatagramSocket> sock2(&ioService, addr2, false, true);
+
+    // More datagrams than a single recvmmsg() call receives.
+    std::size_t const count = 3 * SOCKET_BATCH_SIZE / 2;
+    std::size_t sent = 0;
+    for (std::size_t i = 0; i != count; ++i)
+    {
+        auto const text = "hello " + std::to_string(i);
+        sock1.asyncSendTo(buffer(text.begin(), text.end()), addr2,
+            [&](std::error_code const& failure, std::size_t bytes_sent)
+            {
+                EXPECT_FALSE(failure);
+                if (bytes_sent) ++sent;
+            });
+    }
+
+    std::vector<std::string> received;
+    buffer recvBuf;
+    SocketAddress sender;
+    std::function<void (std::error_code const&, std::size_t)> onRecvCompletion;
+    onRecvCompletion = [&](std::error_code const& failure, std::size_t bytes_received)
+    {
+        EXPECT_FALSE(failure);
+        received.emplace_back(recvBuf.begin(), recvBuf.begin() + bytes_received);
+        EXPECT_EQ(addr1, sender);
+        if (received.size() < count)
+            sock2.asyncReceiveFrom(recvBuf, sender, BatchedSocketAdapter<DatagramSocket>::Callback(onRecvCompletion));
+    };
+    sock2.asyncReceiveFrom(recvBuf, sender, BatchedSocketAdapter<DatagramSocket>::Callback(onRecvCompletion));
+
+    while (received.size() < count)
+        ioService.poll();
+
+    EXPECT_EQ(count, sent);
+    for (std::size_t i = 0; i != count; ++i)
+        EXPECT_EQ("hello " + std::to_string(i), received[i]);
+}
+
+
+
+TEST_F(BatchedSocketAdapterTest, sends_do_not_overwrite_the_received_batch)
+{
+    Poco::Net::SocketProactor ioService;
+
+    std::uint16_t port1 = getAvailablePort(SocketAddress::IPv4);
+    std::uint16_t port2 = getAvailablePort(SocketAddress::IPv4, port1+1);
+    SocketAddress addr1("127.0.0.1", port1);
+    SocketAddress addr2("127.0.0.1", port2);
+
+    BatchedSocketAdapter<DatagramSocket> sock1(&ioService, addr1, false, true);
+    BatchedSocketAdapter<DatagramSocket> sock2(&ioService, addr2, false, true);
+
+    std::size_t const count = SOCKET_BATCH_SIZE;
+    for (std::size_t i = 0; i != count; ++i)
+    {
+        auto const text = "hello " + std::to_string(i);
+        sock1.asyncSendTo(buffer(text.begin(), text.end()), addr2,
+            [](std::error_code const& failure, std::size_t) { EXPECT_FALSE(failure); });
+    }
+
+    // Each datagram is answered with several replies, flushed
+    // before the next receive operation gets the next datagram.
+    std::vector<std::string> received;
+    buffer recvBuf;
+    SocketAddress sender;
+    std::function<void (std::error_code const&, std::size_t)> onRecvCompletion;
+    onRecvCompletion = [&](std::error_code const& failure, std::size_t bytes_received)
+    {
+        EXPECT_FALSE(failure);
+        received.emplace_back(recvBuf.begin(), recvBuf.begin() + bytes_received);
+        EXPECT_EQ(addr1, sender);
+        auto const reply = "a longer reply to " + received.back();
+        for (int i = 0; i != 4; ++i)
+        {
+            sock2.asyncSendTo(buffer(reply.begin(), reply.end()), addr1,
+                [](std::error_code const& failure, std::size_t) { EXPECT_FALSE(failure); });
+        }
+        if (received.size() < count)
+        {
+            ioService.addWork([&]
+            {
+                sock2.asyncReceiveFrom(recvBuf, sender, BatchedSocketAdapter<DatagramSocket>::Callback(onRecvCompletion));
+            }, 0);
+        }
+    };
+    sock2.asyncReceiveFrom(recvBuf, sender, BatchedSocketAdapter<DatagramSocket>::Callback(onRecvCompletion));
+
+    while (received.size() < count)
+        ioService.poll();
+
+    for (std::size_t i = 0; i != count; ++i)
+        EXPECT_EQ("hello " + std::to_string(i), received[i]);
+}
+
+}
+
+#endif // __linux__
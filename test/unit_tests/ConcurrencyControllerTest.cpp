@@ -0,0 +1,65 @@
+// Copyright (c) 2021, Aleph ONE Software Engineering and Contributors.
+//
+// SPDX-License-Identifier:	BSL-1.0
+
+
+#include "common.hpp"
+#include "kademlia/concurrency_controller.hpp"
+#include "gtest/gtest.h"
+#include <chrono>
+
+
+namespace {
+
+namespace kd = kademlia::detail;
+using std::chrono::milliseconds;
+
+
+TEST(ConcurrencyControllerTest, timeouts_raise_concurrency_up_to_max)
+{
+    kd::concurrency_controller c(3, 1, 5, milliseconds(50));
+    EXPECT_EQ(3U, c.value());
+
+    c.on_timeout();
+    EXPECT_EQ(4U, c.value());
+    c.on_timeout();
+    c.on_timeout();
+    EXPECT_EQ(5U, c.value());
+    EXPECT_EQ(5U, c.highest());
+}
+
+TEST(ConcurrencyControllerTest, fast_responses_in_a_row_lower_concurrency_down_to_min)
+{
+    kd::concurrency_controller c(3, 2, 5, milliseconds(50));
+
+    // A slow response restarts the count.
+    c.on_response(milliseconds(10));
+    c.on_response(milliseconds(10));
+    c.on_response(milliseconds(100));
+    c.on_response(milliseconds(10));
+    c.on_response(milliseconds(10));
+    EXPECT_EQ(3U, c.value());
+    c.on_response(milliseconds(10));
+    EXPECT_EQ(2U, c.value());
+
+    for (int i = 0; i != 10; ++i)
+        c.on_response(milliseconds(10));
+    EXPECT_EQ(2U, c.value());
+    EXPECT_EQ(3U, c.highest());
+}
+
+TEST(ConcurrencyControllerTest, equal_bounds_fix_concurrency)
+{
+    kd::concurrency_controller c(3, 3, 3, milliseconds(50));
+    c.on_timeout();
+    EXPECT_EQ(3U, c.value());
+    for (int i = 0; i != 10; ++i)
+        c.on_response(milliseconds(10));
+    EXPECT_EQ(3U, c.value());
+
+    // The initial value is brought within the bounds.
+    EXPECT_EQ(4U, kd::concurrency_controller(8, 1, 4, milliseconds(50)).value());
+    EXPECT_EQ(1U, kd::concurrency_controller(0, 0, 0, milliseconds(50)).value());
+}
+
+}
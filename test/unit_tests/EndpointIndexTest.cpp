@@ -0,0 +1,94 @@
+// Copyright (c) 2021, Aleph ONE Software Engineering and Contributors.
+//
+// SPDX-License-Identifier:	BSL-1.0
+
+
+#include "common.hpp"
+#include "PeerFactory.h"
+#include "kademlia/endpoint_index.hpp"
+#include "gtest/gtest.h"
+#include <map>
+#include <random>
+#include <string>
+
+
+namespace {
+
+namespace kd = kademlia::detail;
+
+
+kd::packed_endpoint createPackedEndpoint(std::size_t i)
+{
+    return kd::packed_endpoint(createEndpoint("10.0." + std::to_string(i / 256 % 256)
+        + "." + std::to_string(i % 256), std::uint16_t(1000 + i / 65536)));
+}
+
+
+TEST(EndpointIndexTest, is_empty_on_construction)
+{
+    kd::endpoint_index index;
+    EXPECT_TRUE(index.empty());
+    EXPECT_EQ(nullptr, index.find(createPackedEndpoint(1)));
+}
+
+TEST(EndpointIndexTest, can_insert_find_and_erase)
+{
+    kd::endpoint_index index;
+    auto const endpoint = createPackedEndpoint(1);
+
+    index.insert(endpoint, kd::id{ "1" });
+    ASSERT_NE(nullptr, index.find(endpoint));
+    EXPECT_EQ(kd::id{ "1" }, *index.find(endpoint));
+    EXPECT_EQ(nullptr, index.find(createPackedEndpoint(2)));
+
+    // Port and family are part of the key.
+    EXPECT_EQ(nullptr, index.find(kd::packed_endpoint(createEndpoint("10.0.0.1", 1001))));
+    EXPECT_EQ(nullptr, index.find(kd::packed_endpoint(createEndpoint("::ffff:10.0.0.1", 1000))));
+
+    index.insert(endpoint, kd::id{ "2" });
+    EXPECT_EQ(1U, index.size());
+    EXPECT_EQ(kd::id{ "2" }, *index.find(endpoint));
+
+    EXPECT_TRUE(index.erase(endpoint));
+    EXPECT_FALSE(index.erase(endpoint));
+    EXPECT_EQ(nullptr, index.find(endpoint));
+    EXPECT_TRUE(index.empty());
+}
+
+TEST(EndpointIndexTest, matches_a_map_under_random_operations)
+{
+    std::default_random_engine random_engine;
+    std::uniform_int_distribution<std::size_t> pick(0, 2000);
+    kd::endpoint_index index;
+    std::map<std::size_t, kd::id> expected;
+
+    for (int round = 0; round < 20000; ++round)
+    {
+        std::size_t const key = pick(random_engine);
+        auto const endpoint = createPackedEndpoint(key);
+        if (random_engine() % 3)
+        {
+            kd::id const value{ random_engine };
+            index.insert(endpoint, value);
+            expected[key] = value;
+        }
+        else
+            EXPECT_EQ(expected.erase(key) == 1, index.erase(endpoint));
+    }
+
+    EXPECT_EQ(expected.size(), index.size());
+    for (std::size_t key = 0; key <= 2000; ++key)
+    {
+        auto const found = index.find(createPackedEndpoint(key));
+        auto const i = expected.find(key);
+        if (i == expected.end())
+            EXPECT_EQ(nullptr, found);
+        else
+        {
+            ASSERT_NE(nullptr, found);
+            EXPECT_EQ(i->second, *found);
+        }
+    }
+}
+
+}
@@ -23,7 +23,12 @@
 // (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
 // SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <map>
 #include <memory>
+#include <set>
 #include "Poco/Thread.h"
 #include "Poco/Net/SocketProactor.h"
 #include "TestEngine.h"
@@ -58,6 +63,150 @@ create_test_engine(SocketProactor& io_service
 }
 
 
+std::unique_ptr< t::TestEngine >
+create_test_engine_from_file(SocketProactor& io_service
+							, k::endpoint const& initial_peer
+							, std::string const& routing_table_path)
+{
+	k::endpoint ipv4_endpoint{ "127.0.0.1", Session::DEFAULT_PORT };
+	k::endpoint ipv6_endpoint{ "::1", Session::DEFAULT_PORT };
+
+	return std::unique_ptr< t::TestEngine >{ new t::TestEngine{ io_service
+		, initial_peer, ipv4_endpoint, ipv6_endpoint, routing_table_path } };
+}
+
+bool file_exists(std::string const& path)
+{
+	return bool(std::ifstream(path));
+}
+
+void write_file(std::string const& path, d::buffer const& b)
+{
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	out.write(reinterpret_cast<char const*>(b.data()), b.size());
+}
+
+d::RoutingTableSnapshot make_snapshot(std::chrono::milliseconds age)
+	/// Returns a snapshot of a single peer taken age ago.
+{
+	auto const now = std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::system_clock::now().time_since_epoch()) - age;
+
+	d::RoutingTableSnapshot snapshot;
+	snapshot.id_ = d::id{ "1111111111111111111111111111111111111111" };
+	snapshot.time_ = std::uint64_t(now.count());
+	snapshot.peers_.push_back(d::RoutingTableSnapshotEntry{
+		d::Peer{ d::id{ "2222222222222222222222222222222222222222" }
+			, Poco::Net::SocketAddress("10.255.0.1", Session::DEFAULT_PORT) }
+		, snapshot.time_, 10 });
+	return snapshot;
+}
+
+void expect_bootstrapped(SocketProactor& io_service, std::string const& routing_table_path)
+	/// Checks that an engine ignores the routing table
+	/// file and bootstraps from its initial peer.
+{
+	d::id const id1{ "8000000000000000000000000000000000000000" };
+	auto e1 = create_test_engine(io_service, id1);
+
+	auto e2 = create_test_engine_from_file(io_service, e1->ipv4(), routing_table_path);
+	EXPECT_TRUE(e2->initialized());
+
+	auto const snapshot = e2->routing_table_snapshot();
+	EXPECT_NE(make_snapshot(std::chrono::milliseconds(0)).id_, snapshot.id_);
+	ASSERT_EQ(1U, snapshot.peers_.size());
+	EXPECT_EQ(id1, snapshot.peers_.front().peer_.id_);
+}
+
+std::string key_at_distance(d::id const& id, std::size_t common_prefix_size)
+	/// Returns a key whose id shares common_prefix_size bits with id.
+{
+	for (std::size_t n = 0; ; ++n)
+	{
+		auto const key = "key" + std::to_string(n);
+		d::id const key_id{ d::id::value_to_hash_type(key.begin(), key.end()) };
+		if (distance(id, key_id).count_leading_zeros() == common_prefix_size)
+			return key;
+	}
+}
+
+bool parse_fragment(t::FakeSocket::packet const& p, d::Header& h, d::FragmentBody& f)
+	/// Returns false if p isn't a fragment.
+{
+	auto i = p.data_.cbegin(), e = p.data_.cend();
+	return !deserialize(i, e, h) && h.type_ == d::Header::FRAGMENT && !deserialize(i, e, f);
+}
+
+struct fragments_count final
+{
+	std::size_t fragments_ = 0;
+	std::size_t transmissions_ = 0;
+};
+
+fragments_count count_fragments()
+	/// Pops the logged packets, counting the fragments of the
+	/// transfers and how many times they were sent.
+{
+	std::map<d::id, std::set<std::uint32_t>> transfers;
+	fragments_count count;
+	for (auto& packets = t::FakeSocket::get_logged_packets(); !packets.empty(); packets.pop())
+	{
+		d::Header h;
+		d::FragmentBody f;
+		if (!parse_fragment(packets.front(), h, f))
+			continue;
+		transfers[h.random_token_].insert(f.index_);
+		++count.transmissions_;
+	}
+	for (auto const& t : transfers)
+		count.fragments_ += t.second.size();
+	return count;
+}
+
+fragments_count save_and_load_large_value(SocketProactor& io_service)
+	/// Saves a value too large for a datagram and loads it from
+	/// another engine, either stored there or answered by the first.
+{
+	d::id const id1{ "8000000000000000000000000000000000000000" };
+	auto e1 = create_test_engine(io_service, id1);
+
+	d::id const id2{ "4000000000000000000000000000000000000000" };
+	auto e2 = create_test_engine(io_service, id2, e1->ipv4());
+
+	io_service.poll();
+	t::clear_packets();
+
+	std::string expected_data(2 * d::MAX_DATAGRAM_MESSAGE_SIZE, 'x');
+	for (std::size_t i = 0; i != expected_data.size(); ++i)
+		expected_data[i] = char(i * 7);
+
+	bool saved = false;
+	auto on_save = [ &saved ](std::error_code const& failure)
+	{
+		if (failure) throw std::system_error{ failure };
+		saved = true;
+	};
+	e1->asyncSave("key", std::string(expected_data), on_save);
+	while (!saved)
+		io_service.poll();
+
+	bool loaded = false;
+	auto on_load = [ &expected_data, &loaded ](std::error_code const& failure, std::string const& actual_data)
+	{
+		if (failure) throw std::system_error{ failure };
+		if (expected_data != actual_data)
+			throw std::runtime_error{ "Unexpected data" };
+		loaded = true;
+	};
+	e2->asyncLoad("key", on_load);
+
+	auto const deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	while (!loaded && std::chrono::steady_clock::now() < deadline)
+		io_service.poll();
+	EXPECT_TRUE(loaded);
+	return count_fragments();
+}
+
 TEST(EngineTest, isolated_engine_cannot_be_constructed)
 {
 	Poco::Net::SocketProactor io_service;
@@ -110,4 +259,301 @@ TEST(EngineTest, two_engines_can_save_and_load)
 	e2->asyncLoad("key", on_load);
 }
 
+TEST(EngineTest, one_hop_engines_know_each_other_and_can_save_and_load)
+{
+	Poco::Net::SocketProactor io_service;
+
+	d::id const id1{ "8000000000000000000000000000000000000000" };
+	auto e1 = create_test_engine(io_service, id1);
+
+	d::id const id2{ "4000000000000000000000000000000000000000" };
+	auto e2 = create_test_engine(io_service, id2, e1->ipv4());
+
+	io_service.poll();
+
+	// Members are seeded from the routing table.
+	e1->enable_one_hop_routing();
+	e2->enable_one_hop_routing();
+	EXPECT_EQ(1U, e1->members_count());
+	EXPECT_EQ(1U, e2->members_count());
+	EXPECT_FALSE(e1->has_fresh_membership_view());
+
+	// The view is fresh once a digest has been exchanged.
+	auto const deadline = std::chrono::steady_clock::now() + 2 * d::MEMBERSHIP_DIGEST_PERIOD;
+	while (!(e1->has_fresh_membership_view() && e2->has_fresh_membership_view())
+		&& std::chrono::steady_clock::now() < deadline)
+		io_service.poll();
+	ASSERT_TRUE(e1->has_fresh_membership_view());
+	ASSERT_TRUE(e2->has_fresh_membership_view());
+	t::clear_packets();
+
+	std::string const expected_data{ "data" };
+
+	auto on_save = [](std::error_code const& failure)
+	{ if (failure) throw std::system_error{ failure }; };
+	e1->asyncSave("key", std::string(expected_data), on_save);
+
+	// Neither the save nor the load look peers up, the value is
+	// stored to and asked from the member directly.
+	bool loaded = false;
+	auto on_load = [ &expected_data, &loaded ](std::error_code const& failure, std::string const& actual_data)
+	{
+		if (failure) throw std::system_error{ failure };
+		if (expected_data != actual_data)
+			throw std::runtime_error{ "Unexpected data" };
+		loaded = true;
+	};
+	e2->asyncLoad("key", on_load);
+
+	for (int i = 0; i != 10 && !loaded; ++i)
+		io_service.poll();
+	EXPECT_TRUE(loaded);
+
+	std::size_t store_requests_count = 0, find_value_requests_count = 0;
+	while (t::count_packets() > 0)
+	{
+		auto const p = t::pop_packet();
+		EXPECT_NE(d::Header::FIND_PEER_REQUEST, p.type());
+		if (p.type() == d::Header::STORE_REQUEST)
+		{
+			EXPECT_EQ(e1->ipv4(), p.from());
+			EXPECT_EQ(e2->ipv4(), p.to());
+			++store_requests_count;
+		}
+		else if (p.type() == d::Header::FIND_VALUE_REQUEST)
+		{
+			EXPECT_EQ(e2->ipv4(), p.from());
+			EXPECT_EQ(e1->ipv4(), p.to());
+			++find_value_requests_count;
+		}
+	}
+	EXPECT_EQ(1U, store_requests_count);
+	EXPECT_EQ(1U, find_value_requests_count);
+}
+
+TEST(EngineTest, concurrent_loads_of_a_key_share_a_single_lookup)
+{
+	Poco::Net::SocketProactor io_service;
+
+	d::id const id1{ "8000000000000000000000000000000000000000" };
+	auto e1 = create_test_engine(io_service, id1);
+
+	d::id const id2{ "4000000000000000000000000000000000000000" };
+	auto e2 = create_test_engine(io_service, id2, e1->ipv4());
+
+	io_service.poll();
+	t::clear_packets();
+
+	std::size_t loads_count = 0;
+	auto on_load = [ &loads_count ](std::error_code const&, std::string const&)
+	{ ++loads_count; };
+	e2->asyncLoad("key", on_load);
+	e2->asyncLoad("key", on_load);
+	EXPECT_EQ(1U, e2->pending_loads_count());
+
+	io_service.poll();
+
+	std::size_t requests_count = 0;
+	while (t::count_packets() > 0)
+	{
+		if (t::pop_packet().type() == d::Header::FIND_VALUE_REQUEST)
+			++requests_count;
+	}
+	EXPECT_EQ(1U, requests_count);
+	// Both callers are notified at once.
+	EXPECT_TRUE(loads_count == 0 || loads_count == 2);
+}
+
+TEST(EngineTest, values_larger_than_a_datagram_are_sent_in_fragments)
+{
+	Poco::Net::SocketProactor io_service;
+
+	auto const count = save_and_load_large_value(io_service);
+
+	EXPECT_LT(2 * d::MAX_DATAGRAM_MESSAGE_SIZE / d::MAX_FRAGMENT_SIZE, count.fragments_);
+	EXPECT_EQ(count.fragments_, count.transmissions_);
+}
+
+TEST(EngineTest, only_lost_fragments_are_sent_again)
+{
+	Poco::Net::SocketProactor io_service;
+
+	// The first transmission of every tenth fragment is lost.
+	std::set<std::pair<d::id, std::uint32_t>> lost;
+	t::FakeSocket::get_packet_filter() = [ &lost ](t::FakeSocket::packet const& p)
+	{
+		d::Header h;
+		d::FragmentBody f;
+		return !parse_fragment(p, h, f) || f.index_ % 10 != 5
+			|| !lost.emplace(h.random_token_, f.index_).second;
+	};
+
+	auto const count = save_and_load_large_value(io_service);
+	t::FakeSocket::get_packet_filter() = nullptr;
+
+	EXPECT_LT(0U, lost.size());
+	EXPECT_LE(count.fragments_ + lost.size(), count.transmissions_);
+	EXPECT_GT(count.fragments_ + 2 * lost.size(), count.transmissions_);
+}
+
+TEST(EngineTest, routing_table_is_restored_from_its_file)
+{
+	Poco::Net::SocketProactor io_service;
+	std::string const path{ "EngineTest_restored_routing_table" };
+	std::remove(path.c_str());
+
+	d::id const id1{ "8000000000000000000000000000000000000000" };
+	auto e1 = create_test_engine(io_service, id1);
+
+	auto e2 = create_test_engine_from_file(io_service, e1->ipv4(), path);
+	EXPECT_TRUE(e2->save_routing_table());
+	EXPECT_TRUE(file_exists(path));
+	EXPECT_FALSE(file_exists(path + ".tmp"));
+	auto const saved = e2->routing_table_snapshot();
+	ASSERT_EQ(1U, saved.peers_.size());
+	e2.reset();
+
+	// The restored engine doesn't wait for its initial peer.
+	auto e3 = create_test_engine_from_file(io_service, e1->ipv4(), path);
+	EXPECT_TRUE(e3->initialized());
+
+	auto const restored = e3->routing_table_snapshot();
+	EXPECT_EQ(saved.id_, restored.id_);
+	ASSERT_EQ(saved.peers_.size(), restored.peers_.size());
+	for (std::size_t i = 0; i != saved.peers_.size(); ++i)
+	{
+		EXPECT_EQ(saved.peers_[i].peer_.id_, restored.peers_[i].peer_.id_);
+		EXPECT_EQ(saved.peers_[i].peer_.endpoint_, restored.peers_[i].peer_.endpoint_);
+	}
+
+	e3.reset();
+	EXPECT_FALSE(file_exists(path + ".tmp"));
+	std::remove(path.c_str());
+}
+
+TEST(EngineTest, missing_routing_table_file_falls_back_to_bootstrap)
+{
+	Poco::Net::SocketProactor io_service;
+	std::string const path{ "EngineTest_missing_routing_table" };
+	std::remove(path.c_str());
+
+	expect_bootstrapped(io_service, path);
+	std::remove(path.c_str());
+}
+
+TEST(EngineTest, corrupted_routing_table_file_falls_back_to_bootstrap)
+{
+	Poco::Net::SocketProactor io_service;
+	std::string const path{ "EngineTest_corrupted_routing_table" };
+
+	d::buffer b;
+	serialize(make_snapshot(std::chrono::milliseconds(0)), b);
+	b.resize(b.size() / 2);
+	write_file(path, b);
+
+	expect_bootstrapped(io_service, path);
+	std::remove(path.c_str());
+}
+
+TEST(EngineTest, outdated_routing_table_file_falls_back_to_bootstrap)
+{
+	Poco::Net::SocketProactor io_service;
+	std::string const path{ "EngineTest_outdated_routing_table" };
+
+	d::id const id1{ "8000000000000000000000000000000000000000" };
+	auto e1 = create_test_engine(io_service, id1);
+
+	// A snapshot about to expire is still restored.
+	d::buffer b;
+	serialize(make_snapshot(d::ROUTING_TABLE_SNAPSHOT_MAX_AGE - std::chrono::minutes(1)), b);
+	write_file(path, b);
+	auto e2 = create_test_engine_from_file(io_service, e1->ipv4(), path);
+	EXPECT_EQ(make_snapshot(std::chrono::milliseconds(0)).id_, e2->routing_table_snapshot().id_);
+
+	b.clear();
+	serialize(make_snapshot(d::ROUTING_TABLE_SNAPSHOT_MAX_AGE + std::chrono::minutes(1)), b);
+	write_file(path, b);
+
+	expect_bootstrapped(io_service, path);
+
+	// e2 saves its routing table on destruction.
+	e2.reset();
+	std::remove(path.c_str());
+}
+
+TEST(EngineTest, k_bucket_refreshes_are_capped_and_dropped_once_looked_up)
+{
+	Poco::Net::SocketProactor io_service;
+
+	d::id const id1{ "8000000000000000000000000000000000000000" };
+	auto e1 = create_test_engine(io_service, id1);
+
+	// With single peer buckets, every known peer gets its own bucket,
+	// hence its own refresh.
+	d::lookup_config config;
+	config.bucket_size_ = 1;
+	d::id const id2{ "4000000000000000000000000000000000000000" };
+	std::unique_ptr< t::TestEngine > e2{ new t::TestEngine{ io_service, e1->ipv4()
+		, k::endpoint{ "127.0.0.1", Session::DEFAULT_PORT }, k::endpoint{ "::1", Session::DEFAULT_PORT }
+		, id2, config } };
+
+	// Peers sharing 1, 2 and 3 bits with e2, e1 sharing none.
+	std::vector<d::id> const peer_ids{ d::id{ "0000000000000000000000000000000000000001" }
+		, d::id{ "6000000000000000000000000000000000000000" }
+		, d::id{ "5000000000000000000000000000000000000000" } };
+	Poco::Net::SocketAddress const e2_address{ e2->ipv4().address(), Session::DEFAULT_PORT };
+	std::vector<std::unique_ptr<t::FakeSocket>> peers;
+	std::vector<d::buffer> pings;
+	for (auto const& peer_id : peer_ids)
+	{
+		peers.emplace_back(new t::FakeSocket{ &io_service
+			, Poco::Net::SocketAddress("127.0.0.1", t::FakeSocket::FIXED_PORT) });
+		pings.push_back(d::MessageSerializer(peer_id).serialize(d::Header::PING_REQUEST, d::id{}));
+		peers.back()->asyncSendTo(pings.back(), e2_address, [](std::error_code const&, std::size_t) {});
+	}
+	for (int i = 0; i != 10; ++i)
+		io_service.poll();
+
+	// The buckets of the 4 peers and the empty closest one are due.
+	e2->refresh_idle_k_buckets(std::chrono::milliseconds(0));
+	auto const pending_count = 5U - d::MAX_CONCURRENT_K_BUCKET_REFRESH_COUNT;
+	EXPECT_EQ(d::MAX_CONCURRENT_K_BUCKET_REFRESH_COUNT, e2->k_bucket_refreshes_count());
+	EXPECT_EQ(pending_count, e2->pending_k_bucket_refreshes_count());
+
+	// The farthest buckets are refreshed last, loads look them up meanwhile.
+	auto on_load = [](std::error_code const&, std::string const&) {};
+	for (std::size_t common_prefix_size = 0; common_prefix_size != 3; ++common_prefix_size)
+		e2->asyncLoad(key_at_distance(id2, common_prefix_size), on_load);
+
+	auto const deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+	while (e2->k_bucket_refreshes_count() == d::MAX_CONCURRENT_K_BUCKET_REFRESH_COUNT
+		&& e2->pending_k_bucket_refreshes_count() == pending_count
+		&& std::chrono::steady_clock::now() < deadline)
+		io_service.poll();
+
+	// The first completed refresh dropped the queued ones rather
+	// than starting them.
+	EXPECT_GT(d::MAX_CONCURRENT_K_BUCKET_REFRESH_COUNT, e2->k_bucket_refreshes_count());
+	EXPECT_EQ(0U, e2->pending_k_bucket_refreshes_count());
+}
+
+TEST(EngineTest, idle_k_bucket_checks_are_jittered)
+{
+	Poco::Net::SocketProactor io_service;
+
+	auto const period = d::K_BUCKET_REFRESH_CHECK_PERIOD;
+	std::set<std::chrono::milliseconds::rep> delays;
+	std::vector<std::unique_ptr< t::TestEngine >> engines;
+	for (int i = 0; i != 8; ++i)
+	{
+		engines.push_back(create_test_engine(io_service, d::id{}));
+		auto const delay = engines.back()->k_bucket_refresh_check_delay();
+		EXPECT_LE(period - period / 4, delay);
+		EXPECT_GE(period + period / 4, delay);
+		delays.insert(delay.count());
+	}
+	// Engines started together don't check in sync.
+	EXPECT_LT(1U, delays.size());
+}
+
 }
@@ -28,6 +28,8 @@
 #include "Poco/Net/SocketAddress.h"
 #include "kademlia/FindValueTask.h"
 #include "gtest/gtest.h"
+#include <functional>
+#include <memory>
 #include <vector>
 
 namespace {
@@ -98,11 +100,35 @@ TEST_F(FindValueTaskTest, can_notify_error_when_unique_peer_fails_to_respond)
     // Task didn't send any more message.
     EXPECT_TRUE(! tracker_.has_sent_message());
 
+    // Task reported p1 timeout to the routing table.
+    ASSERT_FALSE(routing_table_.unresponsive_ids_.empty());
+    EXPECT_EQ(p1.id_, routing_table_.unresponsive_ids_.back());
+
     // Task notified the error.
     EXPECT_EQ(1, callback_call_count_);
     EXPECT_TRUE(failure_ == k::VALUE_NOT_FOUND);
 }
 
+TEST_F(FindValueTaskTest, tries_unresponsive_peers_again_without_tracker_retransmissions)
+{
+    kd::id const searched_key{ "a" };
+    routing_table_.expected_ids_.emplace_back(searched_key);
+
+    create_and_add_peer("192.168.1.1", kd::id{ "a" });
+
+    kd::start_find_value_task< data_type >(searched_key
+            , tracker_
+            , routing_table_
+            , std::ref(*this));
+    while (!callback_call_count_)
+        io_service_.poll();
+
+    // Each attempt is a single datagram, the lookup
+    // moves on as soon as the peer timed out.
+    EXPECT_EQ(0U, tracker_.max_retransmissions_count());
+    EXPECT_EQ(1, callback_call_count_);
+}
+
 TEST_F(FindValueTaskTest, can_notify_error_when_all_peers_fail_to_respond)
 {
     kd::id const searched_key{ "a" };
@@ -293,4 +319,174 @@ TEST_F(FindValueTaskTest, can_return_value_when_discovered_peer_has_the_value)
     EXPECT_EQ(fv2.data_, data_);
 }
 
+TEST_F(FindValueTaskTest, cancels_in_flight_requests_once_the_value_is_found)
+{
+    kd::id const searched_key{ "a" };
+    routing_table_.expected_ids_.emplace_back(searched_key);
+
+    auto p1 = create_and_add_peer("192.168.1.1", kd::id{ "b" });
+    auto p2 = create_and_add_peer("192.168.1.2", kd::id{ "c" });
+    auto p3 = create_and_add_peer("192.168.1.3", kd::id{ "d" });
+
+    // p1 (the closest) has the value, p2 & p3 would answer afterwards.
+    kd::FindValueResponseBody const fv1{ { 1, 2, 3, 4 } };
+    tracker_.add_message_to_receive(p1.endpoint_, p1.id_, fv1);
+    tracker_.add_message_to_receive(p2.endpoint_, p2.id_, kd::FindPeerResponseBody{});
+    tracker_.add_message_to_receive(p3.endpoint_, p3.id_, kd::FindPeerResponseBody{});
+
+    kd::start_find_value_task< data_type >(searched_key
+            , tracker_
+            , routing_table_
+            , std::ref(*this));
+    io_service_.poll();
+
+    // Task asked the 3 peers at once.
+    kd::FindValueRequestBody const fv{ searched_key };
+    EXPECT_TRUE(tracker_.has_sent_message(p1.endpoint_, fv));
+    EXPECT_TRUE(tracker_.has_sent_message(p2.endpoint_, fv));
+    EXPECT_TRUE(tracker_.has_sent_message(p3.endpoint_, fv));
+    EXPECT_TRUE(! tracker_.has_sent_message());
+
+    // Task notified the success and released the other requests.
+    EXPECT_EQ(1, callback_call_count_);
+    EXPECT_TRUE(! failure_);
+    EXPECT_EQ(fv1.data_, data_);
+    EXPECT_EQ(2U, tracker_.cancelled_requests_count());
+    // And the timers hedging them.
+    EXPECT_EQ(0U, tracker_.pending_timers_count());
+}
+
+TEST_F(FindValueTaskTest, hedges_slow_requests_with_the_next_candidate)
+{
+    kd::id const searched_key{ "a" };
+    routing_table_.expected_ids_.emplace_back(searched_key);
+
+    // p1 (the closest) doesn't answer, p2 has the value.
+    auto p1 = create_and_add_peer("192.168.1.1", kd::id{ "b" });
+    auto p2 = create_and_add_peer("192.168.1.2", kd::id{ "8" });
+    tracker_.add_unresponsive_endpoint(p1.endpoint_);
+    kd::FindValueResponseBody const fv2{ { 1, 2, 3, 4 } };
+    tracker_.add_message_to_receive(p2.endpoint_, p2.id_, fv2);
+
+    kd::lookup_config config;
+    config.concurrent_requests_count_ = 1;
+    config.min_concurrent_requests_count_ = 1;
+    config.max_concurrent_requests_count_ = 1;
+    config.stats_recorder_ = std::make_shared< kd::lookup_stats_recorder >();
+    kd::start_find_value_task< data_type >(searched_key
+            , tracker_
+            , routing_table_
+            , std::ref(*this)
+            , config);
+    io_service_.poll();
+
+    kd::FindValueRequestBody const fv{ searched_key };
+    EXPECT_TRUE(tracker_.has_sent_message(p1.endpoint_, fv));
+    EXPECT_TRUE(! tracker_.has_sent_message());
+    EXPECT_EQ(0, callback_call_count_);
+
+    // p1 is slow, p2 is asked too.
+    EXPECT_EQ(1U, tracker_.expire_timers());
+    EXPECT_TRUE(tracker_.has_sent_message(p2.endpoint_, fv));
+    io_service_.poll();
+
+    EXPECT_EQ(1, callback_call_count_);
+    EXPECT_TRUE(! failure_);
+    EXPECT_EQ(fv2.data_, data_);
+    EXPECT_EQ(1U, tracker_.cancelled_requests_count());
+
+    // The timer hedging the answered request is gone with the task.
+    EXPECT_EQ(0U, tracker_.pending_timers_count());
+    EXPECT_EQ(0U, tracker_.expire_timers());
+    EXPECT_TRUE(! tracker_.has_sent_message());
+
+    auto const stats = config.stats_recorder_->stats();
+    EXPECT_EQ(1U, stats.lookups_count_);
+    EXPECT_EQ(2U, stats.requests_count_);
+    EXPECT_EQ(1U, stats.hedged_requests_count_);
+}
+
+TEST_F(FindValueTaskTest, fetches_a_probed_value_from_a_single_holder)
+{
+    kd::id const searched_key{ "a" };
+    routing_table_.expected_ids_.emplace_back(searched_key);
+
+    auto p1 = create_and_add_peer("192.168.1.1", kd::id{ "b" });
+    auto p2 = create_and_add_peer("192.168.1.2", kd::id{ "c" });
+    auto p3 = create_and_add_peer("192.168.1.3", kd::id{ "d" });
+
+    // The 3 peers hold the value, p1 sends it.
+    kd::FindValueResponseBody const fv1{ data_type(4096, 7) };
+    kd::ValueProbeResponseBody probe;
+    probe.size_ = fv1.data_.size();
+    probe.content_hash_ = kd::id{ fv1.data_ };
+    tracker_.add_message_to_receive(p1.endpoint_, p1.id_, probe);
+    tracker_.add_message_to_receive(p2.endpoint_, p2.id_, probe);
+    tracker_.add_message_to_receive(p3.endpoint_, p3.id_, probe);
+    tracker_.add_message_to_receive(p1.endpoint_, p1.id_, fv1);
+
+    kd::lookup_config config;
+    config.probe_values_ = true;
+    kd::start_find_value_task< data_type >(searched_key
+            , tracker_
+            , routing_table_
+            , std::ref(*this)
+            , config);
+    while (!callback_call_count_)
+        io_service_.poll();
+
+    // The 3 peers are probed, the value is fetched once.
+    kd::ValueProbeRequestBody const vp{ searched_key };
+    EXPECT_TRUE(tracker_.has_sent_message(p1.endpoint_, vp));
+    EXPECT_TRUE(tracker_.has_sent_message(p2.endpoint_, vp));
+    EXPECT_TRUE(tracker_.has_sent_message(p3.endpoint_, vp));
+    kd::FindValueRequestBody const fv{ searched_key };
+    EXPECT_TRUE(tracker_.has_sent_message(p1.endpoint_, fv));
+    EXPECT_TRUE(! tracker_.has_sent_message());
+
+    EXPECT_EQ(1, callback_call_count_);
+    EXPECT_TRUE(! failure_);
+    EXPECT_EQ(fv1.data_, data_);
+}
+
+TEST_F(FindValueTaskTest, fetches_a_probed_value_from_the_next_holder_on_failure)
+{
+    kd::id const searched_key{ "a" };
+    routing_table_.expected_ids_.emplace_back(searched_key);
+
+    auto p1 = create_and_add_peer("192.168.1.1", kd::id{ "b" });
+    auto p2 = create_and_add_peer("192.168.1.2", kd::id{ "c" });
+
+    // p1 fails to send the value, p2 sends it.
+    kd::FindValueResponseBody const fv2{ data_type(4096, 7) };
+    kd::ValueProbeResponseBody probe;
+    probe.size_ = fv2.data_.size();
+    probe.content_hash_ = kd::id{ fv2.data_ };
+    tracker_.add_message_to_receive(p1.endpoint_, p1.id_, probe);
+    tracker_.add_message_to_receive(p2.endpoint_, p2.id_, probe);
+    tracker_.add_message_to_receive(p2.endpoint_, p2.id_, fv2);
+
+    kd::lookup_config config;
+    config.probe_values_ = true;
+    kd::start_find_value_task< data_type >(searched_key
+            , tracker_
+            , routing_table_
+            , std::ref(*this)
+            , config);
+    while (!callback_call_count_)
+        io_service_.poll();
+
+    kd::ValueProbeRequestBody const vp{ searched_key };
+    EXPECT_TRUE(tracker_.has_sent_message(p1.endpoint_, vp));
+    EXPECT_TRUE(tracker_.has_sent_message(p2.endpoint_, vp));
+    kd::FindValueRequestBody const fv{ searched_key };
+    EXPECT_TRUE(tracker_.has_sent_message(p1.endpoint_, fv));
+    EXPECT_TRUE(tracker_.has_sent_message(p2.endpoint_, fv));
+    EXPECT_TRUE(! tracker_.has_sent_message());
+
+    EXPECT_EQ(1, callback_call_count_);
+    EXPECT_TRUE(! failure_);
+    EXPECT_EQ(fv2.data_, data_);
+}
+
 }
@@ -0,0 +1,154 @@
+// Copyright (c) 2021, Aleph ONE Software Engineering and Contributors.
+//
+// SPDX-License-Identifier:	BSL-1.0
+
+
+#include "common.hpp"
+#include "kademlia/fragmentation.hpp"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+
+namespace {
+
+namespace kd = kademlia::detail;
+
+
+kd::buffer make_message(std::size_t size)
+{
+    std::default_random_engine random_engine;
+    std::uniform_int_distribution<int> byte(0, 255);
+    kd::buffer message(size);
+    for (auto& b : message)
+        b = std::uint8_t(byte(random_engine));
+    return message;
+}
+
+void acknowledge(kd::fragment_sender& sender, kd::fragment_reassembler const& reassembler)
+{
+    sender.on_ack(reassembler.next(), reassembler.received_mask(), 8);
+}
+
+
+TEST(FragmentationTest, reassembles_a_message_sent_over_a_lossy_link)
+{
+    auto const message = make_message(100000);
+    kd::fragment_sender sender(message, 1000, 8);
+    kd::fragment_reassembler reassembler(sender.message_size(), sender.count());
+    EXPECT_EQ(100U, sender.count());
+
+    // One transmission out of 5 is lost.
+    std::size_t transmissions_count = 0;
+    while (!sender.complete())
+    {
+        auto const indexes = sender.select_fragments_to_send();
+        if (indexes.empty())
+        {
+            sender.on_timeout();
+            continue;
+        }
+
+        for (auto index : indexes)
+        {
+            if (++transmissions_count % 5 == 0) continue;
+            auto const f = sender.fragment(index);
+            reassembler.add(index, f.first, f.second);
+        }
+        acknowledge(sender, reassembler);
+    }
+
+    ASSERT_TRUE(reassembler.complete());
+    EXPECT_EQ(message, reassembler.message());
+    EXPECT_GT(130U, transmissions_count);
+}
+
+TEST(FragmentationTest, retransmits_only_the_missing_fragments)
+{
+    kd::fragment_sender sender(make_message(10000), 1000, 10);
+    kd::fragment_reassembler reassembler(sender.message_size(), sender.count());
+
+    auto const indexes = sender.select_fragments_to_send();
+    EXPECT_EQ(10U, indexes.size());
+    EXPECT_TRUE(sender.select_fragments_to_send().empty());
+
+    // The 3rd fragment is lost, the receiver got 7 later ones.
+    for (auto index : indexes)
+    {
+        auto const f = sender.fragment(index);
+        if (index != 2)
+        {
+            EXPECT_TRUE(reassembler.add(index, f.first, f.second));
+        }
+    }
+    EXPECT_EQ(2U, reassembler.next());
+    EXPECT_EQ(0x7fU, reassembler.received_mask());
+
+    EXPECT_TRUE(sender.on_ack(reassembler.next(), reassembler.received_mask(), 10));
+    EXPECT_EQ((std::vector<std::uint32_t>{ 2 }), sender.select_fragments_to_send());
+    EXPECT_FALSE(sender.complete());
+
+    auto const f = sender.fragment(2);
+    EXPECT_TRUE(reassembler.add(2, f.first, f.second));
+    EXPECT_TRUE(reassembler.complete());
+    EXPECT_EQ(10U, reassembler.next());
+
+    EXPECT_TRUE(sender.on_ack(reassembler.next(), reassembler.received_mask(), 10));
+    EXPECT_TRUE(sender.complete());
+    EXPECT_EQ(0U, sender.in_flight_count());
+}
+
+TEST(FragmentationTest, timeouts_shrink_the_window_and_acks_grow_it_back)
+{
+    kd::fragment_sender sender(make_message(100000), 1000, 8);
+    EXPECT_EQ(8U, sender.select_fragments_to_send().size());
+
+    sender.on_timeout();
+    EXPECT_EQ(4U, sender.window());
+    EXPECT_EQ(0U, sender.in_flight_count());
+    EXPECT_EQ((std::vector<std::uint32_t>{ 0, 1, 2, 3 }), sender.select_fragments_to_send());
+
+    EXPECT_TRUE(sender.on_ack(2, 0, 8));
+    EXPECT_EQ(5U, sender.window());
+    EXPECT_EQ(2U, sender.in_flight_count());
+
+    // The receiver advertises a smaller window.
+    EXPECT_FALSE(sender.on_ack(2, 0, 3));
+    EXPECT_EQ(3U, sender.window());
+    EXPECT_EQ(1U, sender.select_fragments_to_send().size());
+}
+
+TEST(FragmentationTest, reassembler_rejects_invalid_fragments)
+{
+    EXPECT_TRUE(kd::fragment_reassembler::is_valid(10, 4, 100, 3));
+    EXPECT_FALSE(kd::fragment_reassembler::is_valid(10, 6, 100, 3));
+    EXPECT_FALSE(kd::fragment_reassembler::is_valid(10, 0, 100, 3));
+    EXPECT_FALSE(kd::fragment_reassembler::is_valid(10, 11, 100, 3));
+    EXPECT_FALSE(kd::fragment_reassembler::is_valid(1000, 4, 100, 3));
+    // A single fragment can't carry a whole large message.
+    EXPECT_FALSE(kd::fragment_reassembler::is_valid(10, 3, 100, 3));
+    EXPECT_FALSE(kd::fragment_reassembler::is_valid(64 * 1024 * 1024, 1, 64 * 1024 * 1024, 1024));
+
+    // Fragments of 3, 3, 3 and 1 bytes.
+    kd::fragment_reassembler reassembler(10, 4);
+    kd::buffer const three(3, 7), one(1, 7);
+    EXPECT_FALSE(reassembler.add(3, three.begin(), three.end()));
+    EXPECT_FALSE(reassembler.add(0, one.begin(), one.end()));
+    EXPECT_FALSE(reassembler.add(4, one.begin(), one.end()));
+    // Nothing is allocated for the rejected fragments.
+    EXPECT_TRUE(reassembler.message().empty());
+    EXPECT_EQ(10U, reassembler.size());
+    EXPECT_TRUE(reassembler.add(3, one.begin(), one.end()));
+    EXPECT_EQ(10U, reassembler.message().size());
+    EXPECT_FALSE(reassembler.add(3, one.begin(), one.end()));
+
+    EXPECT_EQ(0U, reassembler.next());
+    EXPECT_EQ(0x4U, reassembler.received_mask());
+    EXPECT_FALSE(reassembler.complete());
+    EXPECT_TRUE(reassembler.matches(10, 4));
+    EXPECT_FALSE(reassembler.matches(10, 5));
+}
+
+}
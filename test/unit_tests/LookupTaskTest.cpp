@@ -29,7 +29,12 @@
 #include "kademlia/id.hpp"
 #include "kademlia/constants.hpp"
 #include "kademlia/LookupTask.h"
+#include "kademlia/routing_table.hpp"
 #include "gtest/gtest.h"
+#include <chrono>
+#include <memory>
+#include <sstream>
+#include <string>
 #include <vector>
 #include <utility>
 
@@ -43,8 +48,16 @@ struct test_task : kd::LookupTask {
     template< typename Iterator >
     test_task
         (kd::id const& key
-        , Iterator i, Iterator e)
-        : LookupTask{ key, i, e, SocketAddress("127.0.0.1", 1234), SocketAddress("::1", 1234) }
+        , Iterator i, Iterator e
+        , kd::lookup_config const& config = kd::lookup_config())
+        : LookupTask{ key, i, e, SocketAddress("127.0.0.1", 1234), SocketAddress("::1", 1234), config }
+    { }
+
+    template< typename RoutingTableType >
+    test_task
+        (kd::id const& key
+        , RoutingTableType & routing_table)
+        : LookupTask{ key, routing_table, SocketAddress("127.0.0.1", 1234), SocketAddress("::1", 1234) }
     { }
 };
 
@@ -113,6 +126,31 @@ TEST(LookupTaskTest, can_select_candidates)
     EXPECT_EQ(kd::id{ "6" }, closest_candidates[ 1 ].id_);
 }
 
+TEST(LookupTaskTest, prefers_the_fastest_of_equally_close_candidates)
+{
+    kd::routing_table< SocketAddress > routing_table{ kd::id{ "ff" } };
+    for (int i = 1; i != 8; ++i)
+        routing_table.push(kd::id{ std::to_string(i) }, SocketAddress("10.0.0.1", std::uint16_t(1024 + i)));
+    routing_table.record_rtt(kd::id{ "7" }, std::chrono::microseconds(100));
+    routing_table.record_rtt(kd::id{ "6" }, std::chrono::microseconds(50));
+    routing_table.record_rtt(kd::id{ "1" }, std::chrono::microseconds(900));
+
+    // "4" to "7" are as close to the key, "1" is closer whatever its rtt.
+    kd::id const key{};
+    test_task c{ key, routing_table };
+    auto candidates = c.select_new_closest_candidates(3);
+    ASSERT_EQ(3, candidates.size());
+    EXPECT_EQ(kd::id{ "1" }, candidates[ 0 ].id_);
+    EXPECT_EQ(kd::id{ "2" }, candidates[ 1 ].id_);
+    EXPECT_EQ(kd::id{ "3" }, candidates[ 2 ].id_);
+
+    candidates = c.select_new_closest_candidates(6);
+    ASSERT_EQ(3, candidates.size());
+    EXPECT_EQ(kd::id{ "6" }, candidates[ 0 ].id_);
+    EXPECT_EQ(kd::id{ "7" }, candidates[ 1 ].id_);
+    EXPECT_EQ(kd::id{ "4" }, candidates[ 2 ].id_);
+}
+
 TEST(LookupTaskTest, can_add_candidates)
 {
     std::vector< routing_table_peer > candidates;
@@ -141,4 +179,104 @@ TEST(LookupTaskTest, can_add_candidates)
     EXPECT_EQ(1, c.select_new_closest_candidates(20).size());
 }
 
+kd::id make_id(int value)
+{
+    std::ostringstream hex;
+    hex << std::hex << value;
+    return kd::id{ hex.str() };
+}
+
+TEST(LookupTaskTest, keeps_the_closest_candidates_and_converges)
+{
+    std::size_t const k = kd::ROUTING_TABLE_BUCKET_SIZE;
+    std::vector< routing_table_peer > candidates;
+    for (std::size_t i = 0; i != k; ++i)
+        candidates.emplace_back(make_id(0x40 + int(i)), SocketAddress{});
+    kd::id const key{};
+    test_task c{ key, candidates.begin(), candidates.end() };
+    EXPECT_EQ(3, c.select_new_closest_candidates(3).size());
+
+    // k closer candidates replace all the farther ones
+    // but those a request is in flight to.
+    std::vector< kd::Peer > new_candidates;
+    for (std::size_t i = 0; i != k; ++i)
+        new_candidates.emplace_back(createPeer(make_id(1 + int(i))));
+    c.add_candidates(new_candidates);
+    auto const selected = c.select_new_closest_candidates(100);
+    ASSERT_EQ(k, selected.size());
+    EXPECT_EQ(make_id(1), selected.front().id_);
+    EXPECT_EQ(make_id(int(k)), selected.back().id_);
+
+    for (auto const& p : selected)
+        c.flag_candidate_as_valid(p.id_);
+
+    // The k closest responded, the farther requests can be cancelled.
+    EXPECT_TRUE(c.have_converged());
+    EXPECT_TRUE(! c.have_all_requests_completed());
+
+    c.flag_candidate_as_valid(make_id(0x40));
+    auto const valid_candidates = c.select_closest_valid_candidates(100);
+    EXPECT_EQ(k, valid_candidates.size());
+    EXPECT_EQ(make_id(int(k)), valid_candidates.back().id_);
+}
+
+TEST(LookupTaskTest, unresponsive_candidates_are_not_added_again)
+{
+    std::vector< routing_table_peer > candidates;
+    candidates.emplace_back(kd::id{ "7" }, SocketAddress{});
+    kd::id const key{};
+    test_task c{ key, candidates.begin(), candidates.end() };
+
+    for (int i = 0; i < kd::MAX_FIND_PEER_ATTEMPT_COUNT; ++i)
+    {
+        EXPECT_EQ(1, c.select_new_closest_candidates(1).size());
+        c.flag_candidate_as_invalid(kd::id{ "7" });
+    }
+    EXPECT_EQ(0, c.select_new_closest_candidates(1).size());
+
+    std::vector< kd::Peer > new_candidates{ createPeer(kd::id{ "7" }) };
+    c.add_candidates(new_candidates);
+    EXPECT_EQ(0, c.select_new_closest_candidates(1).size());
+    EXPECT_TRUE(! c.have_converged());
+}
+
+TEST(LookupTaskTest, follows_its_config_and_records_its_stats)
+{
+    kd::lookup_config config;
+    config.bucket_size_ = 4;
+    config.concurrent_requests_count_ = 2;
+    config.min_concurrent_requests_count_ = 1;
+    config.max_concurrent_requests_count_ = 4;
+    config.stats_recorder_ = std::make_shared< kd::lookup_stats_recorder >();
+
+    std::vector< routing_table_peer > candidates;
+    for (int i = 1; i != 10; ++i)
+        candidates.emplace_back(make_id(i), SocketAddress{});
+    kd::id const key{};
+    {
+        test_task c{ key, candidates.begin(), candidates.end(), config };
+        EXPECT_EQ(2U, c.concurrency());
+
+        auto const selected = c.select_new_closest_candidates(c.concurrency());
+        ASSERT_EQ(2U, selected.size());
+        // The lost request makes room for two more.
+        c.flag_candidate_as_invalid(selected.front().id_);
+        EXPECT_EQ(3U, c.concurrency());
+        EXPECT_EQ(2U, c.select_new_closest_candidates(c.concurrency()).size());
+
+        // The lost candidate was retried first, only the 4 closest
+        // candidates are kept.
+        auto const last = c.select_new_closest_candidates(c.concurrency() + 2);
+        ASSERT_EQ(1U, last.size());
+        EXPECT_EQ(make_id(4), last.front().id_);
+    }
+
+    auto const stats = config.stats_recorder_->stats();
+    EXPECT_EQ(1U, stats.lookups_count_);
+    EXPECT_EQ(5U, stats.requests_count_);
+    EXPECT_EQ(1U, stats.timeouts_count_);
+    ASSERT_EQ(4U, stats.lookups_per_alpha_.size());
+    EXPECT_EQ(1U, stats.lookups_per_alpha_[3]);
+}
+
 }
@@ -0,0 +1,135 @@
+// Copyright (c) 2021, Aleph ONE Software Engineering and Contributors.
+//
+// SPDX-License-Identifier:	BSL-1.0
+
+
+#include "common.hpp"
+#include "PeerFactory.h"
+#include "kademlia/membership_table.hpp"
+#include "Poco/Net/SocketAddress.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+
+namespace {
+
+namespace kd = kademlia::detail;
+
+using test_membership_table = kd::membership_table<Poco::Net::SocketAddress>;
+using clock_type = test_membership_table::clock;
+
+
+TEST(MembershipTableTest, ignores_own_id)
+{
+    test_membership_table members{ kd::id{ "1" } };
+    EXPECT_FALSE(members.push(kd::id{ "1" }, createEndpoint("192.168.0.1"), clock_type::now()));
+    EXPECT_TRUE(members.empty());
+}
+
+TEST(MembershipTableTest, replaces_members_showing_under_a_known_endpoint)
+{
+    auto const now = clock_type::now();
+    test_membership_table members{ kd::id{} };
+    EXPECT_TRUE(members.push(kd::id{ "1" }, createEndpoint("192.168.0.1"), now));
+    EXPECT_FALSE(members.push(kd::id{ "1" }, createEndpoint("192.168.0.1"), now));
+    EXPECT_TRUE(members.push(kd::id{ "2" }, createEndpoint("192.168.0.1"), now));
+    EXPECT_EQ(1U, members.size());
+
+    // A member moving to a known endpoint replaces its previous owner.
+    EXPECT_TRUE(members.push(kd::id{ "3" }, createEndpoint("192.168.0.3"), now));
+    EXPECT_FALSE(members.push(kd::id{ "3" }, createEndpoint("192.168.0.1"), now));
+    EXPECT_EQ(1U, members.size());
+
+    std::vector<test_membership_table::value_type> found;
+    members.closest(kd::id{}, 10, std::back_inserter(found));
+    ASSERT_EQ(1U, found.size());
+    EXPECT_EQ(kd::id{ "3" }, found[0].first);
+    EXPECT_EQ(createEndpoint("192.168.0.1"), found[0].second);
+}
+
+TEST(MembershipTableTest, gossip_refreshes_members_only_when_they_beat)
+{
+    auto const start = clock_type::now();
+    auto const ttl = std::chrono::seconds(10);
+    test_membership_table members{ kd::id{} };
+    EXPECT_TRUE(members.merge(kd::id{ "1" }, createEndpoint("192.168.0.1"), 5, start));
+    EXPECT_TRUE(members.merge(kd::id{ "2" }, createEndpoint("192.168.0.2"), 5, start));
+
+    // "1" keeps beating, "2" is only echoed.
+    auto const later = start + std::chrono::seconds(8);
+    EXPECT_FALSE(members.merge(kd::id{ "1" }, createEndpoint("192.168.0.1"), 6, later));
+    EXPECT_FALSE(members.merge(kd::id{ "2" }, createEndpoint("192.168.0.2"), 5, later));
+
+    EXPECT_EQ(1U, members.expire(start + std::chrono::seconds(12), ttl));
+    std::vector<test_membership_table::value_type> found;
+    members.closest(kd::id{}, 10, std::back_inserter(found));
+    ASSERT_EQ(1U, found.size());
+    EXPECT_EQ(kd::id{ "1" }, found[0].first);
+}
+
+TEST(MembershipTableTest, unresponsive_members_are_removed)
+{
+    test_membership_table members{ kd::id{} };
+    members.push(kd::id{ "1" }, createEndpoint("192.168.0.1"), clock_type::now());
+    members.push(kd::id{ "2" }, createEndpoint("192.168.0.2"), clock_type::now());
+
+    members.flag_peer_as_unresponsive(kd::id{ "1" });
+
+    // Stale members come last.
+    std::vector<test_membership_table::value_type> found;
+    members.closest(kd::id{ "1" }, 10, std::back_inserter(found));
+    ASSERT_EQ(2U, found.size());
+    EXPECT_EQ(kd::id{ "2" }, found[0].first);
+    EXPECT_EQ(kd::id{ "1" }, found[1].first);
+
+    for (std::size_t i = 1; i < kd::MAX_PEER_FAILURE_COUNT; ++i)
+        members.flag_peer_as_unresponsive(kd::id{ "1" });
+    EXPECT_EQ(1U, members.size());
+}
+
+TEST(MembershipTableTest, closest_returns_members_sorted_by_distance)
+{
+    std::default_random_engine random_engine;
+    test_membership_table members{ kd::id{ random_engine } };
+
+    std::vector<kd::id> ids;
+    for (int i = 0; i < 500; ++i)
+    {
+        ids.emplace_back(random_engine);
+        members.push(ids.back(), createEndpoint("10.0." + std::to_string(i / 256) + "." + std::to_string(i % 256)), clock_type::now());
+    }
+
+    kd::id const target{ random_engine };
+    std::sort(ids.begin(), ids.end(), [&target](kd::id const& a, kd::id const& b)
+    { return kd::distance(a, target) < kd::distance(b, target); });
+
+    std::vector<test_membership_table::value_type> found;
+    EXPECT_EQ(20U, members.closest(target, 20, std::back_inserter(found)));
+    for (std::size_t i = 0; i < found.size(); ++i)
+        EXPECT_EQ(ids[i], found[i].first);
+}
+
+TEST(MembershipTableTest, sample_picks_distinct_members)
+{
+    std::default_random_engine random_engine;
+    test_membership_table members{ kd::id{} };
+    for (int i = 1; i <= 50; ++i)
+        members.merge(kd::id{ random_engine }, createEndpoint("10.0.0." + std::to_string(i)), i, clock_type::now());
+
+    std::set<kd::id> sampled;
+    members.sample(20, random_engine, [&sampled](kd::id const& member_id, Poco::Net::SocketAddress const&, std::uint64_t)
+    { sampled.insert(member_id); });
+    EXPECT_EQ(20U, sampled.size());
+
+    sampled.clear();
+    members.sample(100, random_engine, [&sampled](kd::id const& member_id, Poco::Net::SocketAddress const&, std::uint64_t)
+    { sampled.insert(member_id); });
+    EXPECT_EQ(50U, sampled.size());
+}
+
+}
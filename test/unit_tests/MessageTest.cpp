@@ -289,6 +289,75 @@ TEST(MessageTest, can_detect_corrupted_find_value_response_body)
     }
 }
 
+TEST(MessageTest, can_serialize_value_probe_bodies)
+{
+    std::default_random_engine random_engine;
+
+    kd::ValueProbeRequestBody const request_out{ kd::id{ random_engine } };
+    kd::ValueProbeResponseBody response_out;
+    response_out.size_ = 0x123456789ULL;
+    response_out.content_hash_ = kd::id{ random_engine };
+
+    kd::buffer buffer;
+    kd::serialize(request_out, buffer);
+    kd::serialize(response_out, buffer);
+
+    kd::ValueProbeRequestBody request_in;
+    kd::ValueProbeResponseBody response_in;
+    auto i = buffer.cbegin(), e = buffer.cend();
+    EXPECT_TRUE(! kd::deserialize(i, e, request_in));
+    EXPECT_TRUE(! kd::deserialize(i, e, response_in));
+    EXPECT_TRUE(i == e);
+
+    EXPECT_EQ(request_out.value_to_find_, request_in.value_to_find_);
+    EXPECT_EQ(response_out.size_, response_in.size_);
+    EXPECT_EQ(response_out.content_hash_, response_in.content_hash_);
+
+    // A truncated response is detected.
+    i = buffer.cbegin();
+    EXPECT_TRUE(! kd::deserialize(i, e, request_in));
+    EXPECT_TRUE(kd::deserialize(i, e - 1, response_in));
+}
+
+TEST(MessageTest, can_serialize_fragment_bodies)
+{
+    kd::FragmentBody fragment_out;
+    fragment_out.message_size_ = 0x123456789ULL;
+    fragment_out.index_ = 12;
+    fragment_out.count_ = 0x100000;
+    fragment_out.flags_ = kd::FragmentBody::ACK_REQUESTED;
+    fragment_out.data_.assign(1024, 7);
+
+    kd::FragmentAckBody ack_out;
+    ack_out.next_ = 12;
+    ack_out.received_mask_ = 0x8000000000000001ULL;
+    ack_out.window_ = 32;
+
+    kd::buffer buffer;
+    kd::serialize(fragment_out, buffer);
+    kd::serialize(ack_out, buffer);
+
+    kd::FragmentBody fragment_in;
+    kd::FragmentAckBody ack_in;
+    auto i = buffer.cbegin(), e = buffer.cend();
+    EXPECT_TRUE(! kd::deserialize(i, e, fragment_in));
+    EXPECT_TRUE(! kd::deserialize(i, e, ack_in));
+    EXPECT_TRUE(i == e);
+
+    EXPECT_EQ(fragment_out.message_size_, fragment_in.message_size_);
+    EXPECT_EQ(fragment_out.index_, fragment_in.index_);
+    EXPECT_EQ(fragment_out.count_, fragment_in.count_);
+    EXPECT_EQ(fragment_out.flags_, fragment_in.flags_);
+    EXPECT_EQ(fragment_out.data_, fragment_in.data_);
+    EXPECT_EQ(ack_out.next_, ack_in.next_);
+    EXPECT_EQ(ack_out.received_mask_, ack_in.received_mask_);
+    EXPECT_EQ(ack_out.window_, ack_in.window_);
+
+    // A truncated fragment is detected.
+    i = buffer.cbegin();
+    EXPECT_TRUE(kd::deserialize(i, buffer.cbegin() + 1000, fragment_in));
+}
+
 TEST(MessageTest, can_serialize_store_value_request_body)
 {
     std::default_random_engine random_engine;
@@ -338,6 +407,100 @@ TEST(MessageTest, can_detect_corrupted_store_value_request_body)
     }
 }
 
+TEST(MessageTest, can_serialize_membership_digest_body)
+{
+    std::default_random_engine random_engine;
+
+    kd::MembershipDigestRequestBody body_out;
+    body_out.heartbeat_ = 42;
+    for (std::size_t i = 0; i < 10; ++ i)
+    {
+        static std::string const IPS[2] =
+            { "::1"
+            , "127.0.0.1" };
+
+        body_out.members_.push_back(kd::MembershipEntry
+            { kd::Peer{ kd::id{ random_engine }
+                      , Poco::Net::SocketAddress(IPS[ i % 2 ], std::uint16_t(1024 + i)) }
+            , i * 1000 });
+    }
+
+    kd::buffer buffer;
+    kd::serialize(body_out, buffer);
+
+    kd::MembershipDigestRequestBody body_in;
+    auto i = buffer.cbegin(), e = buffer.cend();
+    EXPECT_TRUE(! kd::deserialize(i, e, body_in));
+    EXPECT_TRUE(i == e);
+
+    EXPECT_EQ(body_out.heartbeat_, body_in.heartbeat_);
+    ASSERT_EQ(body_out.members_.size(), body_in.members_.size());
+    for (std::size_t j = 0; j < body_out.members_.size(); ++ j)
+    {
+        EXPECT_EQ(body_out.members_[j].peer_.id_, body_in.members_[j].peer_.id_);
+        EXPECT_EQ(body_out.members_[j].peer_.endpoint_, body_in.members_[j].peer_.endpoint_);
+        EXPECT_EQ(body_out.members_[j].heartbeat_, body_in.members_[j].heartbeat_);
+    }
+
+    // Truncated digests are detected.
+    auto const b = buffer.cbegin();
+    for (auto t = buffer.cend(); t != b; )
+    {
+        kd::MembershipDigestRequestBody truncated;
+        auto j = b;
+        EXPECT_TRUE(kd::deserialize(j, --t, truncated));
+    }
+}
+
+TEST(MessageTest, can_serialize_routing_table_snapshot)
+{
+    std::default_random_engine random_engine;
+
+    kd::RoutingTableSnapshot snapshot_out;
+    snapshot_out.id_ = kd::id{ random_engine };
+    snapshot_out.time_ = 1600000000000;
+    for (std::size_t i = 0; i < 10; ++ i)
+    {
+        static std::string const IPS[2] =
+            { "::1"
+            , "127.0.0.1" };
+
+        snapshot_out.peers_.push_back(kd::RoutingTableSnapshotEntry
+            { kd::Peer{ kd::id{ random_engine }
+                      , Poco::Net::SocketAddress(IPS[ i % 2 ], std::uint16_t(1024 + i)) }
+            , snapshot_out.time_ - i * 1000
+            , std::uint32_t(i) });
+    }
+
+    kd::buffer buffer;
+    kd::serialize(snapshot_out, buffer);
+
+    kd::RoutingTableSnapshot snapshot_in;
+    auto i = buffer.cbegin(), e = buffer.cend();
+    EXPECT_TRUE(! kd::deserialize(i, e, snapshot_in));
+    EXPECT_TRUE(i == e);
+
+    EXPECT_EQ(snapshot_out.id_, snapshot_in.id_);
+    EXPECT_EQ(snapshot_out.time_, snapshot_in.time_);
+    ASSERT_EQ(snapshot_out.peers_.size(), snapshot_in.peers_.size());
+    for (std::size_t j = 0; j < snapshot_out.peers_.size(); ++ j)
+    {
+        EXPECT_EQ(snapshot_out.peers_[j].peer_.id_, snapshot_in.peers_[j].peer_.id_);
+        EXPECT_EQ(snapshot_out.peers_[j].peer_.endpoint_, snapshot_in.peers_[j].peer_.endpoint_);
+        EXPECT_EQ(snapshot_out.peers_[j].last_seen_, snapshot_in.peers_[j].last_seen_);
+        EXPECT_EQ(snapshot_out.peers_[j].rtt_, snapshot_in.peers_[j].rtt_);
+    }
+
+    // Truncated snapshots are detected.
+    auto const b = buffer.cbegin();
+    for (auto t = buffer.cend(); t != b; )
+    {
+        kd::RoutingTableSnapshot truncated;
+        auto j = b;
+        EXPECT_TRUE(kd::deserialize(j, --t, truncated));
+    }
+}
+
 kd::Header
 generate_incorrect_header(void)
 {
@@ -378,6 +541,30 @@ TEST(MessageTest, header_is_printable)
                      , kd::Header::FIND_VALUE_RESPONSE }
         << std::endl;
 
+    out << kd::Header{ kd::Header::V1
+                     , kd::Header::MEMBERSHIP_DIGEST_REQUEST }
+        << std::endl;
+
+    out << kd::Header{ kd::Header::V1
+                     , kd::Header::MEMBERSHIP_DIGEST_RESPONSE }
+        << std::endl;
+
+    out << kd::Header{ kd::Header::V1
+                     , kd::Header::VALUE_PROBE_REQUEST }
+        << std::endl;
+
+    out << kd::Header{ kd::Header::V1
+                     , kd::Header::VALUE_PROBE_RESPONSE }
+        << std::endl;
+
+    out << kd::Header{ kd::Header::V1
+                     , kd::Header::FRAGMENT }
+        << std::endl;
+
+    out << kd::Header{ kd::Header::V1
+                     , kd::Header::FRAGMENT_ACK }
+        << std::endl;
+
     EXPECT_EQ(pattern, out.str());
     EXPECT_THROW(out << generate_incorrect_header(), std::exception);
 }
@@ -85,13 +85,11 @@ TEST_F(ResponseRouterTest, known_messages_are_forwarded)
         ( std::error_code const& failure )
     { ++ error_count_; };
 
+    auto const token = router_.register_temporary_callback( std::chrono::hours{ 1 }
+                                                          , on_message_received
+                                                          , on_error );
     kd::Header const h1{ kd::Header::V1, kd::Header::PING_REQUEST
-                       , kd::id{}, kd::id{ "1" } };
-
-    router_.register_temporary_callback( h1.random_token_
-                                       , std::chrono::hours{ 1 }
-                                       , on_message_received
-                                       , on_error );
+                       , kd::id{}, token };
 
     io_service_.poll();
     EXPECT_EQ(0ULL, messages_received_count_ );
@@ -122,13 +120,11 @@ TEST_F(ResponseRouterTest, known_messages_are_not_forwarded_when_late)
         ( std::error_code const& failure )
     { ++ error_count_; };
 
+    auto const token = router_.register_temporary_callback( std::chrono::hours{ 0 }
+                                                          , on_message_received
+                                                          , on_error );
     kd::Header const h1{ kd::Header::V1, kd::Header::PING_REQUEST
-                       , kd::id{}, kd::id{ "1" } };
-
-    router_.register_temporary_callback( h1.random_token_
-                                       , std::chrono::hours{ 0 }
-                                       , on_message_received
-                                       , on_error );
+                       , kd::id{}, token };
 
     while (0 == io_service_.poll());
     EXPECT_EQ(0ULL, messages_received_count_ );
@@ -145,4 +141,81 @@ TEST_F(ResponseRouterTest, known_messages_are_not_forwarded_when_late)
     EXPECT_EQ(1ULL, error_count_ );
 }
 
+TEST_F(ResponseRouterTest, late_messages_do_not_reach_the_request_reusing_the_slot)
+{
+    auto on_message_received = [ this ]
+            ( Poco::Net::SocketAddress const&
+            , kd::Header const&
+            , kd::buffer::const_iterator
+            , kd::buffer::const_iterator )
+    { ++ messages_received_count_; };
+
+    auto on_error = [ this ]
+        ( std::error_code const& )
+    { ++ error_count_; };
+
+    auto const first = router_.register_temporary_callback( std::chrono::hours{ 1 }
+                                                          , on_message_received
+                                                          , on_error );
+    EXPECT_TRUE(router_.cancel(first));
+    EXPECT_FALSE(router_.cancel(first));
+    EXPECT_EQ(0U, router_.pending_count());
+
+    // The slot is reused with a new generation.
+    auto const second = router_.register_temporary_callback( std::chrono::hours{ 1 }
+                                                           , on_message_received
+                                                           , on_error );
+    EXPECT_NE(first, second);
+    EXPECT_EQ(1U, router_.pending_count());
+
+    Poco::Net::SocketAddress const s{};
+    kd::buffer const b;
+    router_.handle_new_response( s, kd::Header{ kd::Header::V1, kd::Header::PING_RESPONSE
+                                              , kd::id{}, first }, b.begin(), b.end() );
+    EXPECT_EQ(0ULL, messages_received_count_ );
+
+    // A forged token pointing to the slot is rejected as well.
+    kd::id forged = second;
+    forged[ kd::id::BIT_SIZE - 1 ] = ! forged[ kd::id::BIT_SIZE - 1 ];
+    router_.handle_new_response( s, kd::Header{ kd::Header::V1, kd::Header::PING_RESPONSE
+                                              , kd::id{}, forged }, b.begin(), b.end() );
+    EXPECT_EQ(0ULL, messages_received_count_ );
+
+    router_.handle_new_response( s, kd::Header{ kd::Header::V1, kd::Header::PING_RESPONSE
+                                              , kd::id{}, second }, b.begin(), b.end() );
+    EXPECT_EQ(1ULL, messages_received_count_ );
+    EXPECT_EQ(0U, router_.pending_count());
+    EXPECT_EQ(0ULL, error_count_ );
+}
+
+TEST_F(ResponseRouterTest, on_timeout_can_extend_the_wait)
+{
+    auto on_message_received = [ this ]
+            ( Poco::Net::SocketAddress const&
+            , kd::Header const&
+            , kd::buffer::const_iterator
+            , kd::buffer::const_iterator )
+    { ++ messages_received_count_; };
+
+    auto on_error = [ this ]
+        ( std::error_code const& )
+    { ++ error_count_; };
+
+    std::size_t timeouts_count = 0;
+    auto on_timeout = [ &timeouts_count ]
+    { return ++ timeouts_count < 3 ? std::chrono::milliseconds{ 1 } : std::chrono::milliseconds{ 0 }; };
+
+    router_.register_temporary_callback( std::chrono::milliseconds{ 0 }
+                                       , on_message_received
+                                       , on_error
+                                       , on_timeout );
+
+    while (error_count_ == 0)
+        io_service_.poll();
+    EXPECT_EQ(3U, timeouts_count);
+    EXPECT_EQ(1ULL, error_count_ );
+    EXPECT_EQ(0ULL, messages_received_count_ );
+    EXPECT_EQ(0U, router_.pending_count());
+}
+
 }
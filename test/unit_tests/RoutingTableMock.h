@@ -26,6 +26,7 @@
 #ifndef KADEMLIA_TEST_HELPERS_ROUTING_TABLE_MOCK_H
 #define KADEMLIA_TEST_HELPERS_ROUTING_TABLE_MOCK_H
 
+#include <chrono>
 #include <vector>
 #include <deque>
 #include <utility>
@@ -48,7 +49,8 @@ struct RoutingTableMock
 
 	RoutingTableMock(): expected_ids_(),
 		peers_(),
-		find_call_count_()
+		find_call_count_(),
+		unresponsive_ids_()
 	{ }
 
 	iterator_type find(detail::id const& id)
@@ -61,6 +63,26 @@ struct RoutingTableMock
 		return peers_.begin();
 	}
 
+	template< typename OutputIterator >
+	std::size_t closest(detail::id const& id, std::size_t count, OutputIterator out)
+	{
+		auto i = find(id);
+		std::size_t written = 0;
+		for (; i != end() && written < count; ++i, ++written)
+			*out++ = *i;
+		return written;
+	}
+
+	void flag_peer_as_unresponsive(detail::id const& id)
+	{
+		unresponsive_ids_.push_back(id);
+	}
+
+	std::chrono::microseconds rtt(detail::id const&) const
+	{
+		return std::chrono::microseconds::zero();
+	}
+
 	void push(detail::id const& id, Poco::Net::SocketAddress const& endpoint)
 	{
 		peers_.emplace_back(id, endpoint);
@@ -74,6 +96,7 @@ struct RoutingTableMock
 	expected_ids_type expected_ids_;
 	peers_type peers_;
 	uint64_t find_call_count_;
+	std::vector< detail::id > unresponsive_ids_;
 };
 
 } // namespace test
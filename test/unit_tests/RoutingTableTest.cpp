@@ -23,6 +23,7 @@
 // (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
 // SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <tuple>
 #include "common.hpp"
 #include "PeerFactory.h"
 #include "kademlia/routing_table.hpp"
@@ -35,6 +36,7 @@ namespace k = kademlia;
 namespace kd = k::detail;
 
 using test_routing_table = kd::routing_table< Poco::Net::SocketAddress >;
+using split_routing_table = kd::routing_table< Poco::Net::SocketAddress, kd::split_k_buckets >;
 
 
 TEST(RoutingTableTest, is_empty_on_construction)
@@ -100,6 +102,210 @@ TEST(RoutingTableTest, discards_already_pushed_ids)
     EXPECT_EQ(rt.peer_count(), 1);
 }
 
+TEST(RoutingTableTest, full_bucket_keeps_refused_peers_as_replacements)
+{
+    // "1", "2" and "3" share the same bucket (index 158).
+    test_routing_table rt{ kd::id{}, 1, 1 };
+    EXPECT_TRUE(rt.push(kd::id{ "2" }, createEndpoint("192.168.0.2")));
+    test_routing_table::value_type lrs;
+    EXPECT_FALSE(rt.begin_liveness_check(kd::id{ "3" }, lrs));
+
+    EXPECT_FALSE(rt.push(kd::id{ "3" }, createEndpoint("192.168.0.3")));
+    EXPECT_EQ(1U, rt.peer_count());
+
+    // A single check is started for the refused peer.
+    ASSERT_TRUE(rt.begin_liveness_check(kd::id{ "3" }, lrs));
+    EXPECT_EQ(kd::id{ "2" }, lrs.first);
+    EXPECT_EQ(createEndpoint("192.168.0.2"), lrs.second);
+    EXPECT_FALSE(rt.begin_liveness_check(kd::id{ "3" }, lrs));
+
+    // The least recently seen peer answered, it stays.
+    rt.end_liveness_check(kd::id{ "2" }, true);
+    EXPECT_EQ(kd::id{ "2" }, rt.find(kd::id{ "2" })->first);
+    EXPECT_EQ(0U, rt.evictions_count());
+
+    // A new refused peer takes the single replacement slot.
+    EXPECT_FALSE(rt.push(kd::id{ "3" }, createEndpoint("192.168.0.3")));
+    ASSERT_TRUE(rt.begin_liveness_check(kd::id{ "3" }, lrs));
+    rt.end_liveness_check(lrs.first, false);
+
+    EXPECT_EQ(1U, rt.evictions_count());
+    EXPECT_EQ(1U, rt.replacements_count());
+    EXPECT_EQ(1U, rt.peer_count());
+    auto i = rt.find(kd::id{ "3" });
+    ASSERT_TRUE(i != rt.end());
+    EXPECT_EQ(kd::id{ "3" }, i->first);
+    EXPECT_EQ(createEndpoint("192.168.0.3"), i->second);
+}
+
+TEST(RoutingTableTest, pushing_a_known_peer_marks_it_as_most_recently_seen)
+{
+    // "8", "9" and "a" share the same bucket (index 156).
+    auto const now = test_routing_table::clock::now();
+    test_routing_table rt{ kd::id{}, 2 };
+    EXPECT_TRUE(rt.push(kd::id{ "8" }, createEndpoint("192.168.0.8"), now));
+    EXPECT_TRUE(rt.push(kd::id{ "9" }, createEndpoint("192.168.0.9"), now));
+    EXPECT_FALSE(rt.push(kd::id{ "8" }, createEndpoint("192.168.0.8"), now + kd::RECENT_PEER_REFRESH_PERIOD));
+    EXPECT_FALSE(rt.push(kd::id{ "a" }, createEndpoint("192.168.0.10"), now + kd::RECENT_PEER_REFRESH_PERIOD));
+
+    // "8" has been seen after "9".
+    test_routing_table::value_type lrs;
+    ASSERT_TRUE(rt.begin_liveness_check(kd::id{ "a" }, lrs));
+    EXPECT_EQ(kd::id{ "9" }, lrs.first);
+}
+
+TEST(RoutingTableTest, recently_refreshed_peer_is_refreshed_once_per_period)
+{
+    // "8", "9" and "a" share the same bucket (index 156).
+    auto const now = test_routing_table::clock::now();
+    test_routing_table rt{ kd::id{}, 2 };
+    EXPECT_TRUE(rt.push(kd::id{ "8" }, createEndpoint("192.168.0.8"), now));
+    EXPECT_TRUE(rt.push(kd::id{ "9" }, createEndpoint("192.168.0.9"), now));
+
+    // Too soon, "8" stays the least recently seen.
+    EXPECT_FALSE(rt.push(kd::id{ "8" }, createEndpoint("192.168.0.8"), now + kd::RECENT_PEER_REFRESH_PERIOD / 2));
+    EXPECT_FALSE(rt.push(kd::id{ "a" }, createEndpoint("192.168.0.10"), now));
+    test_routing_table::value_type lrs;
+    ASSERT_TRUE(rt.begin_liveness_check(kd::id{ "a" }, lrs));
+    EXPECT_EQ(kd::id{ "8" }, lrs.first);
+    rt.end_liveness_check(lrs.first, true);
+
+    // A removed peer is pushed again at once.
+    EXPECT_TRUE(rt.remove(kd::id{ "9" }));
+    EXPECT_TRUE(rt.push(kd::id{ "9" }, createEndpoint("192.168.0.9"), now));
+    EXPECT_EQ(2U, rt.peer_count());
+}
+
+TEST(RoutingTableTest, unresponsive_peer_is_evicted_after_repeated_failures)
+{
+    // "2" and "3" share the same bucket (index 158).
+    test_routing_table rt{ kd::id{}, 1, 1 };
+    EXPECT_TRUE(rt.push(kd::id{ "2" }, createEndpoint("192.168.0.2")));
+    EXPECT_FALSE(rt.push(kd::id{ "3" }, createEndpoint("192.168.0.3")));
+
+    for (std::size_t i = 1; i < kd::MAX_PEER_FAILURE_COUNT; ++i)
+        rt.flag_peer_as_unresponsive(kd::id{ "2" });
+    EXPECT_EQ(0U, rt.evictions_count());
+    EXPECT_EQ(kd::id{ "2" }, rt.find(kd::id{ "2" })->first);
+
+    rt.flag_peer_as_unresponsive(kd::id{ "2" });
+    EXPECT_EQ(1U, rt.evictions_count());
+    EXPECT_EQ(1U, rt.replacements_count());
+    EXPECT_EQ(1U, rt.peer_count());
+    EXPECT_EQ(kd::id{ "3" }, rt.find(kd::id{ "2" })->first);
+
+    // Unknown peers are ignored.
+    rt.flag_peer_as_unresponsive(kd::id{ "2" });
+    EXPECT_EQ(1U, rt.evictions_count());
+}
+
+TEST(RoutingTableTest, seeing_a_peer_again_resets_its_failures)
+{
+    test_routing_table rt{ kd::id{} };
+    EXPECT_TRUE(rt.push(kd::id{ "2" }, createEndpoint("192.168.0.2")));
+
+    for (std::size_t i = 1; i < kd::MAX_PEER_FAILURE_COUNT; ++i)
+        rt.flag_peer_as_unresponsive(kd::id{ "2" });
+    EXPECT_FALSE(rt.push(kd::id{ "2" }, createEndpoint("192.168.0.2")));
+
+    for (std::size_t i = 1; i < kd::MAX_PEER_FAILURE_COUNT; ++i)
+        rt.flag_peer_as_unresponsive(kd::id{ "2" });
+    EXPECT_EQ(0U, rt.evictions_count());
+    EXPECT_EQ(1U, rt.peer_count());
+}
+
+TEST(RoutingTableTest, closest_ranks_unresponsive_peers_last)
+{
+    test_routing_table rt{ kd::id{} };
+    EXPECT_TRUE(rt.push(kd::id{ "1" }, createEndpoint("192.168.0.1")));
+    EXPECT_TRUE(rt.push(kd::id{ "2" }, createEndpoint("192.168.0.2")));
+    EXPECT_TRUE(rt.push(kd::id{ "4" }, createEndpoint("192.168.0.4")));
+    rt.flag_peer_as_unresponsive(kd::id{ "1" });
+
+    std::vector<test_routing_table::value_type> peers;
+    EXPECT_EQ(2U, rt.closest(kd::id{ "1" }, 2, std::back_inserter(peers)));
+    ASSERT_EQ(2U, peers.size());
+    EXPECT_EQ(kd::id{ "2" }, peers[0].first);
+    EXPECT_EQ(kd::id{ "4" }, peers[1].first);
+
+    // It is still returned when no responsive peer is left.
+    peers.clear();
+    EXPECT_EQ(3U, rt.closest(kd::id{ "1" }, 3, std::back_inserter(peers)));
+    ASSERT_EQ(3U, peers.size());
+    EXPECT_EQ(kd::id{ "1" }, peers[2].first);
+}
+
+TEST(RoutingTableTest, split_table_allocates_buckets_on_demand)
+{
+    test_routing_table static_rt{ kd::id{}, 2 };
+    EXPECT_EQ(kd::id::BIT_SIZE + 0, static_rt.k_bucket_count());
+
+    // "8" and "9" differ from our id at bit 156, "4" at 157, "2" at 158.
+    split_routing_table rt{ kd::id{}, 2 };
+    EXPECT_EQ(1U, rt.k_bucket_count());
+    EXPECT_TRUE(rt.push(kd::id{ "8" }, createEndpoint("192.168.0.8")));
+    EXPECT_TRUE(rt.push(kd::id{ "9" }, createEndpoint("192.168.0.9")));
+    EXPECT_EQ(1U, rt.k_bucket_count());
+
+    // The single bucket is full and split until "4" finds room.
+    EXPECT_TRUE(rt.push(kd::id{ "4" }, createEndpoint("192.168.0.4")));
+    EXPECT_EQ(158U, rt.k_bucket_count());
+    EXPECT_TRUE(rt.push(kd::id{ "2" }, createEndpoint("192.168.0.2")));
+    EXPECT_EQ(158U, rt.k_bucket_count());
+    EXPECT_EQ(4U, rt.peer_count());
+
+    // Far buckets don't split, refused peers are kept as replacements.
+    EXPECT_FALSE(rt.push(kd::id{ "a" }, createEndpoint("192.168.0.10")));
+    EXPECT_EQ(158U, rt.k_bucket_count());
+    split_routing_table::value_type lrs;
+    ASSERT_TRUE(rt.begin_liveness_check(kd::id{ "a" }, lrs));
+    EXPECT_EQ(kd::id{ "8" }, lrs.first);
+
+    std::vector<kd::id> ids;
+    for (auto i = rt.find(kd::id{}); i != rt.end(); ++i)
+        ids.push_back(i->first);
+    std::sort(ids.begin(), ids.end());
+    EXPECT_EQ((std::vector<kd::id>{ kd::id{ "2" }, kd::id{ "4" }, kd::id{ "8" }, kd::id{ "9" } }), ids);
+}
+
+TEST(RoutingTableTest, symbol_table_has_a_bucket_per_digit_value)
+{
+    using table_type = kd::routing_table< Poco::Net::SocketAddress, kd::static_k_buckets, 2 >;
+    EXPECT_EQ(240U, table_type::MAX_K_BUCKET_COUNT + 0);
+
+    // "1", "2" and "3" only differ from our id by their last digit.
+    table_type rt{ kd::id{}, 1, 0 };
+    EXPECT_EQ(240U, rt.k_bucket_count());
+    EXPECT_TRUE(rt.push(kd::id{ "1" }, createEndpoint("192.168.0.1")));
+    EXPECT_TRUE(rt.push(kd::id{ "2" }, createEndpoint("192.168.0.2")));
+    EXPECT_TRUE(rt.push(kd::id{ "3" }, createEndpoint("192.168.0.3")));
+    EXPECT_TRUE(rt.push(kd::id{ "4" }, createEndpoint("192.168.0.4")));
+    // "5" shares the bucket of "4", their next to last digit is 1.
+    EXPECT_FALSE(rt.push(kd::id{ "5" }, createEndpoint("192.168.0.5")));
+    EXPECT_EQ(4U, rt.peer_count());
+
+    // Buckets are walked from the closest to the farthest.
+    std::vector<kd::id> ids;
+    for (auto i = rt.find(kd::id{}); i != rt.end(); ++i)
+        ids.push_back(i->first);
+    EXPECT_EQ((std::vector<kd::id>{ kd::id{ "1" }, kd::id{ "2" }, kd::id{ "3" }, kd::id{ "4" } }), ids);
+}
+
+TEST(RoutingTableTest, split_symbol_table_splits_a_level_at_once)
+{
+    using table_type = kd::routing_table< Poco::Net::SocketAddress, kd::split_k_buckets, 4 >;
+    table_type rt{ kd::id{}, 1 };
+    EXPECT_EQ(1U, rt.k_bucket_count());
+
+    // "1" and "2" only differ from our id by their last digit,
+    // the table is split up to the last level.
+    EXPECT_TRUE(rt.push(kd::id{ "1" }, createEndpoint("192.168.0.1")));
+    EXPECT_EQ(1U, rt.k_bucket_count());
+    EXPECT_TRUE(rt.push(kd::id{ "2" }, createEndpoint("192.168.0.2")));
+    EXPECT_EQ(600U, rt.k_bucket_count());
+    EXPECT_TRUE(rt.push(kd::id{ "10" }, createEndpoint("192.168.0.16")));
+    EXPECT_EQ(3U, rt.peer_count());
+}
 
 /**
  *  Test test_routing_table::find()
@@ -207,6 +413,159 @@ TEST(RoutingTableTest, iterator_skip_empty_k_bucket)
     EXPECT_TRUE(i == rt.end());
 }
 
+TEST(RoutingTableTest, iterator_preserves_endpoints)
+{
+    test_routing_table rt{ kd::id{} };
+    EXPECT_TRUE(rt.find(kd::id{ "1" }) == rt.end());
+
+    auto test_peer1(createEndpoint("192.168.0.1", 1234));
+    kd::id id1{ "1" };
+    EXPECT_TRUE(rt.push(id1, test_peer1));
+
+    auto test_peer2(createEndpoint("fe80::1", 4321));
+    kd::id id2{ "4" };
+    EXPECT_TRUE(rt.push(id2, test_peer2));
+
+    auto i = rt.find(id1);
+    EXPECT_TRUE(i != rt.end());
+    EXPECT_EQ(id1, i->first);
+    EXPECT_EQ(test_peer1, i->second);
+    ++ i;
+
+    EXPECT_TRUE(i != rt.end());
+    EXPECT_EQ(id2, (*i).first);
+    EXPECT_EQ(test_peer2, (*i).second);
+    ++ i;
+
+    EXPECT_TRUE(i == rt.end());
+}
+
+
+/**
+ *  Test test_routing_table::closest()
+ */
+
+TEST(RoutingTableTest, closest_returns_nothing_when_empty)
+{
+    test_routing_table rt{ kd::id{} };
+    std::vector<test_routing_table::value_type> peers;
+
+    EXPECT_EQ(0U, rt.closest(kd::id{ "1" }, 20, std::back_inserter(peers)));
+    EXPECT_TRUE(peers.empty());
+}
+
+template<typename RoutingTableType>
+void check_closest_returns_peers_sorted_by_distance()
+{
+    std::default_random_engine random_engine;
+    kd::id const my_id{ random_engine };
+    RoutingTableType rt{ my_id, 4 };
+
+    std::vector<kd::id> known_ids;
+    for (int i = 0; i < 500; ++i)
+    {
+        kd::id const peer_id{ random_engine };
+        auto const endpoint(createEndpoint("10.0." + std::to_string(i / 256) + "." + std::to_string(i % 256)));
+        if (rt.push(peer_id, endpoint))
+            known_ids.push_back(peer_id);
+    }
+    ASSERT_EQ(known_ids.size(), rt.peer_count());
+
+    std::vector<kd::id> targets{ my_id, kd::id{}, known_ids.front() };
+    for (int i = 0; i < 20; ++i)
+        targets.emplace_back(random_engine);
+
+    for (auto const& target : targets)
+    {
+        auto by_distance = [&target](kd::id const& a, kd::id const& b)
+        { return kd::distance(a, target) < kd::distance(b, target); };
+        std::sort(known_ids.begin(), known_ids.end(), by_distance);
+
+        std::vector<typename RoutingTableType::value_type> peers;
+        EXPECT_EQ(8U, rt.closest(target, 8, std::back_inserter(peers)));
+        ASSERT_EQ(8U, peers.size());
+        for (std::size_t i = 0; i < peers.size(); ++i)
+            EXPECT_EQ(known_ids[i], peers[i].first);
+    }
+
+    std::vector<typename RoutingTableType::value_type> peers;
+    EXPECT_EQ(known_ids.size(), rt.closest(my_id, known_ids.size() + 1, std::back_inserter(peers)));
+}
+
+TEST(RoutingTableTest, closest_returns_peers_sorted_by_distance)
+{
+    check_closest_returns_peers_sorted_by_distance<test_routing_table>();
+}
+
+TEST(RoutingTableTest, split_table_closest_returns_peers_sorted_by_distance)
+{
+    check_closest_returns_peers_sorted_by_distance<split_routing_table>();
+}
+
+TEST(RoutingTableTest, symbol_table_closest_returns_peers_sorted_by_distance)
+{
+    check_closest_returns_peers_sorted_by_distance<
+        kd::routing_table< Poco::Net::SocketAddress, kd::static_k_buckets, 4 >>();
+    check_closest_returns_peers_sorted_by_distance<
+        kd::routing_table< Poco::Net::SocketAddress, kd::split_k_buckets, 4 >>();
+    check_closest_returns_peers_sorted_by_distance<
+        kd::routing_table< Poco::Net::SocketAddress, kd::split_k_buckets, 5 >>();
+}
+
+TEST(RoutingTableTest, find_matches_a_full_scan_under_random_operations)
+{
+    std::default_random_engine random_engine;
+    kd::id const my_id{ random_engine };
+    std::size_t const k = 4;
+    test_routing_table rt{ my_id, k, 0 };
+
+    auto bucket_index = [&my_id](kd::id const& i)
+    { return std::min(kd::distance(i, my_id).count_leading_zeros(), kd::id::BIT_SIZE - 1); };
+
+    std::vector<kd::id> known_ids;
+    for (int round = 0; round < 2000; ++round)
+    {
+        if (known_ids.empty() || random_engine() % 3)
+        {
+            // Favor the far buckets, as a real network does.
+            kd::id peer_id{ random_engine };
+            for (std::size_t bit = 0, e = random_engine() % 8; bit < e; ++bit)
+                peer_id[bit] = bool(my_id[bit]);
+            auto const endpoint(createEndpoint("10.0." + std::to_string(round / 256) + "." + std::to_string(round % 256)));
+            if (rt.push(peer_id, endpoint))
+                known_ids.push_back(peer_id);
+        }
+        else
+        {
+            auto const i = random_engine() % known_ids.size();
+            EXPECT_TRUE(rt.remove(known_ids[i]));
+            known_ids.erase(known_ids.begin() + i);
+        }
+
+        // The reference implementation sums the bucket sizes.
+        std::vector<std::size_t> sizes(kd::id::BIT_SIZE);
+        for (auto const& i : known_ids)
+            ++sizes[bucket_index(i)];
+        std::size_t lowest = 0;
+        for (std::size_t count = 0; lowest != kd::id::BIT_SIZE - 1 && count <= k; ++lowest)
+            count += sizes[lowest];
+
+        kd::id const target{ random_engine };
+        auto const start = std::max(lowest, bucket_index(target));
+        std::vector<kd::id> expected;
+        for (auto const& i : known_ids)
+            if (bucket_index(i) <= start)
+                expected.push_back(i);
+
+        std::vector<kd::id> found;
+        for (auto i = rt.find(target); i != rt.end(); ++i)
+            found.push_back(i->first);
+
+        std::sort(expected.begin(), expected.end());
+        std::sort(found.begin(), found.end());
+        ASSERT_EQ(expected, found);
+    }
+}
 
 /**
  *  Test test_routing_table::remove()
@@ -227,6 +586,121 @@ TEST(RoutingTableTest, can_remove_a_peer)
     EXPECT_TRUE(rt.find(test_id) == rt.end());
 }
 
+/**
+ *  Test test_routing_table::for_each_peer()
+ */
+
+TEST(RoutingTableTest, for_each_peer_restores_the_same_table)
+{
+    using clock = test_routing_table::clock;
+    auto const now = clock::now();
+
+    test_routing_table rt{ kd::id{} };
+    std::vector< std::tuple< kd::id, Poco::Net::SocketAddress, clock::time_point > > peers;
+    for (std::uint16_t i = 1; i < 64; ++ i)
+    {
+        kd::id const peer_id{ std::to_string(i) };
+        auto const peer = createEndpoint("127.0.0.1", std::uint16_t(1024 + i));
+        rt.push(peer_id, peer, now - std::chrono::seconds(i));
+    }
+
+    rt.for_each_peer([&peers](kd::id const& peer_id, Poco::Net::SocketAddress const& peer
+            , clock::time_point last_seen)
+    { peers.emplace_back(peer_id, peer, last_seen); });
+    ASSERT_EQ(rt.peer_count(), peers.size());
+
+    test_routing_table restored{ kd::id{} };
+    for (auto const& p : peers)
+        EXPECT_TRUE(restored.push(std::get<0>(p), std::get<1>(p), std::get<2>(p)));
+
+    std::vector< std::tuple< kd::id, Poco::Net::SocketAddress, clock::time_point > > restored_peers;
+    restored.for_each_peer([&restored_peers](kd::id const& peer_id, Poco::Net::SocketAddress const& peer
+            , clock::time_point last_seen)
+    { restored_peers.emplace_back(peer_id, peer, last_seen); });
+    EXPECT_EQ(peers, restored_peers);
+}
+
+/**
+ *  Test test_routing_table::record_rtt()
+ */
+
+TEST(RoutingTableTest, rtt_is_smoothed_and_follows_the_peer)
+{
+    using std::chrono::microseconds;
+
+    split_routing_table rt{ kd::id{}, 2 };
+    EXPECT_TRUE(rt.push(kd::id{ "1" }, createEndpoint("192.168.0.1")));
+    EXPECT_EQ(microseconds(0), rt.rtt(kd::id{ "1" }));
+
+    // Unknown peers are ignored.
+    rt.record_rtt(kd::id{ "2" }, microseconds(100));
+    EXPECT_EQ(microseconds(0), rt.rtt(kd::id{ "2" }));
+
+    // The first sample is the estimate, the next ones count for 1/8.
+    rt.record_rtt(kd::id{ "1" }, microseconds(1000));
+    EXPECT_EQ(microseconds(1000), rt.rtt(kd::id{ "1" }));
+    rt.record_rtt(kd::id{ "1" }, microseconds(1800));
+    EXPECT_EQ(microseconds(1100), rt.rtt(kd::id{ "1" }));
+
+    // Splitting the bucket keeps the estimate.
+    EXPECT_TRUE(rt.push(kd::id{ "2" }, createEndpoint("192.168.0.2")));
+    EXPECT_TRUE(rt.push(kd::id{ "8000000000000000000000000000000000000000" }, createEndpoint("192.168.0.3")));
+    EXPECT_LT(1U, rt.k_bucket_count());
+    EXPECT_EQ(microseconds(1100), rt.rtt(kd::id{ "1" }));
+}
+
+/**
+ *  Test test_routing_table::take_idle_k_buckets()
+ */
+
+TEST(RoutingTableTest, random_id_in_k_bucket_is_covered_by_the_bucket)
+{
+    std::default_random_engine random_engine;
+
+    // With a null id, the bucket i covers the ids with i leading 0s.
+    test_routing_table rt{ kd::id{} };
+    for (std::size_t i = 0; i != rt.k_bucket_count(); ++ i)
+        EXPECT_EQ(i, rt.random_id_in_k_bucket(i, random_engine).count_leading_zeros());
+
+    // The last bucket of a split table covers any id.
+    split_routing_table split_rt{ kd::id{} };
+    EXPECT_EQ(1U, split_rt.k_bucket_count());
+    EXPECT_NE(split_rt.random_id_in_k_bucket(0, random_engine)
+            , split_rt.random_id_in_k_bucket(0, random_engine));
+}
+
+TEST(RoutingTableTest, idle_k_buckets_are_refreshed_once_per_period)
+{
+    using clock = test_routing_table::clock;
+    auto const period = std::chrono::duration_cast< clock::duration >(kd::K_BUCKET_REFRESH_PERIOD);
+    std::default_random_engine random_engine;
+
+    test_routing_table rt{ kd::id{}, 2 };
+    auto const now = clock::now() + period;
+    rt.push(kd::id{ "8000000000000000000000000000000000000001" }, createEndpoint("192.168.0.1"));
+    rt.push(kd::id{ "8000000000000000000000000000000000000002" }, createEndpoint("192.168.0.2"));
+    rt.push(kd::id{ "1" }, createEndpoint("192.168.0.3"));
+
+    // The empty buckets and the last one hold less than k peers,
+    // they are all refreshed by a single lookup, the first one.
+    std::vector< kd::id > targets;
+    auto take = [&targets](kd::id const& target) { targets.push_back(target); };
+    rt.take_idle_k_buckets(now, period, random_engine, take);
+    ASSERT_EQ(2U, targets.size());
+    EXPECT_EQ(kd::id{ "1" }, targets[ 0 ]);
+    EXPECT_EQ(0U, targets[ 1 ].count_leading_zeros());
+
+    targets.clear();
+    rt.take_idle_k_buckets(now, period, random_engine, take);
+    EXPECT_TRUE(targets.empty());
+
+    // A lookup of an id of the first bucket keeps it fresh.
+    rt.mark_as_looked_up(kd::id{ "8000000000000000000000000000000000000003" }, now + period);
+    EXPECT_EQ(now + period, rt.last_lookup(kd::id{ "8000000000000000000000000000000000000004" }));
+    rt.take_idle_k_buckets(now + period, period, random_engine, take);
+    EXPECT_EQ(std::vector< kd::id >{ kd::id{ "1" } }, targets);
+}
+
 /**
  *  Test operator<<()
  */
@@ -0,0 +1,80 @@
+// Copyright (c) 2021, Aleph ONE Software Engineering and Contributors.
+//
+// SPDX-License-Identifier:	BSL-1.0
+
+
+#include "common.hpp"
+#include "PeerFactory.h"
+#include "kademlia/rtt_estimator.hpp"
+#include "gtest/gtest.h"
+#include <chrono>
+
+
+namespace {
+
+namespace kd = kademlia::detail;
+using std::chrono::milliseconds;
+using std::chrono::microseconds;
+
+
+TEST(RttEstimatorTest, uses_the_initial_timeout_until_sampled)
+{
+    kd::rtt_estimator estimator;
+    EXPECT_TRUE(estimator.empty());
+    EXPECT_EQ(milliseconds(200), estimator.rto(milliseconds(20), milliseconds(2000), milliseconds(200)));
+}
+
+TEST(RttEstimatorTest, follows_the_samples_mean_and_deviation)
+{
+    kd::rtt_estimator estimator;
+
+    // The first sample sets SRTT and half of it as RTTVAR.
+    estimator.update(milliseconds(40));
+    EXPECT_EQ(microseconds(40000), estimator.srtt());
+    EXPECT_EQ(microseconds(20000), estimator.rttvar());
+    EXPECT_EQ(milliseconds(120), estimator.rto(milliseconds(20), milliseconds(2000), milliseconds(200)));
+
+    // Steady samples shrink the deviation, down to the minimum timeout.
+    for (int i = 0; i != 100; ++i)
+        estimator.update(milliseconds(2));
+    EXPECT_GT(microseconds(2100), estimator.srtt());
+    EXPECT_EQ(milliseconds(20), estimator.rto(milliseconds(20), milliseconds(2000), milliseconds(200)));
+
+    // A slow link hits the maximum timeout.
+    estimator.update(milliseconds(60000));
+    EXPECT_EQ(milliseconds(2000), estimator.rto(milliseconds(20), milliseconds(2000), milliseconds(200)));
+}
+
+TEST(RttEstimatorTest, latency_bound_is_below_the_timeout)
+{
+    kd::rtt_estimator estimator;
+    EXPECT_EQ(milliseconds(100), estimator.latency_bound(milliseconds(20), milliseconds(200), milliseconds(100)));
+
+    estimator.update(milliseconds(40));
+    EXPECT_EQ(milliseconds(80), estimator.latency_bound(milliseconds(20), milliseconds(200), milliseconds(100)));
+    EXPECT_GT(estimator.rto(milliseconds(20), milliseconds(2000), milliseconds(200)),
+        estimator.latency_bound(milliseconds(20), milliseconds(2000), milliseconds(100)));
+}
+
+TEST(RttEstimatorTest, keeps_an_estimator_per_endpoint)
+{
+    kd::rtt_estimators estimators;
+    kd::packed_endpoint const a{ createEndpoint("10.0.0.1", 1000) };
+    kd::packed_endpoint const b{ createEndpoint("10.0.0.1", 1001) };
+
+    EXPECT_EQ(nullptr, estimators.find(a));
+    estimators.update(a, milliseconds(10));
+    ASSERT_NE(nullptr, estimators.find(a));
+    EXPECT_EQ(microseconds(10000), estimators.find(a)->srtt());
+
+    // A colliding endpoint takes the slot over.
+    if (a.hash() % kd::rtt_estimators::SIZE == b.hash() % kd::rtt_estimators::SIZE)
+    {
+        estimators.update(b, milliseconds(30));
+        EXPECT_EQ(nullptr, estimators.find(a));
+    }
+    else
+        EXPECT_EQ(nullptr, estimators.find(b));
+}
+
+}
@@ -88,25 +88,40 @@ TEST_F(TimerTest, multiple_associations_can_be_added)
     EXPECT_EQ(0, io_service_.poll());
     EXPECT_EQ(0, timeouts_received_);
 
-    // This new expiration should trigger a cancel of the current
-    // timeout (infinite), hence one task execution.
+    // This new expiration isn't delayed by the
+    // current timeout (infinite).
     auto const immediate = kd::Timer::duration::zero();
     manager_.expires_from_now(immediate, on_expiration);
-    LOG_DEBUG(TimerTest, this) << "runOne()" << std::endl;
-    EXPECT_EQ(1, io_service_.runOne());
-    EXPECT_EQ(0, timeouts_received_);
-
-    // Then the task execution of the new timeout (immediate)
-    // and the call of its associated callback.
-    LOG_DEBUG(TimerTest, this) << "runOne()" << std::endl;
-    EXPECT_EQ(1, io_service_.runOne());
-    EXPECT_EQ(1, timeouts_received_);
-
-    EXPECT_EQ(0, io_service_.poll());
+    auto const deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (timeouts_received_ == 0 && std::chrono::steady_clock::now() < deadline)
+        io_service_.poll();
     EXPECT_EQ(1, timeouts_received_);
+    EXPECT_EQ(1U, manager_.pending_count());
 
     // A timeout (infinite) is still in flight atm.
 }
 
 
+TEST_F(TimerTest, cancelled_associations_are_not_called)
+{
+    auto on_expiration = [ this ] (void)
+    { ++ timeouts_received_; };
+
+    auto const immediate = kd::Timer::duration::zero();
+    auto const h1 = manager_.expires_from_now(immediate, on_expiration);
+    auto const h2 = manager_.expires_from_now(std::chrono::milliseconds(1), on_expiration);
+    EXPECT_EQ(2U, manager_.pending_count());
+
+    EXPECT_TRUE(manager_.cancel(h1));
+    EXPECT_FALSE(manager_.cancel(h1));
+    EXPECT_EQ(1U, manager_.pending_count());
+
+    auto const deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (manager_.pending_count() != 0 && std::chrono::steady_clock::now() < deadline)
+        io_service_.poll();
+    EXPECT_EQ(1, timeouts_received_);
+    EXPECT_FALSE(manager_.cancel(h2));
+}
+
+
 }
@@ -0,0 +1,105 @@
+// Copyright (c) 2021, Aleph ONE Software Engineering and Contributors.
+//
+// SPDX-License-Identifier:	BSL-1.0
+
+
+#include "common.hpp"
+#include "kademlia/timing_wheel.hpp"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <random>
+#include <utility>
+#include <vector>
+
+
+namespace {
+
+namespace kd = kademlia::detail;
+using tick_type = kd::timing_wheel::tick_type;
+
+
+TEST(TimingWheelTest, timers_expire_at_their_tick_across_levels)
+{
+    kd::timing_wheel wheel;
+    std::vector<std::pair<tick_type, tick_type>> fired;
+    tick_type now = 0;
+
+    std::default_random_engine random_engine;
+    std::vector<tick_type> expiries;
+    for (tick_type max : { 0x100ULL, 0x10000ULL, 0x1000000ULL, 0x100000000ULL })
+        for (int i = 0; i != 50; ++i)
+            expiries.push_back(std::uniform_int_distribution<tick_type>(0, max - 1)(random_engine));
+
+    for (auto e : expiries)
+        wheel.insert(e, [&fired, &now, e] { fired.emplace_back(now, e); });
+    EXPECT_EQ(expiries.size(), wheel.size());
+
+    // Jump from one tick of interest to the next one.
+    while (!wheel.empty())
+    {
+        now = wheel.next_tick();
+        wheel.advance(now, [](kd::timing_wheel::callback& c) { c(); });
+    }
+
+    std::sort(expiries.begin(), expiries.end());
+    ASSERT_EQ(expiries.size(), fired.size());
+    for (std::size_t i = 0; i != fired.size(); ++i)
+    {
+        EXPECT_EQ(expiries[i], fired[i].second);
+        EXPECT_EQ(fired[i].second, fired[i].first);
+    }
+}
+
+TEST(TimingWheelTest, advance_fires_all_timers_up_to_the_tick)
+{
+    kd::timing_wheel wheel;
+    std::vector<tick_type> fired;
+
+    for (tick_type e : { 3ULL, 300ULL, 70000ULL, 255ULL, 256ULL })
+        wheel.insert(e, [&fired, e] { fired.push_back(e); });
+
+    auto call = [](kd::timing_wheel::callback& c) { c(); };
+    wheel.advance(2, call);
+    EXPECT_TRUE(fired.empty());
+    EXPECT_EQ(3U, wheel.next_tick());
+
+    wheel.advance(1000, call);
+    EXPECT_EQ((std::vector<tick_type>{ 3, 255, 256, 300 }), fired);
+    EXPECT_EQ(1001U, wheel.now());
+
+    // Past expiries fire at the next tick.
+    wheel.insert(10, [&fired] { fired.push_back(10); });
+    wheel.advance(1001, call);
+    EXPECT_EQ(10U, fired.back());
+
+    wheel.advance(100000, call);
+    EXPECT_EQ(70000U, fired.back());
+    EXPECT_TRUE(wheel.empty());
+}
+
+TEST(TimingWheelTest, cancelled_timers_do_not_fire)
+{
+    kd::timing_wheel wheel;
+    std::size_t fired = 0;
+
+    auto const h1 = wheel.insert(10, [&fired] { ++fired; });
+    auto const h2 = wheel.insert(100000, [&fired] { ++fired; });
+    EXPECT_TRUE(wheel.cancel(h1));
+    EXPECT_FALSE(wheel.cancel(h1));
+    EXPECT_EQ(1U, wheel.size());
+
+    // The node is reused, the old handle doesn't match it.
+    auto const h3 = wheel.insert(20, [&fired] { ++fired; });
+    EXPECT_EQ(h1.index_, h3.index_);
+    EXPECT_FALSE(wheel.cancel(h1));
+
+    wheel.advance(1000, [](kd::timing_wheel::callback& c) { c(); });
+    EXPECT_EQ(1U, fired);
+    EXPECT_FALSE(wheel.cancel(h3));
+
+    EXPECT_TRUE(wheel.cancel(h2));
+    EXPECT_TRUE(wheel.empty());
+    EXPECT_FALSE(wheel.cancel(kd::timing_wheel::handle()));
+}
+
+}
@@ -29,11 +29,19 @@
 
 #include "Poco/Net/SocketProactor.h"
 #include "Poco/Net/SocketAddress.h"
+#include "kademlia/constants.hpp"
 #include "kademlia/error_impl.hpp"
 #include "kademlia/Message.h"
 #include "kademlia/MessageSerializer.h"
 #include "kademlia/log.hpp"
+#include "kademlia/timing_wheel.hpp"
+#include <chrono>
+#include <functional>
+#include <map>
 #include <queue>
+#include <set>
+#include <string>
+#include <vector>
 
 namespace kademlia {
 namespace test {
@@ -45,7 +53,15 @@ public:
 		id_(),
 		message_serializer_(id_),
 		responses_to_receive_(),
-		sent_messages_()
+		sent_messages_(),
+		pending_requests_(),
+		unresponsive_endpoints_(),
+		unanswered_requests_(),
+		timers_(),
+		timers_count_(),
+		requests_count_(),
+		cancelled_requests_count_(),
+		max_retransmissions_count_()
 	{
 		LOG_DEBUG(TrackerMock, this) << "create TrackerMock." << std::endl;
 	}
@@ -74,33 +90,92 @@ public:
 		return ! sent_messages_.empty();
 	}
 
+	void add_unresponsive_endpoint(Poco::Net::SocketAddress const& endpoint)
+		/// Requests to endpoint neither get a response nor time out.
+	{
+		unresponsive_endpoints_.insert(endpoint);
+	}
+
+	std::size_t expire_timers()
+		/// Runs the timers set so far, returns their count.
+	{
+		std::map<std::uint32_t, std::function<void ()>> timers;
+		timers.swap(timers_);
+		for (auto& t : timers)
+			t.second();
+		return timers.size();
+	}
+
+	std::size_t pending_timers_count() const
+	{
+		return timers_.size();
+	}
+
+	std::size_t cancelled_requests_count() const
+	{
+		return cancelled_requests_count_;
+	}
+
+	std::size_t max_retransmissions_count() const
+		/// Returns the retransmission budget of the last request.
+	{
+		return max_retransmissions_count_;
+	}
+
 	template<typename RequestType, typename EndpointType, typename TimeoutType
 			, typename OnMessageReceiveCallback, typename OnErrorCallback>
-	void send_request(RequestType const& request
+	detail::id send_request(RequestType const& request
 		, EndpointType const& endpoint
 		, TimeoutType const& timeout
 		, OnMessageReceiveCallback const& on_message_received
-		, OnErrorCallback const& on_error)
+		, OnErrorCallback const& on_error
+		, std::size_t max_retransmissions_count = detail::MAX_REQUEST_RETRANSMISSION_COUNT)
 	{
 		save_sent_message(request, endpoint);
+		max_retransmissions_count_ = max_retransmissions_count;
+
+		detail::id const response_id{ std::to_string(++ requests_count_) };
+		pending_requests_.insert(response_id);
 
-		if (responses_to_receive_.empty() || responses_to_receive_.front().endpoint != endpoint)
+		if (unresponsive_endpoints_.count(endpoint))
+		{
+			LOG_DEBUG(TrackerMock, this) << "no response." << std::endl;
+			// Kept (with the task) until cancelled.
+			unanswered_requests_.emplace(response_id, on_error);
+		}
+		else if (responses_to_receive_.empty() || responses_to_receive_.front().endpoint != endpoint)
 		{
 			LOG_DEBUG(TrackerMock, this) << "add on_error." << std::endl;
-			io_service_.addWork([on_error](){ on_error(detail::make_error_code(UNIMPLEMENTED)); }, 0);
+			io_service_.addWork([this, response_id, on_error]()
+			{
+				if (pending_requests_.erase(response_id))
+					on_error(detail::make_error_code(UNIMPLEMENTED));
+			}, 0);
 		}
 		else
 		{
 			auto const r = responses_to_receive_.front();
 			responses_to_receive_.pop();
-			detail::Header h{ detail::Header::V1, r.message_type, r.source_id };
-			auto forwarder = [ on_message_received, h, r ]()
+			detail::Header h{ detail::Header::V1, r.message_type, r.source_id, response_id };
+			auto forwarder = [ this, on_message_received, h, r ]()
 			{
-				on_message_received(r.endpoint, h, r.body.begin(), r.body.end());
+				if (pending_requests_.erase(h.random_token_))
+					on_message_received(r.endpoint, h, r.body.begin(), r.body.end());
 			};
 			LOG_DEBUG(TrackerMock, this) << "add on_message_received." << std::endl;
 			io_service_.addWork(std::move(forwarder), 0);
 		}
+
+		return response_id;
+	}
+
+	bool cancel_request(detail::id const& response_id)
+	{
+		unanswered_requests_.erase(response_id);
+		if (! pending_requests_.erase(response_id))
+			return false;
+		++ cancelled_requests_count_;
+		return true;
 	}
 
 	template<typename RequestType, typename EndpointType>
@@ -115,6 +190,26 @@ public:
 		save_sent_message(r, e);
 	}
 
+	template<typename EndpointType>
+	std::chrono::milliseconds hedge_delay(EndpointType const&)
+	{
+		return std::chrono::milliseconds(1);
+	}
+
+	template<typename DurationType, typename Callback>
+	detail::timing_wheel::handle expires_from_now(DurationType const&, Callback const& on_timer_expired)
+	{
+		detail::timing_wheel::handle h;
+		h.index_ = ++timers_count_;
+		timers_.emplace(h.index_, on_timer_expired);
+		return h;
+	}
+
+	bool cancel_timer(detail::timing_wheel::handle const& h)
+	{
+		return timers_.erase(h.index_) > 0;
+	}
+
 	Poco::Net::SocketAddress addressV4()
 	{
 		return Poco::Net::SocketAddress();// network_.addressV4();
@@ -153,6 +248,14 @@ private:
 	detail::MessageSerializer message_serializer_;
 	std::queue<message_to_receive> responses_to_receive_;
 	std::queue<sent_message> sent_messages_;
+	std::set<detail::id> pending_requests_;
+	std::set<Poco::Net::SocketAddress> unresponsive_endpoints_;
+	std::map<detail::id, std::function<void (std::error_code const&)>> unanswered_requests_;
+	std::map<std::uint32_t, std::function<void ()>> timers_;
+	std::uint32_t timers_count_;
+	std::size_t requests_count_;
+	std::size_t cancelled_requests_count_;
+	std::size_t max_retransmissions_count_;
 };
 
 } // namespace test
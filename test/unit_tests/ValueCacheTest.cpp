@@ -0,0 +1,82 @@
+// Copyright (c) 2021, Aleph ONE Software Engineering and Contributors.
+//
+// SPDX-License-Identifier:	BSL-1.0
+
+
+#include "common.hpp"
+#include "kademlia/value_cache.hpp"
+#include "gtest/gtest.h"
+#include <chrono>
+
+
+namespace {
+
+namespace kd = kademlia::detail;
+using clock_type = kd::value_cache::clock;
+using std::chrono::milliseconds;
+
+
+TEST(ValueCacheTest, values_expire_after_the_period)
+{
+    kd::value_cache cache(milliseconds(100), 10);
+    auto const now = clock_type::now();
+    kd::id const key{ "a" };
+
+    cache.insert(key, kd::data_type{ 1, 2 }, now);
+    auto const found = cache.find(key, now + milliseconds(99));
+    ASSERT_NE(nullptr, found);
+    EXPECT_EQ((kd::data_type{ 1, 2 }), *found);
+
+    EXPECT_EQ(nullptr, cache.find(key, now + milliseconds(100)));
+    EXPECT_EQ(0U, cache.size());
+}
+
+TEST(ValueCacheTest, oldest_values_are_evicted_beyond_capacity)
+{
+    kd::value_cache cache(milliseconds(100), 2);
+    auto const now = clock_type::now();
+
+    cache.insert(kd::id{ "1" }, kd::data_type{ 1 }, now);
+    cache.insert(kd::id{ "2" }, kd::data_type{ 2 }, now + milliseconds(1));
+    cache.insert(kd::id{ "3" }, kd::data_type{ 3 }, now + milliseconds(2));
+    EXPECT_EQ(2U, cache.size());
+    EXPECT_EQ(nullptr, cache.find(kd::id{ "1" }, now + milliseconds(2)));
+    EXPECT_NE(nullptr, cache.find(kd::id{ "3" }, now + milliseconds(2)));
+}
+
+TEST(ValueCacheTest, inserting_again_restarts_the_period)
+{
+    kd::value_cache cache(milliseconds(100), 10);
+    auto const now = clock_type::now();
+    kd::id const key{ "a" };
+
+    cache.insert(key, kd::data_type{ 1 }, now);
+    cache.insert(key, kd::data_type{ 2 }, now + milliseconds(50));
+
+    // The first insertion expiring doesn't remove the value.
+    auto const found = cache.find(key, now + milliseconds(120));
+    ASSERT_NE(nullptr, found);
+    EXPECT_EQ(kd::data_type{ 2 }, *found);
+    EXPECT_EQ(nullptr, cache.find(key, now + milliseconds(150)));
+
+    cache.insert(key, kd::data_type{ 3 }, now + milliseconds(150));
+    cache.erase(key);
+    EXPECT_EQ(nullptr, cache.find(key, now + milliseconds(150)));
+}
+
+TEST(ValueCacheTest, zero_period_disables_the_cache)
+{
+    kd::value_cache cache(clock_type::duration::zero(), 10);
+    EXPECT_FALSE(cache.enabled());
+
+    auto const now = clock_type::now();
+    cache.insert(kd::id{ "a" }, kd::data_type{ 1 }, now);
+    EXPECT_EQ(0U, cache.size());
+
+    cache.configure(milliseconds(10), 10);
+    EXPECT_TRUE(cache.enabled());
+    cache.insert(kd::id{ "a" }, kd::data_type{ 1 }, now);
+    EXPECT_EQ(1U, cache.size());
+}
+
+}
@@ -231,6 +231,27 @@ TEST(IDTest, id_distance_can_be_evaluated)
     }
 }
 
+TEST(IDTest, id_leading_zeros_can_be_counted)
+{
+    EXPECT_EQ(kd::id::BIT_SIZE + 0, kd::id{}.count_leading_zeros());
+    EXPECT_EQ(kd::id::BIT_SIZE - 1, kd::id{ "1" }.count_leading_zeros());
+    EXPECT_EQ(0U, kd::id{ "8000000000000000000000000000000000000000" }.count_leading_zeros());
+    // Crosses the first word boundary.
+    EXPECT_EQ(64U, kd::id{ "0000000000000000800000000000000000000000" }.count_leading_zeros());
+    EXPECT_EQ(127U, kd::id{ "0000000000000000000000000000000100000000" }.count_leading_zeros());
+
+    std::default_random_engine random_engine;
+    for (int i = 0; i < 100; ++i)
+    {
+        kd::id const a{ random_engine }, b{ random_engine };
+        std::size_t expected = 0;
+        while (expected < kd::id::BIT_SIZE && a[expected] == b[expected])
+            ++expected;
+        EXPECT_EQ(expected, kd::distance(a, b).count_leading_zeros());
+        EXPECT_EQ(std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end()), a < b);
+    }
+}
+
 
 TEST(IDTest, id_is_printable)
 {